@@ -0,0 +1,729 @@
+/**
+ * @file bench.c
+ * @brief Benchmark harness for truerandom.h
+ *
+ * Reports per-call cost in counter ticks and nanoseconds with tail latency,
+ * fill throughput from 8 B up to --max-size for every backend, a
+ * multi-threaded contention sweep, and truernd_fill_parallel() scaling over
+ * a 64 MB buffer from 1 to --threads threads. Output is a text table, CSV or JSON so
+ * runs can be compared across machines and commits.
+ *
+ * --workload runs a single operation a fixed number of times with no
+ * timing or calibration, so an instruction-counting emulator sees the same
+ * work on every run (see perf-matrix.sh).
+ *
+ * Ticks come from the TSC on x86 (constant reference cycles, not core
+ * cycles under turbo) and from CNTVCT_EL0 on ARM64; the ns column is
+ * calibrated against CLOCK_MONOTONIC.
+ */
+
+#define _POSIX_C_SOURCE 200809L  /* clock_gettime, pthread_barrier */
+#define TRUERANDOM_IMPLEMENTATION
+#include "truerandom.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define BENCH_DEFAULT_MAX_SIZE   (1024ull * 1024 * 1024)
+#define BENCH_DEFAULT_SAMPLES    100000
+#define BENCH_WARMUP             10000
+#define BENCH_TARGET_BYTES       (16u * 1024 * 1024)  /* Work per throughput trial */
+#define BENCH_TRIALS             3
+#define BENCH_PARALLEL_SIZE      (64u * 1024 * 1024)  /* Buffer for the fill_parallel sweep */
+
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON } bench_format_t;
+
+/**
+ * @brief One result row; unused metrics are negative and left out of the output
+ */
+typedef struct {
+    const char *kind;       /* "latency", "throughput", "contention" or "parallel" */
+    const char *name;
+    uint64_t bytes;
+    unsigned int threads;
+    double ticks;           /* Mean ticks per call */
+    double p50, p99, p999;  /* Ticks per call */
+    double ns;              /* Mean ns per call */
+    double gbps;
+    double mops;            /* Aggregate million calls per second */
+} bench_row_t;
+
+static bench_format_t format = FORMAT_TEXT;
+static int rows_emitted = 0;
+static const char *last_kind = NULL;
+static double ticks_per_ns = 1.0;
+
+/*
+ * Timing
+ */
+
+static inline uint64_t
+bench_ticks(void) {
+#if defined(truernd_ARCH_X86)
+    uint32_t lo, hi;
+    __asm__ volatile("lfence\n\trdtsc" : "=a"(lo), "=d"(hi) : : "memory");
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(v) : : "memory");
+    return v;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static double
+bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+/**
+ * @brief Measure the tick rate against CLOCK_MONOTONIC over ~50 ms
+ */
+static void
+bench_calibrate(void) {
+    double t0 = bench_now_ns();
+    uint64_t c0 = bench_ticks();
+    while (bench_now_ns() - t0 < 50e6) { }
+    uint64_t c1 = bench_ticks();
+    double t1 = bench_now_ns();
+    ticks_per_ns = (double)(c1 - c0) / (t1 - t0);
+    if (ticks_per_ns <= 0.0) ticks_per_ns = 1.0;
+}
+
+static int
+cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+static double
+percentile(const uint64_t *sorted, size_t n, double p) {
+    size_t i = (size_t)(p * (double)(n - 1));
+    return (double)sorted[i];
+}
+
+/*
+ * Output
+ */
+
+static void
+emit_metric(const char *key, double v, const char *fmt, int width) {
+    if (format == FORMAT_CSV) {
+        if (v >= 0.0) printf(",%.6g", v);
+        else printf(",");
+    } else if (format == FORMAT_JSON) {
+        if (v >= 0.0) printf(", \"%s\": %.6g", key, v);
+    } else if (width > 0) {
+        if (v >= 0.0) printf(fmt, width, v);
+        else printf("%*s", width, "-");
+    }
+}
+
+static void
+emit_row(const bench_row_t *r) {
+    if (format == FORMAT_CSV) {
+        printf("%s,%s,%llu,%u", r->kind, r->name, (unsigned long long)r->bytes, r->threads);
+    } else if (format == FORMAT_JSON) {
+        printf("%s\n    {\"kind\": \"%s\", \"name\": \"%s\", \"bytes\": %llu, \"threads\": %u",
+               rows_emitted ? "," : "", r->kind, r->name, (unsigned long long)r->bytes, r->threads);
+    } else {
+        if (!last_kind || strcmp(last_kind, r->kind) != 0) {
+            printf("\n[%s]\n%-16s %12s %7s %10s %10s %10s %10s %10s %9s %9s\n", r->kind,
+                   "name", "bytes", "threads", "ticks", "p50", "p99", "p99.9", "ns", "GB/s", "Mops/s");
+            last_kind = r->kind;
+        }
+        printf("%-16s %12llu %7u", r->name, (unsigned long long)r->bytes, r->threads);
+    }
+    emit_metric("ticks", r->ticks, " %*.1f", 10);
+    emit_metric("p50", r->p50, " %*.0f", 10);
+    emit_metric("p99", r->p99, " %*.0f", 10);
+    emit_metric("p999", r->p999, " %*.0f", 10);
+    emit_metric("ns", r->ns, " %*.2f", 10);
+    emit_metric("gbps", r->gbps, " %*.3f", 9);
+    emit_metric("mops", r->mops, " %*.4g", 9);
+    printf(format == FORMAT_JSON ? "}" : "\n");
+    rows_emitted++;
+    fflush(stdout);
+}
+
+static const char *
+cpu_model(void) {
+    static char model[128] = "unknown";
+    FILE *f = fopen("/proc/cpuinfo", "r");
+    if (!f) return model;
+    char line[256];
+    while (fgets(line, sizeof(line), f)) {
+        char *colon = strchr(line, ':');
+        if (colon && strncmp(line, "model name", 10) == 0) {
+            colon += 2;
+            colon[strcspn(colon, "\n")] = '\0';
+            for (char *p = colon; *p; p++) if (*p == '"' || *p == '\\') *p = ' ';
+            snprintf(model, sizeof(model), "%s", colon);
+            break;
+        }
+    }
+    fclose(f);
+    return model;
+}
+
+static void
+emit_begin(void) {
+    unsigned int caps = truernd_capabilities();
+    if (format == FORMAT_CSV) {
+        printf("kind,name,bytes,threads,ticks,p50,p99,p999,ns,gbps,mops\n");
+    } else if (format == FORMAT_JSON) {
+        printf("{\n  \"cpu\": \"%s\",\n  \"caps\": %u,\n  \"cpus\": %u,\n"
+               "  \"ticks_per_ns\": %.6g,\n  \"backend\": \"%s\",\n  \"results\": [",
+               cpu_model(), caps, truernd_cpu_count(), ticks_per_ns,
+               truernd_backend_name(truernd_get_backend()));
+    } else {
+        printf("cpu: %s\ncpus: %u, caps: 0x%x, ticks/ns: %.3f, default backend: %s\n",
+               cpu_model(), truernd_cpu_count(), caps, ticks_per_ns,
+               truernd_backend_name(truernd_get_backend()));
+    }
+}
+
+static void
+emit_end(void) {
+    if (format == FORMAT_JSON) printf("\n  ]\n}\n");
+}
+
+/*
+ * Per-call latency
+ */
+
+static volatile uint64_t sink;
+
+static int op_get32(void)      { uint32_t v = 0; int rc = truernd_get32(&v); sink += v; return rc; }
+static int op_get64(void)      { uint64_t v = 0; int rc = truernd_get64(&v); sink += v; return rc; }
+static int op_get64_abi(void)  { uint64_t v = 0; int rc = (truernd_get64)(&v); sink += v; return rc; }
+static int op_get32_split(void){ uint32_t v = 0; int rc = truernd_get32_split(&v); sink += v; return rc; }
+static int op_get8(void)       { uint8_t v = 0; int rc = truernd_get8(&v); sink += v; return rc; }
+static int op_pool_get64(void) { uint64_t v = 0; int rc = truernd_pool_get64(truernd_pool_local(), &v); sink += v; return rc; }
+static int op_uniform(void)    { sink += truernd_uniform_u32(1000); return 0; }
+static int op_double01(void)   { sink += (uint64_t)(truernd_double01() * 1e6); return 0; }
+
+static int
+op_fill8(void) {
+    uint64_t v = 0;
+    int rc = truernd_fill(&v, sizeof(v));
+    sink += v;
+    return rc;
+}
+
+static int
+op_uuid4_str(void) {
+    char id[TRUERND_UUID_STR_LEN];
+    int rc = truernd_uuid4_str(id);
+    sink += (uint8_t)id[0];
+    return rc;
+}
+
+static int
+op_token32(void) {
+    char token[TRUERND_B64URL_LEN(32)];
+    int rc = truernd_token_b64url(token, 32);
+    sink += (uint8_t)token[0];
+    return rc;
+}
+
+static truernd_pool_t sliced_pool, async_pool;
+
+static int op_pool_sliced(void) { uint64_t v = 0; int rc = truernd_pool_get64(&sliced_pool, &v); sink += v; return rc; }
+static int op_pool_async(void)  { uint64_t v = 0; int rc = truernd_pool_get64(&async_pool, &v); sink += v; return rc; }
+
+static truernd_ring_slot_t ring_slots[1024];
+static truernd_ring_t ring;
+
+static int
+op_ring32(void) {
+    uint64_t v[4];
+    int rc = truernd_ring_get(&ring, v, sizeof(v));
+    sink += v[0];
+    return rc;
+}
+
+static truernd_ring_group_t ring_group;
+
+static int
+op_ring_group32(void) {
+    uint64_t v[4];
+    int rc = truernd_ring_group_get(&ring_group, v, sizeof(v));
+    sink += v[0];
+    return rc;
+}
+
+static const struct {
+    const char *name;
+    int (*op)(void);
+} latency_ops[] = {
+    { "get32",       op_get32 },
+    { "get64",       op_get64 },
+    { "get64_abi",   op_get64_abi },
+    { "get32_split", op_get32_split },
+    { "get8",        op_get8 },
+    { "pool_get64",  op_pool_get64 },
+    { "pool_sliced", op_pool_sliced },
+    { "pool_async",  op_pool_async },
+    { "uniform_u32", op_uniform },
+    { "double01",    op_double01 },
+    { "fill_8",      op_fill8 },
+    { "uuid4_str",   op_uuid4_str },
+    { "token_32",    op_token32 },
+    { "ring_get32",  op_ring32 },   /* Against a background producer */
+    { "ring_node32", op_ring_group32 },  /* Node-local ring, producer per node */
+};
+
+static int
+bench_latency(size_t samples) {
+    uint64_t *t = malloc(samples * sizeof(*t));
+    if (!t) return -1;
+
+    /* Cost of an empty timed region, subtracted from every sample */
+    for (size_t i = 0; i < samples; i++) {
+        uint64_t a = bench_ticks();
+        t[i] = bench_ticks() - a;
+    }
+    qsort(t, samples, sizeof(*t), cmp_u64);
+    uint64_t overhead = t[samples / 2];
+
+    if (truernd_ring_init(&ring, ring_slots, sizeof(ring_slots) / sizeof(ring_slots[0]), 32) != 0 ||
+        truernd_ring_start(&ring) != 0 ||
+        truernd_ring_group_init(&ring_group, 1024, 32) != 0 ||
+        truernd_ring_group_start(&ring_group) != 0 ||
+        truernd_pool_set_mode(&sliced_pool, TRUERND_POOL_SLICED) != 0 ||
+        truernd_pool_set_mode(&async_pool, TRUERND_POOL_ASYNC) != 0) {
+        free(t);
+        return -1;
+    }
+
+    for (size_t k = 0; k < sizeof(latency_ops) / sizeof(latency_ops[0]); k++) {
+        int (*op)(void) = latency_ops[k].op;
+        for (int i = 0; i < BENCH_WARMUP; i++) op();
+
+        /* Mean from one timed batch, so timer cost is amortised away */
+        double n0 = bench_now_ns();
+        uint64_t c0 = bench_ticks();
+        for (size_t i = 0; i < samples; i++) {
+            if (op() != 0) {
+                truernd_ring_stop(&ring);
+                truernd_ring_group_free(&ring_group);
+                free(t);
+                return -1;
+            }
+        }
+        uint64_t c1 = bench_ticks();
+        double n1 = bench_now_ns();
+
+        /* Tail latency needs every call timed on its own */
+        for (size_t i = 0; i < samples; i++) {
+            uint64_t a = bench_ticks();
+            op();
+            uint64_t d = bench_ticks() - a;
+            t[i] = d > overhead ? d - overhead : 0;
+        }
+        qsort(t, samples, sizeof(*t), cmp_u64);
+
+        bench_row_t r = { "latency", latency_ops[k].name, 0, 1,
+                          (double)(c1 - c0) / (double)samples,
+                          percentile(t, samples, 0.50), percentile(t, samples, 0.99),
+                          percentile(t, samples, 0.999),
+                          (n1 - n0) / (double)samples, -1.0,
+                          (double)samples / ((n1 - n0) / 1e3) };
+        emit_row(&r);
+    }
+
+    truernd_ring_stop(&ring);
+    truernd_ring_group_free(&ring_group);
+    free(t);
+    return 0;
+}
+
+/*
+ * Fill throughput
+ */
+
+/**
+ * @brief Reference fill: one truernd_get64() per 8 bytes, stored byte by byte
+ */
+static int
+legacy_fill(void *buf, size_t len) {
+    uint8_t *ptr = (uint8_t*)buf;
+
+    while (len > 0) {
+        uint64_t val;
+        int retries = 0;
+        while (truernd_get64(&val) != 0) {
+            if (++retries >= TRUERND_MAX_RETRIES) return -1;
+        }
+        size_t n = len < 8 ? len : 8;
+        for (size_t i = 0; i < n; i++) {
+            *ptr++ = (uint8_t)(val >> (i * 8));
+        }
+        len -= n;
+    }
+
+    return 0;
+}
+
+static int fill_cached(void *buf, size_t len) { return truernd_fill_ex(buf, len, TRUERND_FILL_CACHED); }
+static int fill_nt(void *buf, size_t len)     { return truernd_fill_ex(buf, len, TRUERND_FILL_NT); }
+
+static int
+bench_throughput_one(const char *name, int (*fill)(void*, size_t), uint8_t *buf, uint64_t size) {
+    uint64_t reps = BENCH_TARGET_BYTES / size;
+    if (reps == 0) reps = 1;
+    int trials = size > BENCH_TARGET_BYTES ? 1 : BENCH_TRIALS;
+    double best_ns = 0.0;
+    uint64_t best_ticks = 0;
+
+    if (fill(buf, (size_t)size) != 0) return -1;  /* Warm caches and lazy setup */
+    for (int trial = 0; trial < trials; trial++) {
+        double n0 = bench_now_ns();
+        uint64_t c0 = bench_ticks();
+        for (uint64_t i = 0; i < reps; i++) {
+            if (fill(buf, (size_t)size) != 0) return -1;
+        }
+        uint64_t c1 = bench_ticks();
+        double elapsed = bench_now_ns() - n0;
+        if (trial == 0 || elapsed < best_ns) {
+            best_ns = elapsed;
+            best_ticks = c1 - c0;
+        }
+    }
+
+    bench_row_t r = { "throughput", name, size, 1,
+                      (double)best_ticks / (double)reps, -1.0, -1.0, -1.0,
+                      best_ns / (double)reps, (double)(size * reps) / best_ns,
+                      (double)reps / (best_ns / 1e3) };
+    emit_row(&r);
+    return 0;
+}
+
+static int
+bench_throughput(uint64_t max_size) {
+    uint8_t *buf = malloc((size_t)max_size);
+    if (!buf) {
+        fprintf(stderr, "bench: cannot allocate %llu bytes, lower --max-size\n",
+                (unsigned long long)max_size);
+        return -1;
+    }
+    memset(buf, 0, (size_t)max_size);  /* Fault pages in before timing */
+
+    truernd_backend_t bound = truernd_get_backend();
+    for (uint64_t size = 8; size <= max_size; size *= 8) {
+        if (bench_throughput_one("legacy_get64", legacy_fill, buf, size) != 0) goto fail;
+        for (int b = TRUERND_BACKEND_HW; b < TRUERND_BACKEND_COUNT; b++) {
+            if (truernd_set_backend((truernd_backend_t)b) != 0) continue;
+            if (bench_throughput_one(truernd_backend_name((truernd_backend_t)b),
+                                     truernd_fill, buf, size) != 0) goto fail;
+        }
+        truernd_set_backend(bound);
+        /* Store policy on the default backend; plain rows switch at TRUERND_NT_THRESHOLD */
+        if (bench_throughput_one("cached_stores", fill_cached, buf, size) != 0) goto fail;
+        if (bench_throughput_one("nt_stores", fill_nt, buf, size) != 0) goto fail;
+        if (size > max_size / 8) break;
+    }
+    free(buf);
+    return 0;
+
+fail:
+    truernd_set_backend(bound);
+    free(buf);
+    return -1;
+}
+
+/*
+ * Contention sweep
+ */
+
+typedef struct {
+    pthread_barrier_t *start;
+    int (*op)(void);
+    int calls;
+    int failed;
+} contention_arg_t;
+
+static void *
+contention_worker(void *p) {
+    contention_arg_t *a = (contention_arg_t*)p;
+    pthread_barrier_wait(a->start);
+    for (int i = 0; i < a->calls; i++) {
+        if (a->op() != 0) a->failed = 1;
+    }
+    return NULL;
+}
+
+static int
+op_fill4k(void) {
+    static TRUERND_TLS uint8_t buf[4096];
+    return truernd_fill(buf, sizeof(buf));
+}
+
+static const struct {
+    const char *name;
+    int (*op)(void);
+    size_t bytes;
+    int calls;  /* Per thread */
+} contention_ops[] = {
+    { "get64",      op_get64,      8,    200000 },
+    { "pool_get64", op_pool_get64, 8,    200000 },
+    { "fill_4k",    op_fill4k,     4096, 2000 },
+};
+
+static int
+bench_contention(unsigned int max_threads) {
+    pthread_t *tids = malloc(max_threads * sizeof(*tids));
+    contention_arg_t *args = malloc(max_threads * sizeof(*args));
+    if (!tids || !args) { free(tids); free(args); return -1; }
+
+    for (size_t k = 0; k < sizeof(contention_ops) / sizeof(contention_ops[0]); k++) {
+        for (unsigned int threads = 1; ; threads *= 2) {
+            if (threads > max_threads) threads = max_threads;
+
+            pthread_barrier_t start;
+            pthread_barrier_init(&start, NULL, threads + 1);
+            unsigned int spawned = 0;
+            for (; spawned < threads; spawned++) {
+                args[spawned].start = &start;
+                args[spawned].op = contention_ops[k].op;
+                args[spawned].calls = contention_ops[k].calls;
+                args[spawned].failed = 0;
+                if (pthread_create(&tids[spawned], NULL, contention_worker, &args[spawned]) != 0) break;
+            }
+            if (spawned < threads) {
+                /* Can't release a barrier sized for threads that never started */
+                fprintf(stderr, "bench: could not start %u threads\n", threads);
+                exit(1);
+            }
+
+            pthread_barrier_wait(&start);
+            double n0 = bench_now_ns();
+            uint64_t c0 = bench_ticks();
+            int failed = 0;
+            for (unsigned int i = 0; i < threads; i++) {
+                pthread_join(tids[i], NULL);
+                failed |= args[i].failed;
+            }
+            uint64_t c1 = bench_ticks();
+            double elapsed = bench_now_ns() - n0;
+            pthread_barrier_destroy(&start);
+            if (failed) { free(tids); free(args); return -1; }
+
+            int per_thread = contention_ops[k].calls;
+            double calls = (double)threads * per_thread;
+            bench_row_t r = { "contention", contention_ops[k].name, contention_ops[k].bytes, threads,
+                              /* Wall ticks per call per thread: flat means no contention */
+                              (double)(c1 - c0) / per_thread, -1.0, -1.0, -1.0,
+                              elapsed / per_thread,
+                              calls * (double)contention_ops[k].bytes / elapsed,
+                              calls / (elapsed / 1e3) };
+            emit_row(&r);
+            if (threads == max_threads) break;
+        }
+    }
+
+    free(tids);
+    free(args);
+    return 0;
+}
+
+/*
+ * Parallel fill scaling
+ */
+
+/**
+ * @brief One truernd_fill_parallel() of a fixed buffer per thread count, 1, 2, 4 ... max_threads
+ */
+static int
+bench_parallel(unsigned int max_threads) {
+    uint8_t *buf = malloc(BENCH_PARALLEL_SIZE);
+    if (!buf) return -1;
+    memset(buf, 0, BENCH_PARALLEL_SIZE);  /* Fault pages in before timing */
+
+    for (unsigned int threads = 1; ; threads *= 2) {
+        if (threads > max_threads) threads = max_threads;
+        if (truernd_fill_parallel(buf, BENCH_PARALLEL_SIZE, threads) != 0) {  /* Warm up */
+            free(buf);
+            return -1;
+        }
+
+        double best_ns = 0.0;
+        uint64_t best_ticks = 0;
+        for (int trial = 0; trial < BENCH_TRIALS; trial++) {
+            double n0 = bench_now_ns();
+            uint64_t c0 = bench_ticks();
+            int rc = truernd_fill_parallel(buf, BENCH_PARALLEL_SIZE, threads);
+            uint64_t c1 = bench_ticks();
+            double elapsed = bench_now_ns() - n0;
+            if (rc != 0) {
+                free(buf);
+                return -1;
+            }
+            if (trial == 0 || elapsed < best_ns) {
+                best_ns = elapsed;
+                best_ticks = c1 - c0;
+            }
+        }
+
+        bench_row_t r = { "parallel", "fill_parallel", BENCH_PARALLEL_SIZE, threads,
+                          (double)best_ticks, -1.0, -1.0, -1.0, best_ns,
+                          (double)BENCH_PARALLEL_SIZE / best_ns, 1e3 / best_ns };
+        emit_row(&r);
+        if (threads == max_threads) break;
+    }
+
+    free(buf);
+    return 0;
+}
+
+/*
+ * Fixed workloads
+ */
+
+static int
+op_fill64k(void) {
+    static uint8_t buf[64 * 1024];
+    return truernd_fill(buf, sizeof(buf));
+}
+
+static int
+op_fill_nt1m(void) {
+    static uint8_t buf[1024 * 1024];
+    return truernd_fill_ex(buf, sizeof(buf), TRUERND_FILL_NT);
+}
+
+/* Single-threaded only: a ring producer or prefetch helper would add
+ * instructions that vary from run to run */
+static const struct {
+    const char *name;
+    int (*op)(void);
+} workload_ops[] = {
+    { "fill_64k",   op_fill64k },
+    { "fill_nt_1m", op_fill_nt1m },
+};
+
+static int
+bench_workload(const char *name, size_t samples) {
+    int (*op)(void) = NULL;
+    for (size_t k = 0; k < sizeof(latency_ops) / sizeof(latency_ops[0]); k++) {
+        if (strcmp(name, latency_ops[k].name) == 0) op = latency_ops[k].op;
+    }
+    for (size_t k = 0; k < sizeof(workload_ops) / sizeof(workload_ops[0]); k++) {
+        if (strcmp(name, workload_ops[k].name) == 0) op = workload_ops[k].op;
+    }
+    if (!op || op == op_pool_async || op == op_ring32 || op == op_ring_group32) return -1;
+    if (op == op_pool_sliced && truernd_pool_set_mode(&sliced_pool, TRUERND_POOL_SLICED) != 0) return -1;
+
+    for (size_t i = 0; i < samples; i++) {
+        if (op() != 0) return -1;
+    }
+    return 0;
+}
+
+/*
+ * Driver
+ */
+
+static void
+usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--format text|csv|json] [--max-size BYTES[K|M|G]] [--threads N]\n"
+            "          [--samples N] [--only latency|throughput|contention|parallel] [--backend NAME]\n"
+            "       %s --workload OP [--samples N] [--backend NAME]\n", argv0, argv0);
+}
+
+static uint64_t
+parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; break;
+        case 'm': case 'M': v <<= 20; break;
+        case 'g': case 'G': v <<= 30; break;
+        default: break;
+    }
+    return (uint64_t)v;
+}
+
+int
+main(int argc, char **argv) {
+    uint64_t max_size = BENCH_DEFAULT_MAX_SIZE;
+    unsigned int max_threads = truernd_cpu_count() * 2;
+    size_t samples = BENCH_DEFAULT_SAMPLES;
+    const char *only = NULL;
+    const char *workload = NULL;
+    truernd_backend_t backend = truernd_get_backend();
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--format") == 0 && val) {
+            if (strcmp(val, "csv") == 0) format = FORMAT_CSV;
+            else if (strcmp(val, "json") == 0) format = FORMAT_JSON;
+            else if (strcmp(val, "text") == 0) format = FORMAT_TEXT;
+            else { usage(argv[0]); return 2; }
+        } else if (strcmp(arg, "--max-size") == 0 && val) {
+            max_size = parse_size(val);
+        } else if (strcmp(arg, "--threads") == 0 && val) {
+            max_threads = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(arg, "--samples") == 0 && val) {
+            samples = (size_t)strtoull(val, NULL, 10);
+        } else if (strcmp(arg, "--only") == 0 && val) {
+            only = val;
+        } else if (strcmp(arg, "--workload") == 0 && val) {
+            workload = val;
+        } else if (strcmp(arg, "--backend") == 0 && val) {
+            int b;
+            for (b = 0; b < TRUERND_BACKEND_COUNT; b++) {
+                if (strcmp(val, truernd_backend_name((truernd_backend_t)b)) == 0) break;
+            }
+            if (b == TRUERND_BACKEND_COUNT) { usage(argv[0]); return 2; }
+            backend = (truernd_backend_t)b;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (max_size < 8 || max_threads == 0 || (samples == 0 && !workload)) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (!truernd_is_supported()) {
+        fprintf(stderr, "bench: no hardware random number generator on this CPU\n");
+        return 1;
+    }
+    if (truernd_set_backend(backend) != 0) {
+        fprintf(stderr, "bench: backend %s is not available here\n", truernd_backend_name(backend));
+        return 1;
+    }
+
+    /* --samples 0 gives the setup cost to subtract */
+    if (workload) {
+        if (bench_workload(workload, samples) == 0) return 0;
+        fprintf(stderr, "bench: unknown or multi-threaded workload %s, or it failed\n", workload);
+        return 1;
+    }
+
+    bench_calibrate();
+    emit_begin();
+    int rc = 0;
+    if (!only || strcmp(only, "latency") == 0)    rc |= bench_latency(samples);
+    if (!only || strcmp(only, "throughput") == 0) rc |= bench_throughput(max_size);
+    if (!only || strcmp(only, "contention") == 0) rc |= bench_contention(max_threads);
+    if (!only || strcmp(only, "parallel") == 0)   rc |= bench_parallel(max_threads);
+    emit_end();
+
+    if (rc != 0) fprintf(stderr, "bench: a benchmark failed to generate random data\n");
+    return rc != 0;
+}
@@ -0,0 +1,132 @@
+#!/bin/sh
+#
+# Build bench.c for every variant x optimisation level x -march and collect
+# the results per architecture, so a regression in truerandom.h shows up
+# against the variant that caused it.
+#
+#   perf/native.csv  bench --format csv rows from the host CPU
+#   perf/qemu.csv    instructions per operation for aarch64, under qemu
+#
+# Instruction counts come from the insn plugin of qemu (libinsn.so), using
+# bench --workload: the same fixed loop is run with --samples N and with
+# --samples 0, and the difference is divided by N. The qemu half is skipped
+# when the cross compiler, qemu or the plugin is missing.
+#
+# Everything can be overridden from the environment, e.g.
+#   PERF_VARIANTS="inline naked" PERF_OPTS=-O3 make perf-matrix
+
+set -eu
+
+CC=${CC:-gcc}
+ARM_CC=${ARM_CC:-aarch64-linux-gnu-gcc}
+QEMU=${QEMU:-qemu-aarch64-static}
+QEMU_PLUGIN=${QEMU_PLUGIN:-}
+QEMU_SAMPLES=${QEMU_SAMPLES:-10000}
+OUT=${OUT:-perf}
+PERF_VARIANTS=${PERF_VARIANTS:-inline naked pool256 nt-off nt-64k}
+PERF_OPTS=${PERF_OPTS:--O2 -O3}
+PERF_BENCH_ARGS=${PERF_BENCH_ARGS:---max-size 16M --samples 20000 --threads 4}
+QEMU_MARCH=${QEMU_MARCH:-armv8-a+rng armv8-a+rng+crypto}
+QEMU_OPS=${QEMU_OPS:-get32 get64 get64_abi get32_split get8 pool_get64 pool_sliced uniform_u32 fill_8 fill_64k fill_64k@drbg-aes fill_64k@drbg-chacha20 fill_nt_1m}
+CFLAGS="-Wall -Wextra -std=c99"
+
+HOST=$(uname -m)
+case $HOST in
+    x86_64|amd64)  PERF_MARCH=${PERF_MARCH:-x86-64 x86-64-v3} ;;
+    aarch64|arm64) PERF_MARCH=${PERF_MARCH:-armv8-a+rng armv8.2-a+rng+crypto} ;;
+    *)             PERF_MARCH=${PERF_MARCH:-native} ;;
+esac
+
+# The backend paths each variant pins down; the DRBG rows (AES-NI or NEON
+# AES, ChaCha20) are in every build, chosen at run time
+variant_flags() {
+    case $1 in
+        inline)  echo "-DTRUERND_INLINE_GETTERS=1" ;;
+        naked)   echo "-DTRUERND_INLINE_GETTERS=0" ;;
+        pool256) echo "-DTRUERND_POOL_WORDS=256 -DTRUERND_POOL_PREFETCH_AT=128" ;;
+        nt-off)  echo "-DTRUERND_NT_THRESHOLD=0" ;;
+        nt-64k)  echo "-DTRUERND_NT_THRESHOLD=65536" ;;
+        *)       echo "perf-matrix: unknown variant $1" >&2; exit 2 ;;
+    esac
+}
+
+mkdir -p "$OUT"
+
+#
+# Native throughput and latency
+#
+
+native=$OUT/native.csv
+echo "arch,variant,opt,march,kind,name,bytes,threads,ticks,p50,p99,p999,ns,gbps,mops" > "$native"
+for v in $PERF_VARIANTS; do
+    flags=$(variant_flags "$v")
+    for o in $PERF_OPTS; do
+        for m in $PERF_MARCH; do
+            bin=$OUT/bench-$HOST-$v$o-$m
+            echo "perf-matrix: $HOST $v $o -march=$m" >&2
+            # shellcheck disable=SC2086
+            $CC $CFLAGS $o -march=$m $flags bench.c -o "$bin" -pthread
+            # shellcheck disable=SC2086
+            if ! "./$bin" --format csv $PERF_BENCH_ARGS > "$bin.csv"; then
+                echo "perf-matrix: $bin did not run here, skipped" >&2
+                continue
+            fi
+            tail -n +2 "$bin.csv" | sed "s/^/$HOST,$v,$o,$m,/" >> "$native"
+        done
+    done
+done
+
+#
+# aarch64 instruction counts under qemu
+#
+
+if [ -z "$QEMU_PLUGIN" ]; then
+    for p in /usr/lib/qemu/plugins/libinsn.so /usr/local/lib/qemu/plugins/libinsn.so \
+             /usr/lib/x86_64-linux-gnu/qemu/plugins/libinsn.so; do
+        if [ -f "$p" ]; then QEMU_PLUGIN=$p; break; fi
+    done
+fi
+if ! command -v "$ARM_CC" > /dev/null 2>&1 || ! command -v "$QEMU" > /dev/null 2>&1 ||
+   [ ! -f "${QEMU_PLUGIN:-/nonexistent}" ]; then
+    echo "perf-matrix: $ARM_CC, $QEMU or libinsn.so (QEMU_PLUGIN) missing, no instruction counts" >&2
+    exit 0
+fi
+
+# Instructions retired by one bench --workload run
+insns() {
+    log=$OUT/insn.log
+    if ! "$QEMU" -cpu max -plugin "$QEMU_PLUGIN" -d plugin -D "$log" "$@" > /dev/null 2>&1; then
+        return 1
+    fi
+    sed -n 's/.*insns: *\([0-9][0-9]*\).*/\1/p' "$log" | tail -n 1
+}
+
+qemu_csv=$OUT/qemu.csv
+echo "arch,variant,opt,march,op,backend,insns_per_op" > "$qemu_csv"
+for v in $PERF_VARIANTS; do
+    flags=$(variant_flags "$v")
+    for o in $PERF_OPTS; do
+        for m in $QEMU_MARCH; do
+            bin=$OUT/bench-aarch64-$v$o-$m
+            echo "perf-matrix: aarch64 (qemu) $v $o -march=$m" >&2
+            # shellcheck disable=SC2086
+            $ARM_CC $CFLAGS $o -march=$m $flags -static bench.c -o "$bin" -pthread
+            for spec in $QEMU_OPS; do
+                op=${spec%@*}
+                backend=auto
+                case $spec in *@*) backend=${spec#*@} ;; esac
+                n=$QEMU_SAMPLES
+                case $op in fill_*k|fill_*m) n=$((QEMU_SAMPLES / 100)) ;; esac
+                [ "$n" -gt 0 ] || n=1
+
+                per_op=-
+                if base=$(insns "$bin" --workload "$op" --samples 0 --backend "$backend") &&
+                   total=$(insns "$bin" --workload "$op" --samples "$n" --backend "$backend") &&
+                   [ -n "$base" ] && [ -n "$total" ]; then
+                    per_op=$(awk "BEGIN { printf \"%.1f\", ($total - $base) / $n }")
+                fi
+                echo "aarch64,$v,$o,$m,$op,$backend,$per_op" >> "$qemu_csv"
+            done
+        done
+    done
+done
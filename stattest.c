@@ -0,0 +1,502 @@
+/**
+ * @file stattest.c
+ * @brief Statistical quality battery for truerandom.h
+ *
+ * Streams --bytes of output from one backend through monobit, runs,
+ * byte-frequency chi-square, serial correlation and birthday spacings
+ * tests, and prints a p-value per test as a text table, CSV or JSON. Meant
+ * for qualifying the hardware RNG on a new host class; the unit tests in
+ * test.c only smoke-check the output.
+ *
+ * Worker threads each claim --block sized chunks, fill them and fold them
+ * into private counters, which are summed at the end, so the battery
+ * scales with cores. Blocks are filled with TRUERND_FILL_CACHED, whatever
+ * --block is, so they are still in cache when the kernels read them. Bit
+ * counting uses AVX2 nibble lookups where available (POPCNT / CNT
+ * otherwise), the serial sums use AVX2 byte multiplies, and the byte
+ * histogram is spread over four tables so repeated bytes do not serialize
+ * on one counter.
+ *
+ * Runs and serial correlation are counted within blocks only; the pairs
+ * spanning block boundaries are left out, which costs nothing in power.
+ */
+
+#define _POSIX_C_SOURCE 200809L  /* clock_gettime, posix_memalign */
+#define TRUERANDOM_IMPLEMENTATION
+#include "truerandom.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define STAT_DEFAULT_BYTES  (1024ull * 1024 * 1024)
+#define STAT_DEFAULT_BLOCK  (1024u * 1024u)
+#define STAT_DEFAULT_ALPHA  1e-4
+#define STAT_MAX_THREADS    256
+
+/* Birthday spacings: 512 birthdays in a 2^24 day year, lambda = m^3 / 4n = 2 */
+#define STAT_BDAY_M         512
+#define STAT_BDAY_BITS      24
+#define STAT_BDAY_STRIDE    (256u * 1024u)  /* One sample per this many bytes */
+
+typedef enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON } stat_format_t;
+
+/**
+ * @brief Counters for one thread, summed into the totals at the end
+ */
+typedef struct {
+    uint64_t bytes;
+    uint64_t ones;          /* Set bits */
+    uint64_t flips;         /* Adjacent bit pairs that differ */
+    uint64_t bit_pairs;
+    uint64_t hist[256];
+    uint64_t sx, sxx;       /* Sum and sum of squares of bytes */
+    uint64_t sxy;           /* Sum of products of adjacent bytes */
+    uint64_t byte_pairs;
+    uint64_t bday_samples;
+    uint64_t bday_dups;
+    int failed;             /* The backend failed to generate data */
+} stat_acc_t;
+
+/**
+ * @brief One result row
+ */
+typedef struct {
+    const char *name;
+    double stat;            /* z score, or chi-square for the byte frequencies */
+    double p;               /* Negative when there was too little data */
+} stat_row_t;
+
+typedef struct {
+    stat_acc_t acc;
+    uint64_t *next;         /* Shared offset of the next unclaimed block */
+    uint64_t total;
+    size_t block;
+} stat_worker_t;
+
+static stat_format_t format = FORMAT_TEXT;
+
+/*
+ * Kernels
+ */
+
+/* Set bits and bit flips of n words, including the flips between words */
+static void
+stat_bits_scalar(const uint64_t *w, size_t n, uint64_t *ones, uint64_t *flips) {
+    uint64_t o = 0, f = 0;
+    for (size_t i = 0; i < n; i++) {
+        o += (uint64_t)__builtin_popcountll(w[i]);
+        f += (uint64_t)__builtin_popcountll((w[i] ^ (w[i] >> 1)) & 0x7FFFFFFFFFFFFFFFull);
+        if (i + 1 < n) f += (w[i] >> 63) ^ (w[i + 1] & 1);
+    }
+    *ones += o;
+    *flips += f;
+}
+
+/* Byte histogram over four tables, eight bytes per load */
+static void
+stat_hist_scalar(const uint8_t *p, size_t n, uint64_t *hist) {
+    uint32_t h[4][256];
+    memset(h, 0, sizeof(h));
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t v;
+        memcpy(&v, p + i, 8);
+        h[0][v & 0xFF]++;
+        h[1][(v >> 8) & 0xFF]++;
+        h[2][(v >> 16) & 0xFF]++;
+        h[3][(v >> 24) & 0xFF]++;
+        h[0][(v >> 32) & 0xFF]++;
+        h[1][(v >> 40) & 0xFF]++;
+        h[2][(v >> 48) & 0xFF]++;
+        h[3][v >> 56]++;
+    }
+    for (; i < n; i++) h[0][p[i]]++;
+    for (int b = 0; b < 256; b++) hist[b] += (uint64_t)h[0][b] + h[1][b] + h[2][b] + h[3][b];
+}
+
+static void
+stat_serial_scalar(const uint8_t *p, size_t n, uint64_t *sx, uint64_t *sxx, uint64_t *sxy) {
+    uint64_t s = 0, ss = 0, sp = 0;
+    for (size_t i = 0; i < n; i++) {
+        s += p[i];
+        ss += (uint64_t)p[i] * p[i];
+        if (i + 1 < n) sp += (uint64_t)p[i] * p[i + 1];
+    }
+    *sx += s;
+    *sxx += ss;
+    *sxy += sp;
+}
+
+#if TRUERND__HAVE_X86_SIMD
+
+static inline __attribute__((target("avx2"))) __m256i
+stat_popcnt_avx2(__m256i v) {
+    const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                         0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const __m256i nib = _mm256_set1_epi8(0x0F);
+    __m256i lo = _mm256_shuffle_epi8(lut, _mm256_and_si256(v, nib));
+    __m256i hi = _mm256_shuffle_epi8(lut, _mm256_and_si256(_mm256_srli_epi64(v, 4), nib));
+    return _mm256_sad_epu8(_mm256_add_epi8(lo, hi), _mm256_setzero_si256());
+}
+
+__attribute__((target("avx2"))) static void
+stat_bits_avx2(const uint64_t *w, size_t n, uint64_t *ones, uint64_t *flips) {
+    const __m256i low63 = _mm256_set1_epi64x(0x7FFFFFFFFFFFFFFFll);
+    const __m256i one = _mm256_set1_epi64x(1);
+    __m256i vo = _mm256_setzero_si256(), vf = _mm256_setzero_si256();
+    size_t i = 0;
+
+    /* Words i..i+3 against i+1..i+4 for the flips across word edges */
+    for (; i + 5 <= n; i += 4) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(w + i));
+        __m256i next = _mm256_loadu_si256((const __m256i*)(w + i + 1));
+        __m256i inner = _mm256_and_si256(_mm256_xor_si256(v, _mm256_srli_epi64(v, 1)), low63);
+        __m256i edge = _mm256_and_si256(_mm256_xor_si256(_mm256_srli_epi64(v, 63), next), one);
+        vo = _mm256_add_epi64(vo, stat_popcnt_avx2(v));
+        vf = _mm256_add_epi64(vf, _mm256_add_epi64(stat_popcnt_avx2(inner), edge));
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, vo);
+    *ones += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    _mm256_storeu_si256((__m256i*)lanes, vf);
+    *flips += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    /* The edge from word i - 1 into the tail was counted with word i - 1 */
+    stat_bits_scalar(w + i, n - i, ones, flips);
+}
+
+static inline __attribute__((target("avx2"))) void
+stat_add_u32x8(__m256i v, uint64_t *sum) {
+    uint32_t lanes[8];
+    _mm256_storeu_si256((__m256i*)lanes, v);
+    for (int j = 0; j < 8; j++) *sum += lanes[j];
+}
+
+/* 32 bytes per step against the same 32 shifted by one; the 32-bit lanes
+ * take at most 4 * 255^2 per step, so they are flushed every 8192 */
+__attribute__((target("avx2"))) static void
+stat_serial_avx2(const uint8_t *p, size_t n, uint64_t *sx, uint64_t *sxx, uint64_t *sxy) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i vs = zero;
+    size_t i = 0;
+
+    while (i + 33 <= n) {
+        __m256i vss = zero, vsp = zero;
+        size_t stop = i + 8192 * 32;
+        for (; i + 33 <= n && i < stop; i += 32) {
+            __m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+            __m256i y = _mm256_loadu_si256((const __m256i*)(p + i + 1));
+            __m256i xl = _mm256_unpacklo_epi8(x, zero), xh = _mm256_unpackhi_epi8(x, zero);
+            __m256i yl = _mm256_unpacklo_epi8(y, zero), yh = _mm256_unpackhi_epi8(y, zero);
+            vs = _mm256_add_epi64(vs, _mm256_sad_epu8(x, zero));
+            vss = _mm256_add_epi32(vss, _mm256_add_epi32(_mm256_madd_epi16(xl, xl), _mm256_madd_epi16(xh, xh)));
+            vsp = _mm256_add_epi32(vsp, _mm256_add_epi32(_mm256_madd_epi16(xl, yl), _mm256_madd_epi16(xh, yh)));
+        }
+        stat_add_u32x8(vss, sxx);
+        stat_add_u32x8(vsp, sxy);
+    }
+
+    uint64_t lanes[4];
+    _mm256_storeu_si256((__m256i*)lanes, vs);
+    *sx += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+
+    /* Byte i - 1 paired with byte i in the last vector step */
+    stat_serial_scalar(p + i, n - i, sx, sxx, sxy);
+}
+
+#endif /* TRUERND__HAVE_X86_SIMD */
+
+static int
+stat_cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Repeated values among the sorted spacings of one sample of birthdays */
+static uint64_t
+stat_bday_sample(const uint8_t *p) {
+    uint32_t days[STAT_BDAY_M], gaps[STAT_BDAY_M];
+    memcpy(days, p, sizeof(days));
+    for (int i = 0; i < STAT_BDAY_M; i++) days[i] &= (1u << STAT_BDAY_BITS) - 1;
+    qsort(days, STAT_BDAY_M, sizeof(days[0]), stat_cmp_u32);
+    gaps[0] = days[0];
+    for (int i = 1; i < STAT_BDAY_M; i++) gaps[i] = days[i] - days[i - 1];
+    qsort(gaps, STAT_BDAY_M, sizeof(gaps[0]), stat_cmp_u32);
+
+    uint64_t dups = 0;
+    for (int i = 1; i < STAT_BDAY_M; i++) dups += gaps[i] == gaps[i - 1];
+    return dups;
+}
+
+static void
+stat_block(stat_acc_t *a, const uint8_t *p, size_t n) {
+    size_t words = n / 8;
+#if TRUERND__HAVE_X86_SIMD
+    if (truernd_capabilities() & TRUERND_CAP_AVX2) {
+        stat_bits_avx2((const uint64_t*)p, words, &a->ones, &a->flips);
+        stat_serial_avx2(p, n, &a->sx, &a->sxx, &a->sxy);
+    } else
+#endif
+    {
+        stat_bits_scalar((const uint64_t*)p, words, &a->ones, &a->flips);
+        stat_serial_scalar(p, n, &a->sx, &a->sxx, &a->sxy);
+    }
+    stat_hist_scalar(p, n, a->hist);
+    a->bytes += n;
+    a->bit_pairs += words ? words * 64 - 1 : 0;
+    a->byte_pairs += n - 1;
+
+    for (size_t off = 0; off + STAT_BDAY_M * 4 <= n; off += STAT_BDAY_STRIDE) {
+        a->bday_dups += stat_bday_sample(p + off);
+        a->bday_samples++;
+    }
+}
+
+static void *
+stat_worker(void *arg) {
+    stat_worker_t *wk = (stat_worker_t*)arg;
+    uint8_t *buf = NULL;
+    if (posix_memalign((void**)&buf, 64, wk->block) != 0) {
+        wk->acc.failed = 1;
+        return NULL;
+    }
+
+    for (;;) {
+        uint64_t off = __atomic_fetch_add(wk->next, wk->block, __ATOMIC_RELAXED);
+        if (off >= wk->total) break;
+        size_t n = wk->total - off < wk->block ? (size_t)(wk->total - off) : wk->block;
+        n &= ~(size_t)7;
+        if (n == 0) break;
+        if (truernd_fill_ex(buf, n, TRUERND_FILL_CACHED) != 0) {
+            wk->acc.failed = 1;
+            break;
+        }
+        stat_block(&wk->acc, buf, n);
+    }
+    free(buf);
+    return NULL;
+}
+
+/*
+ * Statistics
+ */
+
+/* Two-sided p-value of a standard normal score */
+static double
+stat_p_normal(double z) {
+    return erfc(fabs(z) / sqrt(2.0));
+}
+
+/* Upper tail of chi-square with k degrees of freedom (Wilson-Hilferty) */
+static double
+stat_p_chi2(double x, double k) {
+    double z = (cbrt(x / k) - (1.0 - 2.0 / (9.0 * k))) / sqrt(2.0 / (9.0 * k));
+    return 0.5 * erfc(z / sqrt(2.0));
+}
+
+static size_t
+stat_evaluate(const stat_acc_t *a, stat_row_t *rows) {
+    double nbits = (double)a->bytes * 8.0;
+    double pi = (double)a->ones / nbits;
+    size_t r = 0;
+
+    /* Monobit (SP 800-22 2.1) */
+    double z = (2.0 * (double)a->ones - nbits) / sqrt(nbits);
+    rows[r++] = (stat_row_t){ "monobit", z, stat_p_normal(z) };
+
+    /* Runs (SP 800-22 2.3): flips against 2 n pi (1 - pi) */
+    double np = (double)a->bit_pairs, q = pi * (1.0 - pi);
+    z = ((double)a->flips - 2.0 * np * q) / (2.0 * sqrt(np) * q);
+    rows[r++] = (stat_row_t){ "runs", z, fabs(pi - 0.5) < 2.0 / sqrt(nbits) ? stat_p_normal(z) : 0.0 };
+
+    /* Byte frequencies, 255 degrees of freedom */
+    double expect = (double)a->bytes / 256.0, chi2 = 0.0;
+    for (int b = 0; b < 256; b++) {
+        double d = (double)a->hist[b] - expect;
+        chi2 += d * d / expect;
+    }
+    rows[r++] = (stat_row_t){ "byte-chi2", chi2, stat_p_chi2(chi2, 255.0) };
+
+    /* Lag-1 serial correlation of bytes; sqrt(n) r is about N(0, 1) */
+    double nb = (double)a->bytes, mean = (double)a->sx / nb;
+    double var = (double)a->sxx / nb - mean * mean;
+    double corr = ((double)a->sxy / (double)a->byte_pairs - mean * mean) / var;
+    z = corr * sqrt((double)a->byte_pairs);
+    rows[r++] = (stat_row_t){ "serial", z, stat_p_normal(z) };
+
+    /* Birthday spacings: duplicate count is Poisson with mean 2 per sample */
+    double lambda = (double)a->bday_samples * STAT_BDAY_M * STAT_BDAY_M * STAT_BDAY_M /
+                    (4.0 * (double)(1u << STAT_BDAY_BITS));
+    z = lambda > 0 ? ((double)a->bday_dups - lambda) / sqrt(lambda) : 0.0;
+    rows[r++] = (stat_row_t){ "birthday", z, a->bday_samples >= 16 ? stat_p_normal(z) : -1.0 };
+
+    return r;
+}
+
+/*
+ * Output
+ */
+
+static void
+emit_results(const stat_row_t *rows, size_t n, double alpha, const stat_acc_t *a,
+             unsigned int threads, double secs) {
+    double gbps = secs > 0 ? (double)a->bytes / secs / 1e9 : 0.0;
+    const char *backend = truernd_backend_name(truernd_get_backend());
+
+    if (format == FORMAT_CSV) {
+        printf("test,stat,p,pass\n");
+    } else if (format == FORMAT_JSON) {
+        printf("{\n  \"backend\": \"%s\",\n  \"caps\": %u,\n  \"bytes\": %llu,\n  \"threads\": %u,\n"
+               "  \"seconds\": %.6g,\n  \"gbps\": %.6g,\n  \"alpha\": %.6g,\n  \"results\": [",
+               backend, truernd_capabilities(), (unsigned long long)a->bytes, threads, secs, gbps, alpha);
+    } else {
+        printf("backend: %s, caps: 0x%x, %llu bytes, %u threads, %.3f s (%.3f GB/s)\n\n"
+               "%-12s %14s %12s  %s\n", backend, truernd_capabilities(), (unsigned long long)a->bytes,
+               threads, secs, gbps, "test", "stat", "p", "result");
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        const stat_row_t *r = &rows[i];
+        const char *verdict = r->p < 0 ? "skip" : r->p >= alpha ? "pass" : "FAIL";
+        if (format == FORMAT_CSV) {
+            printf("%s,%.6g,%.6g,%s\n", r->name, r->stat, r->p, verdict);
+        } else if (format == FORMAT_JSON) {
+            printf("%s\n    {\"test\": \"%s\", \"stat\": %.6g, \"p\": %.6g, \"result\": \"%s\"}",
+                   i ? "," : "", r->name, r->stat, r->p, verdict);
+        } else {
+            printf("%-12s %14.4f %12.6f  %s\n", r->name, r->stat, r->p, verdict);
+        }
+    }
+    if (format == FORMAT_JSON) printf("\n  ]\n}\n");
+}
+
+/*
+ * Driver
+ */
+
+static void
+usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--format text|csv|json] [--bytes N[K|M|G]] [--threads N]\n"
+            "          [--block N[K|M]] [--backend NAME] [--alpha P]\n", argv0);
+}
+
+static uint64_t
+parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; break;
+        case 'm': case 'M': v <<= 20; break;
+        case 'g': case 'G': v <<= 30; break;
+        default: break;
+    }
+    return (uint64_t)v;
+}
+
+static double
+stat_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+int
+main(int argc, char **argv) {
+    uint64_t total = STAT_DEFAULT_BYTES;
+    size_t block = STAT_DEFAULT_BLOCK;
+    unsigned int threads = truernd_cpu_count();
+    double alpha = STAT_DEFAULT_ALPHA;
+    truernd_backend_t backend = truernd_get_backend();
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--format") == 0 && val) {
+            if (strcmp(val, "csv") == 0) format = FORMAT_CSV;
+            else if (strcmp(val, "json") == 0) format = FORMAT_JSON;
+            else if (strcmp(val, "text") == 0) format = FORMAT_TEXT;
+            else { usage(argv[0]); return 2; }
+        } else if (strcmp(arg, "--bytes") == 0 && val) {
+            total = parse_size(val);
+        } else if (strcmp(arg, "--threads") == 0 && val) {
+            threads = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(arg, "--block") == 0 && val) {
+            block = (size_t)parse_size(val);
+        } else if (strcmp(arg, "--alpha") == 0 && val) {
+            alpha = strtod(val, NULL);
+        } else if (strcmp(arg, "--backend") == 0 && val) {
+            int b;
+            for (b = 0; b < TRUERND_BACKEND_COUNT; b++) {
+                if (strcmp(val, truernd_backend_name((truernd_backend_t)b)) == 0) break;
+            }
+            if (b == TRUERND_BACKEND_COUNT) { usage(argv[0]); return 2; }
+            backend = (truernd_backend_t)b;
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    block &= ~(size_t)63;
+    if (total < 64 * 1024 || block < 4096 || threads == 0 || threads > STAT_MAX_THREADS ||
+        !(alpha > 0 && alpha < 1)) {
+        usage(argv[0]);
+        return 2;
+    }
+    if (truernd_set_backend(backend) != 0) {
+        fprintf(stderr, "stattest: backend %s is not available here\n", truernd_backend_name(backend));
+        return 1;
+    }
+
+    static stat_worker_t workers[STAT_MAX_THREADS];
+    pthread_t tids[STAT_MAX_THREADS];
+    uint64_t next = 0;
+    double start = stat_now();
+    for (unsigned int t = 0; t < threads; t++) {
+        workers[t].next = &next;
+        workers[t].total = total;
+        workers[t].block = block;
+        if (pthread_create(&tids[t], NULL, stat_worker, &workers[t]) != 0) {
+            fprintf(stderr, "stattest: cannot start thread %u\n", t);
+            return 1;
+        }
+    }
+
+    stat_acc_t sum;
+    memset(&sum, 0, sizeof(sum));
+    for (unsigned int t = 0; t < threads; t++) {
+        pthread_join(tids[t], NULL);
+        const stat_acc_t *a = &workers[t].acc;
+        sum.bytes += a->bytes;
+        sum.ones += a->ones;
+        sum.flips += a->flips;
+        sum.bit_pairs += a->bit_pairs;
+        for (int b = 0; b < 256; b++) sum.hist[b] += a->hist[b];
+        sum.sx += a->sx;
+        sum.sxx += a->sxx;
+        sum.sxy += a->sxy;
+        sum.byte_pairs += a->byte_pairs;
+        sum.bday_samples += a->bday_samples;
+        sum.bday_dups += a->bday_dups;
+        sum.failed |= a->failed;
+    }
+    double secs = stat_now() - start;
+    if (sum.failed || sum.bytes == 0) {
+        fprintf(stderr, "stattest: the %s backend failed to generate data\n", truernd_backend_name(backend));
+        return 1;
+    }
+
+    stat_row_t rows[8];
+    size_t n = stat_evaluate(&sum, rows);
+    emit_results(rows, n, alpha, &sum, threads, secs);
+
+    int failed = 0;
+    for (size_t i = 0; i < n; i++) failed |= rows[i].p >= 0 && rows[i].p < alpha;
+    return failed;
+}
@@ -3,15 +3,26 @@
  * @brief Comprehensive test suite for truerandom.h library
  */
 
+/* Exercise the instrumented, health-tested, malloc-free and replay paths; bench.c covers the default build */
+#define TRUERND_STATS 1
+#define TRUERND_HEALTH 1
+#define TRUERND_STATIC_ARENA 4
+#define TRUERND_REPLAY 1
 #define TRUERANDOM_IMPLEMENTATION
 #include "truerandom.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <time.h>
 
-#define TEST_ITERATIONS 1000000
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/wait.h>
+#endif
+
 #define BUFFER_SIZE 256
+#define SMOKE_ITERATIONS 10000
+#define SMOKE_FILL_SIZE (1024 * 1024)
 
 #define ANSI_RESET    "\033[0m"
 #define ANSI_BOLD     "\033[1m"
@@ -77,6 +88,24 @@ static int test_support(void) {
         return 0;
     }
     
+    unsigned int caps = truernd_capabilities();
+    printf("Capabilities:%s%s%s%s%s%s%s%s%s%s\n",
+           caps & TRUERND_CAP_RDRAND ? " RDRAND" : "",
+           caps & TRUERND_CAP_RDSEED ? " RDSEED" : "",
+           caps & TRUERND_CAP_RNDR   ? " RNDR"   : "",
+           caps & TRUERND_CAP_RNDRRS ? " RNDRRS" : "",
+           caps & TRUERND_CAP_AES    ? " AES"    : "",
+           caps & TRUERND_CAP_NEON   ? " NEON"   : "",
+           caps & TRUERND_CAP_AVX2   ? " AVX2"   : "",
+           caps & TRUERND_CAP_AVX512 ? " AVX512" : "",
+           caps & TRUERND_CAP_SSSE3  ? " SSSE3"  : "",
+           caps & TRUERND_CAP_SHA2   ? " SHA2"   : "");
+
+    if (truernd_capabilities() != caps || truernd_is_supported() != supported) {
+        print_fail("Cached capabilities changed between calls");
+        return 0;
+    }
+
     print_pass("Hardware RNG is available");
     return 1;
 }
@@ -166,6 +195,27 @@ static int test_fill(void) {
     }
     printf("\n");
 
+    printf("Checking unaligned heads and tails stay within bounds...\n");
+    uint8_t guarded[64 + 16];
+    for (size_t offset = 0; offset < 8; offset++) {
+        for (size_t len = 1; len <= 64; len++) {
+            memset(guarded, 0xA5, sizeof(guarded));
+            if (truernd_fill(guarded + 8 + offset, len) != 0) {
+                print_fail("Failed to fill unaligned buffer");
+                return 0;
+            }
+            for (size_t i = 0; i < sizeof(guarded); i++) {
+                if ((i < 8 + offset || i >= 8 + offset + len) && guarded[i] != 0xA5) {
+                    char msg[100];
+                    snprintf(msg, sizeof(msg), "Fill wrote out of bounds (offset %zu, len %zu)",
+                             offset, len);
+                    print_fail(msg);
+                    return 0;
+                }
+            }
+        }
+    }
+
     int non_zero = 0;
     for (int i = 0; i < BUFFER_SIZE; i++) {
         if (buffer[i] != 0) non_zero++;
@@ -228,51 +278,51 @@ static int test_uniqueness(void) {
 }
 
 /**
- * @brief Test performance/throughput
+ * @brief Smoke test for every hot path; timings live in the bench target
  */
 static int test_performance(void) {
-    print_header("TEST 6: Performance Test");
+    print_header("TEST 6: Hot Path Smoke Test");
 
-    clock_t start, end;
-    double cpu_time;
-
-    printf("Generating %s%d%s random 32-bit numbers...\n", 
-           ANSI_CYAN, TEST_ITERATIONS, ANSI_RESET);
-    start = clock();
-    for (int i = 0; i < TEST_ITERATIONS; i++) {
-        uint32_t val;
-        if (truernd_get32(&val) != 0) {  /* 0 = success */
+    printf("Calling each generator %s%d%s times...\n", ANSI_CYAN, SMOKE_ITERATIONS, ANSI_RESET);
+    truernd_pool_t *pool = truernd_pool_local();
+    uint64_t sink = 0;
+    for (int i = 0; i < SMOKE_ITERATIONS; i++) {
+        uint32_t v32;
+        uint64_t v64;
+        if (truernd_get32(&v32) != 0 || truernd_get64(&v64) != 0 ||
+            truernd_pool_get64(pool, &v64) != 0) {
             char msg[100];
             snprintf(msg, sizeof(msg), "Generation failed at iteration %d", i);
             print_fail(msg);
             return 0;
         }
+        sink += v32 + v64 + truernd_uniform_u32(1000);
     }
-    end = clock();
-    cpu_time = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf(ANSI_DIM "  Time: " ANSI_RESET ANSI_GREEN "%.4f seconds\n" ANSI_RESET, cpu_time);
-    printf(ANSI_DIM "  Rate: " ANSI_RESET ANSI_GREEN "%.0f numbers/second\n" ANSI_RESET, 
-           TEST_ITERATIONS / cpu_time);
+    printf(ANSI_DIM "  (sum %llu)\n" ANSI_RESET, (unsigned long long)sink);
 
-    printf("\nGenerating %s%d%s random 64-bit numbers...\n", 
-           ANSI_CYAN, TEST_ITERATIONS, ANSI_RESET);
-    start = clock();
-    for (int i = 0; i < TEST_ITERATIONS; i++) {
-        uint64_t val;
-        if (truernd_get64(&val) != 0) {  /* 0 = success */
-            char msg[100];
-            snprintf(msg, sizeof(msg), "Generation failed at iteration %d", i);
-            print_fail(msg);
-            return 0;
-        }
+    printf("Filling a %s%d KB%s buffer through each backend and in parallel...\n",
+           ANSI_CYAN, SMOKE_FILL_SIZE / 1024, ANSI_RESET);
+    uint8_t *buf = malloc(SMOKE_FILL_SIZE);
+    if (!buf) {
+        print_fail("Could not allocate smoke test buffer");
+        return 0;
     }
-    end = clock();
-    cpu_time = ((double)(end - start)) / CLOCKS_PER_SEC;
-    printf(ANSI_DIM "  Time: " ANSI_RESET ANSI_GREEN "%.4f seconds\n" ANSI_RESET, cpu_time);
-    printf(ANSI_DIM "  Rate: " ANSI_RESET ANSI_GREEN "%.0f numbers/second\n" ANSI_RESET, 
-           TEST_ITERATIONS / cpu_time);
-    
-    print_pass("Performance test completed");
+    int all_passed = 1;
+    truernd_backend_t bound = truernd_get_backend();
+    for (int b = TRUERND_BACKEND_HW; b < TRUERND_BACKEND_COUNT; b++) {
+        if (truernd_set_backend((truernd_backend_t)b) != 0) continue;
+        if (truernd_fill(buf, SMOKE_FILL_SIZE) != 0) all_passed = 0;
+    }
+    truernd_set_backend(bound);
+    if (truernd_fill_parallel(buf, SMOKE_FILL_SIZE, 0) != 0) all_passed = 0;
+    free(buf);
+
+    if (!all_passed) {
+        print_fail("A fill path failed");
+        return 0;
+    }
+    printf(ANSI_DIM "  Run `make bench` for cycles per call, tail latency and throughput\n" ANSI_RESET);
+    print_pass("Hot paths completed");
     return 1;
 }
 
@@ -351,6 +401,1606 @@ static int test_gen_functions(void) {
     return 1;
 }
 
+/**
+ * @brief Test the buffered entropy pool
+ */
+static int test_pool(void) {
+    print_header("TEST 9: Buffered Pool");
+
+    truernd_pool_t pool;
+    if (truernd_pool_init(&pool) != 0) {
+        print_fail("Failed to initialize pool");
+        return 0;
+    }
+
+    int draws = 3 * TRUERND_POOL_WORDS + 5;
+    uint64_t prev = 0;
+    int repeats = 0;
+
+    printf("Drawing %d values across %d refills...\n", draws, draws / TRUERND_POOL_WORDS);
+    for (int i = 0; i < draws; i++) {
+        uint64_t val;
+        if (truernd_pool_get64(&pool, &val) != 0) {
+            char msg[100];
+            snprintf(msg, sizeof(msg), "Pool draw failed at index %d", i);
+            print_fail(msg);
+            return 0;
+        }
+        if (i > 0 && val == prev) repeats++;
+        prev = val;
+    }
+
+    uint32_t val32;
+    if (truernd_pool_get32(truernd_pool_local(), &val32) != 0) {
+        print_fail("Thread-local pool draw failed");
+        return 0;
+    }
+    printf(ANSI_DIM "  Thread-local pool:" ANSI_RESET " " ANSI_MAGENTA "0x%08X\n" ANSI_RESET, val32);
+
+    if (truernd_pool_get64(&pool, NULL) != -1 || truernd_pool_get64(NULL, &prev) != -1) {
+        print_fail("Pool accepted a NULL argument");
+        return 0;
+    }
+
+    if (repeats > 0) {
+        print_fail("Pool handed out the same value twice in a row");
+        return 0;
+    }
+
+    print_pass("Pool draws and refills successful");
+    return 1;
+}
+
+/**
+ * @brief Test the RDSEED/RNDRRS-seeded ChaCha20 DRBG
+ */
+static int test_drbg(void) {
+    print_header("TEST 10: Seeded DRBG");
+
+    /* RFC 7539 section 2.3.2 block function test vector */
+    static const uint8_t expected[64] = {
+        0x10, 0xf1, 0xe7, 0xe4, 0xd1, 0x3b, 0x59, 0x15, 0x50, 0x0f, 0xdd, 0x1f, 0xa3, 0x20, 0x71, 0xc4,
+        0xc7, 0xd1, 0xf4, 0xc7, 0x33, 0xc0, 0x68, 0x03, 0x04, 0x22, 0xaa, 0x9a, 0xc3, 0xd4, 0x6c, 0x4e,
+        0xd2, 0x82, 0x64, 0x46, 0x07, 0x9f, 0xaa, 0x09, 0x14, 0xc2, 0xd7, 0x05, 0xd9, 0x8b, 0x02, 0xa2,
+        0xb5, 0x12, 0x9c, 0xd1, 0xde, 0x16, 0x4e, 0xb9, 0xcb, 0xd0, 0x83, 0xe8, 0xa2, 0x50, 0x3c, 0x4e
+    };
+    uint32_t key[8];
+    for (int i = 0; i < 8; i++) {
+        key[i] = (uint32_t)(4 * i) | (uint32_t)(4 * i + 1) << 8 |
+                 (uint32_t)(4 * i + 2) << 16 | (uint32_t)(4 * i + 3) << 24;
+    }
+    uint8_t block[64];
+    truernd__chacha20_blocks(key, 1 | (0x09000000ull << 32), 0x4a000000, block, 1);
+    printf("ChaCha20 block function (RFC 7539 2.3.2): %s\n",
+           memcmp(block, expected, 64) == 0 ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+    if (memcmp(block, expected, 64) != 0) {
+        print_fail("ChaCha20 test vector mismatch");
+        return 0;
+    }
+
+    /* Multi-block path must match the one-block path, including counter carry */
+    uint8_t wide[8 * 64];
+    uint64_t counter = 0xFFFFFFFEull;
+    truernd__chacha20_blocks(key, counter, 7, wide, 8);
+    for (int i = 0; i < 8; i++) {
+        truernd__chacha20_blocks(key, counter + i, 7, block, 1);
+        if (memcmp(block, wide + 64 * i, 64) != 0) {
+            print_fail("Multi-block ChaCha20 output differs from single blocks");
+            return 0;
+        }
+    }
+    printf("Multi-block keystream matches single blocks: " ANSI_GREEN "PASS\n" ANSI_RESET);
+
+    printf("Hardware seed source supported: %s\n",
+           truernd_seed_is_supported() ? ANSI_GREEN "YES" ANSI_RESET : ANSI_YELLOW "NO" ANSI_RESET);
+    if (!truernd_seed_is_supported()) {
+        print_warning("Skipping seeded DRBG checks");
+        return 1;
+    }
+
+    truernd_drbg_t a, b;
+    if (truernd_drbg_init(&a, 0) != 0 || truernd_drbg_init(&b, 100) != 0) {
+        print_fail("Failed to seed DRBG");
+        return 0;
+    }
+
+    uint8_t out_a[1000], out_b[1000];
+    if (truernd_drbg_fill(&a, out_a, sizeof(out_a)) != 0 ||
+        truernd_drbg_fill(&b, out_b, sizeof(out_b)) != 0) {
+        print_fail("DRBG fill failed");
+        return 0;
+    }
+    if (memcmp(out_a, out_b, sizeof(out_a)) == 0) {
+        print_fail("Independently seeded DRBGs produced identical output");
+        return 0;
+    }
+
+    uint8_t again[1000];
+    if (truernd_drbg_fill(&a, again, sizeof(again)) != 0 || memcmp(out_a, again, sizeof(again)) == 0) {
+        print_fail("DRBG repeated its output after rekeying");
+        return 0;
+    }
+
+    if (truernd_drbg_fill(NULL, out_a, 16) != -1 || truernd_drbg_fill(&a, NULL, 16) != -1) {
+        print_fail("DRBG accepted a NULL argument");
+        return 0;
+    }
+
+    print_pass("DRBG seeding, reseeding and fill successful");
+    return 1;
+}
+
+/**
+ * @brief Test the retry policy and the OS fallback source
+ */
+static int test_retry_policy(void) {
+    print_header("TEST 11: Retry Policy");
+
+    truernd_retry_policy_t saved, policy, check;
+    truernd_get_retry_policy(&saved);
+    printf("Default policy: %d attempts, %d seed attempts, backoff %u..%u spins, OS fallback %s\n",
+           saved.max_retries, saved.seed_retries, saved.backoff_min, saved.backoff_max,
+           saved.os_fallback ? "on" : "off");
+
+    policy = saved;
+    policy.max_retries = 3;
+    policy.backoff_min = 1;
+    policy.backoff_max = 8;
+    policy.os_fallback = 1;
+    truernd_set_retry_policy(&policy);
+    truernd_get_retry_policy(&check);
+    if (memcmp(&policy, &check, sizeof(policy)) != 0) {
+        truernd_set_retry_policy(&saved);
+        print_fail("Retry policy did not round-trip");
+        return 0;
+    }
+
+    uint8_t buffer[64];
+    int fill_ok = truernd_fill(buffer, sizeof(buffer)) == 0;
+    truernd_set_retry_policy(NULL);
+    truernd_get_retry_policy(&check);
+    if (!fill_ok || memcmp(&saved, &check, sizeof(saved)) != 0) {
+        print_fail("Fill under a custom policy or policy reset failed");
+        return 0;
+    }
+
+    int supported = truernd_os_fill(buffer, sizeof(buffer)) == 0;
+    printf("OS random source available: %s\n",
+           supported ? ANSI_GREEN "YES" ANSI_RESET : ANSI_YELLOW "NO" ANSI_RESET);
+    if (truernd_os_fill(NULL, 16) != -1) {
+        print_fail("truernd_os_fill accepted a NULL buffer");
+        return 0;
+    }
+
+    print_pass("Retry policy set, used and reset successfully");
+    return 1;
+}
+
+/**
+ * @brief Test runtime backend dispatch
+ */
+static int test_backends(void) {
+    print_header("TEST 12: Backend Dispatch");
+
+    /* FIPS-197 appendix C.3 AES-256 vector, laid out as one counter block */
+    static const uint8_t expected[16] = {
+        0x8e, 0xa2, 0xb7, 0xca, 0x51, 0x67, 0x45, 0xbf, 0xea, 0xfc, 0x49, 0x90, 0x4b, 0x49, 0x60, 0x89
+    };
+    if (truernd_backend_available(TRUERND_BACKEND_DRBG_AES)) {
+        uint8_t key[32], rk[240], block[16];
+        for (int i = 0; i < 32; i++) key[i] = (uint8_t)i;
+        truernd__aes256_expand(key, rk);
+        truernd__aes256_ctr(rk, 0x7766554433221100ull, 0xffeeddccbbaa9988ull, block, 1);
+        printf("AES-256 block (FIPS-197 C.3): %s\n",
+               memcmp(block, expected, 16) == 0 ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+        if (memcmp(block, expected, 16) != 0) {
+            print_fail("AES-256 test vector mismatch");
+            return 0;
+        }
+    }
+
+    truernd_backend_t bound = truernd_get_backend();
+    printf("Bound backend: " ANSI_CYAN "%s\n" ANSI_RESET, truernd_backend_name(bound));
+    if (bound == TRUERND_BACKEND_AUTO || bound == TRUERND_BACKEND_FASTEST) {
+        print_fail("truernd_get_backend() returned an unresolved backend");
+        return 0;
+    }
+
+    int all_passed = 1;
+    for (int b = TRUERND_BACKEND_HW; b < TRUERND_BACKEND_COUNT; b++) {
+        if (!truernd_backend_available((truernd_backend_t)b)) {
+            printf("  %-14s " ANSI_DIM "not available\n" ANSI_RESET, truernd_backend_name((truernd_backend_t)b));
+            continue;
+        }
+
+        uint8_t a[100], c[100];
+        uint64_t val;
+        int ok = truernd_set_backend((truernd_backend_t)b) == 0 &&
+                 truernd_get_backend() == (truernd_backend_t)b &&
+                 truernd_fill(a, sizeof(a)) == 0 && truernd_fill(c, sizeof(c)) == 0 &&
+                 memcmp(a, c, sizeof(a)) != 0 &&
+                 truernd_pool_refill(truernd_pool_local()) == 0 &&
+                 truernd_pool_get64(truernd_pool_local(), &val) == 0;
+        printf("  %-14s %s\n", truernd_backend_name((truernd_backend_t)b),
+               ok ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+        if (!ok) all_passed = 0;
+    }
+
+    if (truernd_set_backend(TRUERND_BACKEND_COUNT) != -1) all_passed = 0;
+    truernd_set_backend(bound);
+
+    /* Drawing from a named backend must leave the binding alone */
+    uint8_t direct[64];
+    if (truernd_fill_backend(TRUERND_BACKEND_HW, direct, sizeof(direct)) != 0 ||
+        truernd_fill_backend(TRUERND_BACKEND_COUNT, direct, sizeof(direct)) != -1 ||
+        truernd_fill_backend(TRUERND_BACKEND_HW, NULL, sizeof(direct)) != -1 ||
+        truernd_get_backend() != bound) {
+        all_passed = 0;
+    }
+
+    if (all_passed) {
+        print_pass("All available backends fill correctly");
+        return 1;
+    } else {
+        print_fail("Backend dispatch not working correctly");
+        return 0;
+    }
+}
+
+/**
+ * @brief Executor that runs every task on the calling thread, in reverse order
+ */
+static void serial_run(void *ctx, void (*task)(void *arg, size_t index), void *arg, size_t ntasks) {
+    (void)ctx;
+    while (ntasks-- > 0) task(arg, ntasks);
+}
+
+/**
+ * @brief Test multi-threaded and executor-driven fills
+ */
+static int test_parallel(void) {
+    print_header("TEST 13: Parallel Fill");
+
+    size_t len = 4 * 1024 * 1024 + 3;
+    uint8_t *buf = calloc(1, len + 16);
+    if (!buf) {
+        print_fail("Could not allocate buffer");
+        return 0;
+    }
+
+    printf("Filling %zu bytes with 4 threads...\n", len);
+    int rc = truernd_fill_parallel(buf + 5, len, 4);
+
+    printf("Filling the same buffer through a 7-task caller executor...\n");
+    memset(buf, 0, len + 16);
+    truernd_executor_t exec = { NULL, 7, serial_run };
+    int rc_ex = truernd_fill_parallel_ex(buf + 5, len, &exec);
+
+    /* Every 64-byte run inside the range must have been written, nothing outside it */
+    int holes = 0;
+    for (size_t i = 5; i + 64 <= len + 5; i += 64) {
+        int zero = 1;
+        for (size_t j = 0; j < 64; j++) {
+            if (buf[i + j] != 0) { zero = 0; break; }
+        }
+        holes += zero;
+    }
+    int clean = 1;
+    for (size_t i = 0; i < 5; i++) if (buf[i] != 0) clean = 0;
+    for (size_t i = len + 5; i < len + 16; i++) if (buf[i] != 0) clean = 0;
+    free(buf);
+
+    int rc_null = truernd_fill_parallel(NULL, 100, 2);
+    if (rc != 0 || rc_ex != 0 || holes != 0 || !clean || rc_null != -1) {
+        char msg[100];
+        snprintf(msg, sizeof(msg), "rc=%d rc_ex=%d holes=%d clean=%d null=%d",
+                 rc, rc_ex, holes, clean, rc_null);
+        print_fail(msg);
+        return 0;
+    }
+
+    print_pass("Parallel fills cover the buffer exactly");
+    return 1;
+}
+
+/**
+ * @brief Test bounded integer and floating-point generators
+ */
+static int test_uniform(void) {
+    print_header("TEST 14: Bounded and Floating-Point Values");
+
+    int all_passed = 1;
+
+    printf("Checking bounds on 10000 draws each...\n");
+    static const uint64_t bounds[] = { 1, 2, 3, 6, 1000, 0x80000001u, 0xFFFFFFFFu };
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+        for (int i = 0; i < 10000; i++) {
+            if (truernd_uniform_u32((uint32_t)bounds[b]) >= bounds[b]) all_passed = 0;
+            uint64_t big = bounds[b] << 31 | 1;
+            if (truernd_uniform_u64(big) >= big) all_passed = 0;
+        }
+    }
+    if (truernd_uniform_u32(0) != 0 || truernd_uniform_u64(0) != 0) all_passed = 0;
+
+    double dmin = 1.0, dmax = 0.0;
+    float fmin = 1.0f, fmax = 0.0f;
+    for (int i = 0; i < 10000; i++) {
+        double d = truernd_double01();
+        float f = truernd_float01();
+        if (d < dmin) dmin = d;
+        if (d > dmax) dmax = d;
+        if (f < fmin) fmin = f;
+        if (f > fmax) fmax = f;
+    }
+    printf("  double01 range: [%.6f, %.6f]\n", dmin, dmax);
+    printf("  float01 range:  [%.6f, %.6f]\n", fmin, fmax);
+    if (dmin < 0.0 || dmax >= 1.0 || fmin < 0.0f || fmax >= 1.0f) all_passed = 0;
+
+    /* Six-sided die: each face should land within 5% of 10000 out of 60000 */
+    int faces[6] = { 0 };
+    for (int i = 0; i < 60000; i++) faces[truernd_uniform_u32(6)]++;
+    printf("  uniform_u32(6) counts:");
+    for (int i = 0; i < 6; i++) {
+        printf(" %d", faces[i]);
+        if (faces[i] < 9500 || faces[i] > 10500) all_passed = 0;
+    }
+    printf("\n");
+
+    if (all_passed) {
+        print_pass("Bounded and floating-point values in range and balanced");
+        return 1;
+    } else {
+        print_fail("Bounded or floating-point generator out of range or skewed");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 15: Batch fills into typed arrays
+ */
+static int test_typed_fill(void) {
+    print_header("TEST 15: Typed Array Fills");
+
+    int all_passed = 1;
+    enum { N = 100003 };  /* Odd length exercises every vector tail */
+    uint32_t *u = malloc(N * sizeof(*u));
+    double *d = malloc(N * sizeof(*d));
+    float *f = malloc(N * sizeof(*f));
+    if (!u || !d || !f) {
+        free(u); free(d); free(f);
+        print_fail("Memory allocation failed");
+        return 0;
+    }
+
+    printf("Checking bounded fills against several bounds...\n");
+    static const uint32_t bounds[] = { 1, 3, 6, 1000, 0x80000001u, 0xFFFFFFFFu };
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+        if (truernd_fill_u32_bounded(u, N, bounds[b]) != 0) all_passed = 0;
+        for (int i = 0; i < N; i++) {
+            if (u[i] >= bounds[b]) all_passed = 0;
+        }
+    }
+
+    /* Six-sided die again, through the batch path */
+    int faces[6] = { 0 };
+    if (truernd_fill_u32_bounded(u, 60000, 6) != 0) all_passed = 0;
+    for (int i = 0; i < 60000; i++) faces[u[i]]++;
+    printf("  fill_u32_bounded(6) counts:");
+    for (int i = 0; i < 6; i++) {
+        printf(" %d", faces[i]);
+        if (faces[i] < 9500 || faces[i] > 10500) all_passed = 0;
+    }
+    printf("\n");
+
+    /* 0x80000001 rejects almost half the raw words, so the redraw pass runs */
+    int high = 0;
+    if (truernd_fill_u32_bounded(u, N, 0x80000001u) != 0) all_passed = 0;
+    for (int i = 0; i < N; i++) high += u[i] == 0x80000000u;
+    if (high > 8) all_passed = 0;
+
+    double dsum = 0.0;
+    if (truernd_fill_double(d, N) != 0) all_passed = 0;
+    for (int i = 0; i < N; i++) {
+        if (!(d[i] >= 0.0 && d[i] < 1.0)) all_passed = 0;
+        dsum += d[i];
+    }
+    float fsum = 0.0f;
+    if (truernd_fill_float(f, N) != 0) all_passed = 0;
+    for (int i = 0; i < N; i++) {
+        if (!(f[i] >= 0.0f && f[i] < 1.0f)) all_passed = 0;
+        fsum += f[i];
+    }
+    printf("  double mean: %.4f, float mean: %.4f\n", dsum / N, fsum / N);
+    if (dsum / N < 0.49 || dsum / N > 0.51) all_passed = 0;
+    if (fsum / N < 0.49f || fsum / N > 0.51f) all_passed = 0;
+
+    if (truernd_fill_u32_bounded(u, N, 0) != -1 ||
+        truernd_fill_u32_bounded(NULL, N, 6) != -1 ||
+        truernd_fill_double(d, 0) != -1 ||
+        truernd_fill_float(NULL, N) != -1) {
+        all_passed = 0;
+    }
+
+    free(u); free(d); free(f);
+
+    if (all_passed) {
+        print_pass("Typed array fills in range and balanced");
+        return 1;
+    } else {
+        print_fail("Typed array fill out of range, skewed or accepted bad arguments");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 16: Instrumentation counters
+ */
+static int test_stats(void) {
+    print_header("TEST 16: Instrumentation Counters");
+
+    int all_passed = 1;
+    truernd_stats_t before, after;
+    uint8_t buf[4096];
+
+    truernd_backend_t bound = truernd_get_backend();
+    if (truernd_stats_snapshot(&before) != 0 ||
+        truernd_set_backend(TRUERND_BACKEND_HW) != 0 ||
+        truernd_fill(buf, sizeof(buf)) != 0 ||
+        truernd_stats_snapshot(&after) != 0) {
+        all_passed = 0;
+    }
+    truernd_set_backend(bound);
+
+    printf("Hardware fill of %zu bytes:\n", sizeof(buf));
+    printf("  draws %llu, underflows %llu, retries %llu, bytes %llu, cycles %llu\n",
+           (unsigned long long)(after.draws - before.draws),
+           (unsigned long long)(after.underflows - before.underflows),
+           (unsigned long long)(after.retries - before.retries),
+           (unsigned long long)(after.bytes - before.bytes),
+           (unsigned long long)(after.cycles - before.cycles));
+    if (after.bytes - before.bytes != sizeof(buf)) all_passed = 0;
+    if (after.draws - before.draws < sizeof(buf) / 8) all_passed = 0;
+    if (after.cycles <= before.cycles) all_passed = 0;
+    if (after.underflows < before.underflows || after.retries < before.retries) all_passed = 0;
+
+    /* Worker threads claim slots of their own and still show up in the totals */
+    size_t len = 4 * TRUERND_PARALLEL_MIN_CHUNK;
+    uint8_t *big = malloc(len);
+    if (!big || truernd_fill_parallel(big, len, 4) != 0 ||
+        truernd_stats_snapshot(&before) != 0) {
+        all_passed = 0;
+    } else {
+        printf("  after a 4-thread fill: %llu threads, %llu bytes total, max retry streak %llu\n",
+               (unsigned long long)before.threads, (unsigned long long)before.bytes,
+               (unsigned long long)before.max_retry_streak);
+        if (before.bytes < after.bytes + len || before.threads < 2) all_passed = 0;
+    }
+    free(big);
+
+    if (truernd_stats_snapshot(NULL) != -1) all_passed = 0;
+
+    if (all_passed) {
+        print_pass("Counters track draws, bytes and cycles across threads");
+        return 1;
+    } else {
+        print_fail("Counters missing or inconsistent");
+        return 0;
+    }
+}
+
+static void count_low(truernd_ring_t *ring, void *arg) {
+    (void)ring;
+    (*(int*)arg)++;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#define RING_CONSUMER_DRAWS 20000
+
+static void *ring_consumer(void *arg) {
+    truernd_ring_t *ring = (truernd_ring_t*)arg;
+    uint8_t chunk[32], prev[32] = { 0 };
+    for (int i = 0; i < RING_CONSUMER_DRAWS; i++) {
+        if (truernd_ring_get(ring, chunk, sizeof(chunk)) != 0) return (void*)1;
+        if (memcmp(chunk, prev, sizeof(chunk)) == 0) return (void*)1;
+        memcpy(prev, chunk, sizeof(chunk));
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Test 17: Shared entropy ring
+ */
+static int test_ring(void) {
+    print_header("TEST 17: Shared Entropy Ring");
+
+    static truernd_ring_slot_t slots[64];
+    truernd_ring_t ring;
+    int all_passed = 1;
+
+    if (truernd_ring_init(&ring, slots, 48, 32) != -1) all_passed = 0;
+    if (truernd_ring_init(&ring, slots, 64, 24) != -1) all_passed = 0;
+
+    /* A ring of 8-byte chunks hands out 8 fresh bytes per slot and nothing else */
+    truernd_ring_t small;
+    uint64_t w[4];
+    if (truernd_ring_init(&small, slots, 4, 8) != 0 || truernd_ring_produce(&small, SIZE_MAX) != 4) {
+        all_passed = 0;
+    }
+    for (int i = 0; i < 4; i++) {
+        if (truernd_ring_get(&small, &w[i], 8) != 0) all_passed = 0;
+    }
+    if (w[0] == w[1] || w[1] == w[2] || w[2] == w[3]) all_passed = 0;
+    if (truernd_ring_get(&small, w, 32) != -1) all_passed = 0;
+
+    if (truernd_ring_init(&ring, slots, 64, 32) != 0) {
+        print_fail("Ring initialization failed");
+        return 0;
+    }
+
+    size_t produced = truernd_ring_produce(&ring, SIZE_MAX);
+    printf("Produced %zu slots, level %zu\n", produced, truernd_ring_level(&ring));
+    if (produced != 64 || truernd_ring_level(&ring) != 64) all_passed = 0;
+    if (truernd_ring_produce(&ring, SIZE_MAX) != 0) all_passed = 0;
+
+    uint8_t a[32], b[32];
+    if (truernd_ring_get(&ring, a, 32) != 0 || truernd_ring_get(&ring, b, 32) != 0 ||
+        truernd_ring_get(&ring, a, 32) != 0 || truernd_ring_get(&ring, b, 32) != 0) {
+        all_passed = 0;
+    }
+    if (memcmp(a, b, 32) == 0) all_passed = 0;
+    if (truernd_ring_get(&ring, a, 8) != -1 || truernd_ring_get(NULL, a, 32) != -1) all_passed = 0;
+    if (truernd_ring_level(&ring) != 60) all_passed = 0;
+
+    /* Drain past empty: the watermark fires once and empty draws come from truernd_fill */
+    int lows = 0;
+    truernd_ring_set_low_watermark(&ring, 8, count_low, &lows);
+    for (int i = 0; i < 70; i++) {
+        if (truernd_ring_get(&ring, a, 32) != 0) all_passed = 0;
+    }
+    printf("  low watermark fired %d time(s) while draining past empty\n", lows);
+    if (lows != 1 || truernd_ring_level(&ring) != 0) all_passed = 0;
+
+    /* Positions consumers gave up on are stepped over, and the ring fills again */
+    produced = truernd_ring_produce(&ring, SIZE_MAX);
+    printf("  refilled %zu slots after consumers overran the producer\n", produced);
+    if (produced != 64 || truernd_ring_level(&ring) != 64) all_passed = 0;
+    for (int i = 0; i < 60; i++) {
+        if (truernd_ring_get(&ring, a, 32) != 0) all_passed = 0;
+    }
+    if (lows != 2) all_passed = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+    enum { CONSUMERS = 4 };
+    pthread_t consumers[CONSUMERS];
+    int started = 0;
+    if (truernd_ring_start(&ring) != 0) {
+        all_passed = 0;
+    } else {
+        for (; started < CONSUMERS; started++) {
+            if (pthread_create(&consumers[started], NULL, ring_consumer, &ring) != 0) break;
+        }
+        for (int i = 0; i < started; i++) {
+            void *rc;
+            pthread_join(consumers[i], &rc);
+            if (rc != NULL) all_passed = 0;
+        }
+        truernd_ring_stop(&ring);
+        printf("  %d consumers drew %d chunks each against a background producer\n",
+               started, RING_CONSUMER_DRAWS);
+        if (started != CONSUMERS) all_passed = 0;
+    }
+#endif
+
+    if (all_passed) {
+        print_pass("Ring produces, hands out and refills chunks correctly");
+        return 1;
+    } else {
+        print_fail("Ring lost, repeated or miscounted chunks");
+        return 0;
+    }
+}
+
+static int cmp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*)a, y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+/* Exits with an async fill possibly in flight; the exit hook has to wait it out */
+static void *async_pool_thread(void *arg) {
+    (void)arg;
+    uint64_t val;
+    if (truernd_pool_set_mode(truernd_pool_local(), TRUERND_POOL_ASYNC) != 0) return (void*)1;
+    for (int i = 0; i < 5 * TRUERND_POOL_WORDS - 3; i++) {
+        if (truernd_pool_get64(truernd_pool_local(), &val) != 0) return (void*)1;
+    }
+    return NULL;
+}
+#endif
+
+/**
+ * @brief Test 18: Double-buffered pool refill modes
+ */
+static int test_pool_modes(void) {
+    print_header("TEST 18: Double-Buffered Pool");
+
+    enum { DRAWS = 20 * TRUERND_POOL_WORDS + 7 };
+    static truernd_pool_t pool;
+    static uint64_t seen[DRAWS];
+    static const struct { int mode; const char *name; } modes[] = {
+        { TRUERND_POOL_SLICED, "sliced" },
+        { TRUERND_POOL_ASYNC,  "async"  },
+        { TRUERND_POOL_SYNC,   "sync"   },
+    };
+    int all_passed = 1;
+
+    truernd_pool_init(&pool);
+    if (truernd_pool_set_mode(&pool, 7) != -1 || truernd_pool_set_mode(NULL, TRUERND_POOL_SYNC) != -1) {
+        all_passed = 0;
+    }
+
+    for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+        if (truernd_pool_set_mode(&pool, modes[m].mode) != 0) {
+            printf("  %-7s " ANSI_YELLOW "unavailable\n" ANSI_RESET, modes[m].name);
+            continue;
+        }
+
+        /* Every value across many buffer swaps should be distinct */
+        int ok = 1;
+        for (int i = 0; i < DRAWS; i++) {
+            if (truernd_pool_get64(&pool, &seen[i]) != 0) ok = 0;
+        }
+        qsort(seen, DRAWS, sizeof(seen[0]), cmp_u64);
+        for (int i = 1; i < DRAWS; i++) {
+            if (seen[i] == seen[i - 1]) ok = 0;
+        }
+        printf("  %-7s %s\n", modes[m].name, ok ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+        if (!ok) all_passed = 0;
+    }
+
+    /* The thread-local pool can prefetch too, and goes back to sync cleanly */
+    uint64_t val;
+    if (truernd_pool_set_mode(truernd_pool_local(), TRUERND_POOL_SLICED) != 0) all_passed = 0;
+    for (int i = 0; i < 3 * TRUERND_POOL_WORDS; i++) {
+        if (truernd_pool_get64(truernd_pool_local(), &val) != 0) all_passed = 0;
+    }
+    if (truernd_pool_set_mode(truernd_pool_local(), TRUERND_POOL_SYNC) != 0) all_passed = 0;
+
+#if defined(__unix__) || defined(__APPLE__)
+    for (int i = 0; i < 8; i++) {
+        pthread_t thread;
+        void *rc = (void*)1;
+        if (pthread_create(&thread, NULL, async_pool_thread, NULL) != 0) break;
+        pthread_join(thread, &rc);
+        if (rc != NULL) all_passed = 0;
+    }
+#endif
+
+    if (all_passed) {
+        print_pass("Pool swaps prefetched buffers without repeating values");
+        return 1;
+    } else {
+        print_fail("Prefetching pool repeated values or failed a draw");
+        return 0;
+    }
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Bytes in [from, to) of fd that are non-zero, or -1 on a read error */
+static long count_nonzero(int fd, long from, long to) {
+    uint8_t chunk[4096];
+    long nonzero = 0;
+    if (lseek(fd, from, SEEK_SET) != from) return -1;
+    while (from < to) {
+        size_t want = (size_t)(to - from) < sizeof(chunk) ? (size_t)(to - from) : sizeof(chunk);
+        ssize_t got = read(fd, chunk, want);
+        if (got <= 0) return -1;
+        for (ssize_t i = 0; i < got; i++) nonzero += chunk[i] != 0;
+        from += got;
+    }
+    return nonzero;
+}
+#endif
+
+/**
+ * @brief Test 19: Filling mapped files and streaming to descriptors
+ */
+static int test_file_fill(void) {
+    print_header("TEST 19: File and Stream Fills");
+
+#if defined(__unix__) || defined(__APPLE__)
+    int all_passed = 1;
+    FILE *f = tmpfile();
+    FILE *g = tmpfile();
+    if (!f || !g) {
+        if (f) fclose(f);
+        if (g) fclose(g);
+        print_warning("Could not create temporary files, skipping");
+        return 1;
+    }
+    int fd = fileno(f);
+
+    /* A zeroed prefix that must survive, then an unaligned range the file grows into */
+    static const uint8_t zeros[4096];
+    const long offset = 4096 + 123, len = 3 * 1024 * 1024 + 77;
+    if (write(fd, zeros, sizeof(zeros)) != (ssize_t)sizeof(zeros)) all_passed = 0;
+    if (truernd_fill_file(fd, (uint64_t)offset, (uint64_t)len, TRUERND_MAP_HUGEPAGE) != 0) all_passed = 0;
+
+    struct stat st;
+    long prefix = count_nonzero(fd, 0, offset);
+    long filled = count_nonzero(fd, offset, offset + len);
+    printf("Mapped fill: size %lld, prefix non-zero bytes %ld, filled non-zero %.2f%%\n",
+           fstat(fd, &st) == 0 ? (long long)st.st_size : -1LL, prefix, 100.0 * filled / len);
+    if (fstat(fd, &st) != 0 || st.st_size != offset + len) all_passed = 0;
+    if (prefix != 0 || filled < len * 99 / 100) all_passed = 0;
+
+    /* The streaming path writes at the current position of any descriptor */
+    int gd = fileno(g);
+    const long stream_len = 5 * 1024 * 1024 + 3;
+    if (truernd_fill_stream(gd, (uint64_t)stream_len, TRUERND_MAP_HUGETLB) != 0) all_passed = 0;
+    filled = count_nonzero(gd, 0, stream_len);
+    printf("Streamed fill: size %lld, non-zero %.2f%%\n",
+           fstat(gd, &st) == 0 ? (long long)st.st_size : -1LL, 100.0 * filled / stream_len);
+    if (fstat(gd, &st) != 0 || st.st_size != stream_len || filled < stream_len * 99 / 100) all_passed = 0;
+
+    /* A non-blocking pipe fills up many times over; the stream waits instead of failing */
+    int p[2];
+    if (pipe(p) == 0) {
+        const long pipe_len = 1024 * 1024 + 5;
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(p[1]);
+            uint8_t sink[4096];
+            long got = 0;
+            ssize_t r;
+            while ((r = read(p[0], sink, sizeof(sink))) > 0 || (r < 0 && errno == EINTR)) {
+                if (r > 0) got += r;
+            }
+            _exit(got == pipe_len ? 0 : 1);
+        }
+        close(p[0]);
+        fcntl(p[1], F_SETFL, fcntl(p[1], F_GETFL) | O_NONBLOCK);
+        if (pid < 0 || truernd_fill_stream(p[1], (uint64_t)pipe_len, 0) != 0) all_passed = 0;
+        close(p[1]);
+        int status = -1;
+        if (pid > 0 && (waitpid(pid, &status, 0) != pid || status != 0)) all_passed = 0;
+        printf("Non-blocking pipe: %ld bytes streamed, reader %s\n", pipe_len, status == 0 ? "got them all" : "came up short");
+    } else {
+        all_passed = 0;
+    }
+
+    if (truernd_fill_file(-1, 0, 10, 0) != -1 || truernd_fill_file(fd, 0, 0, 0) != -1 ||
+        truernd_fill_stream(gd, 0, 0) != -1) {
+        all_passed = 0;
+    }
+    fclose(f);
+    fclose(g);
+
+    if (all_passed) {
+        print_pass("File ranges and streams filled in place");
+        return 1;
+    } else {
+        print_fail("File or stream fill wrote the wrong range");
+        return 0;
+    }
+#else
+    print_warning("No mmap() on this platform, skipping");
+    return 1;
+#endif
+}
+
+/**
+ * @brief Test 20: Non-temporal store path
+ */
+static int test_nt_fill(void) {
+    print_header("TEST 20: Non-Temporal Fills");
+
+    int all_passed = 1;
+    size_t cap = TRUERND_NT_THRESHOLD + 4096;
+    uint8_t *buf = malloc(cap + 64);
+    if (!buf) {
+        print_fail("Memory allocation failed");
+        return 0;
+    }
+
+    /* Odd offsets and lengths exercise the cached head and tail around the streamed body */
+    static const size_t lens[] = { 1, 15, 16, 17, 100, 4095, 4096, 4097, 3 * 4096 + 9 };
+    printf("Streaming fills at offsets 0-15 over %zu lengths...\n", sizeof(lens) / sizeof(lens[0]));
+    for (size_t off = 0; off < 16; off++) {
+        for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+            size_t len = lens[l];
+            memset(buf, 0xA5, len + off + 32);
+            if (truernd_fill_ex(buf + off, len, TRUERND_FILL_NT) != 0) all_passed = 0;
+            for (size_t i = 0; i < off; i++) if (buf[i] != 0xA5) all_passed = 0;
+            for (size_t i = off + len; i < off + len + 32; i++) if (buf[i] != 0xA5) all_passed = 0;
+            size_t changed = 0;
+            for (size_t i = off; i < off + len; i++) changed += buf[i] != 0xA5;
+            if (len >= 16 && changed < len * 9 / 10) all_passed = 0;
+        }
+    }
+
+    /* At the threshold truernd_fill switches to the streaming path on its own */
+    memset(buf, 0, cap);
+    if (truernd_fill(buf + 3, TRUERND_NT_THRESHOLD) != 0) all_passed = 0;
+    size_t nonzero = 0;
+    for (size_t i = 3; i < 3 + TRUERND_NT_THRESHOLD; i++) nonzero += buf[i] != 0;
+    printf("  %u-byte truernd_fill: %.2f%% non-zero\n", (unsigned)TRUERND_NT_THRESHOLD,
+           100.0 * nonzero / TRUERND_NT_THRESHOLD);
+    if (nonzero < TRUERND_NT_THRESHOLD / 100 * 99) all_passed = 0;
+
+    if (truernd_fill_ex(buf, 64, TRUERND_FILL_CACHED) != 0 ||
+        truernd_fill_ex(buf, 64, TRUERND_FILL_CACHED | TRUERND_FILL_NT) != -1 ||
+        truernd_fill_ex(NULL, 64, TRUERND_FILL_NT) != -1) {
+        all_passed = 0;
+    }
+    free(buf);
+
+    if (all_passed) {
+        print_pass("Streaming stores fill exactly the requested bytes");
+        return 1;
+    } else {
+        print_fail("Streaming fill wrote outside the buffer or left it unfilled");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 21: Compile-time sized fills
+ */
+static int test_fixed_fill(void) {
+    print_header("TEST 21: Fixed-Size Fills");
+
+    int all_passed = 1;
+    uint8_t buf[16 + 520 + 16];
+    truernd_pool_t *pool = truernd_pool_local();
+
+/* Guard bytes on both sides catch a tail word copied in full */
+#define CHECK_FIXED(n) do { \
+        memset(buf, 0xA5, sizeof(buf)); \
+        if (TRUERND_FILL_FIXED(buf + 16, n) != 0) all_passed = 0; \
+        for (size_t g = 0; g < 16; g++) { \
+            if (buf[g] != 0xA5 || buf[16 + (n) + g] != 0xA5) all_passed = 0; \
+        } \
+        size_t changed = 0; \
+        for (size_t g = 0; g < (n); g++) changed += buf[16 + g] != 0xA5; \
+        if ((n) >= 16 && changed * 10 < (size_t)(n) * 9) all_passed = 0; \
+    } while (0)
+
+    /* Once from a drained pool (word-by-word path), once from a full one */
+    for (int pass = 0; pass < 2; pass++) {
+        if (pass == 0) {
+            truernd_pool_init(pool);
+        } else if (truernd_pool_refill(pool) != 0) {
+            all_passed = 0;
+        }
+        CHECK_FIXED(1);
+        CHECK_FIXED(7);
+        CHECK_FIXED(8);
+        CHECK_FIXED(15);
+        CHECK_FIXED(16);
+        CHECK_FIXED(32);
+        CHECK_FIXED(TRUERND_POOL_WORDS * 8 + 7);
+    }
+#undef CHECK_FIXED
+
+    /* The block path must hand out and wipe exactly ceil(n / 8) words */
+    if (truernd_pool_refill(pool) != 0) all_passed = 0;
+    size_t before = pool->avail;
+    uint8_t key[20];
+    if (TRUERND_FILL_FIXED(key, sizeof(key)) != 0) all_passed = 0;
+    if (pool->avail != before - 3) all_passed = 0;
+    for (size_t i = pool->avail; i < before; i++) if (pool->active[i] != 0) all_passed = 0;
+    printf("  20-byte fill took %zu pool words\n", before - pool->avail);
+
+    if (truernd_fill_fixed(NULL, 16) != -1 || truernd_fill_fixed(key, 0) != 0) all_passed = 0;
+
+    if (all_passed) {
+        print_pass("Fixed-size fills write exactly n bytes");
+        return 1;
+    } else {
+        print_fail("Fixed-size fill wrote the wrong bytes");
+        return 0;
+    }
+}
+
+/**
+ * @brief Reference base64url encoder, one bit at a time
+ */
+static void ref_b64url(char *dst, const uint8_t *src, size_t n) {
+    static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+    size_t bits = n * 8, out = 0;
+    for (size_t b = 0; b < bits; b += 6) {
+        unsigned v = 0;
+        for (size_t k = b; k < b + 6; k++) {
+            v = v << 1 | (k < bits ? (src[k / 8] >> (7 - k % 8)) & 1u : 0u);
+        }
+        dst[out++] = digits[v];
+    }
+    dst[out] = '\0';
+}
+
+/**
+ * @brief Test 22: UUIDs and tokens
+ */
+static int test_identifiers(void) {
+    print_header("TEST 22: UUIDs and Tokens");
+
+    int all_passed = 1;
+
+    /* Encoders against the bit-by-bit reference, over every tail length */
+    uint8_t src[52] = {0};
+    char enc[80], ref[80];
+    for (size_t i = 0; i < 48; i++) src[i] = (uint8_t)(i * 37 + 0xfb);
+    for (size_t n = 1; n <= 48; n++) {
+        *truernd__b64url_encode(enc, src, n) = '\0';
+        ref_b64url(ref, src, n);
+        if (strcmp(enc, ref) != 0 || strlen(enc) + 1 != TRUERND_B64URL_LEN(n)) all_passed = 0;
+    }
+    char hex[33] = {0};
+    truernd__hex16(hex, src);
+    for (int i = 0; i < 16; i++) {
+        char pair[3];
+        snprintf(pair, sizeof(pair), "%02x", src[i]);
+        if (hex[2 * i] != pair[0] || hex[2 * i + 1] != pair[1]) all_passed = 0;
+    }
+
+    char id[TRUERND_UUID_STR_LEN], prev[TRUERND_UUID_STR_LEN] = "";
+    for (int r = 0; r < 1000; r++) {
+        if (truernd_uuid4_str(id) != 0 || strlen(id) != 36 || strcmp(id, prev) == 0) all_passed = 0;
+        for (int i = 0; i < 36; i++) {
+            int dash = i == 8 || i == 13 || i == 18 || i == 23;
+            int digit = (id[i] >= '0' && id[i] <= '9') || (id[i] >= 'a' && id[i] <= 'f');
+            if (dash ? id[i] != '-' : !digit) all_passed = 0;
+        }
+        if (id[14] != '4' || !strchr("89ab", id[19])) all_passed = 0;
+        memcpy(prev, id, sizeof(id));
+    }
+    printf("  uuid4_str: %s\n", id);
+
+    uint8_t bin[16];
+    if (truernd_uuid4(bin) != 0 || (bin[6] >> 4) != 4 || (bin[8] >> 6) != 2) all_passed = 0;
+
+    char token[TRUERND_B64URL_LEN(100)];
+    static const size_t sizes[] = { 1, 2, 3, 16, 32, 47, 48, 49, 100 };
+    for (size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); k++) {
+        memset(token, '#', sizeof(token));
+        if (truernd_token_b64url(token, sizes[k]) != 0 ||
+            strlen(token) + 1 != TRUERND_B64URL_LEN(sizes[k]) ||
+            strspn(token, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_") !=
+                strlen(token)) {
+            all_passed = 0;
+        }
+    }
+    if (truernd_token_b64url(token, 32) == 0) printf("  token_b64url(32): %s\n", token);
+    if (truernd_token_b64url(NULL, 16) != -1 || truernd_token_b64url(token, 0) != -1 ||
+        truernd_uuid4_str(NULL) != -1) {
+        all_passed = 0;
+    }
+
+    if (all_passed) {
+        print_pass("UUIDs and tokens are well formed");
+        return 1;
+    } else {
+        print_fail("UUID or token encoding is wrong");
+        return 0;
+    }
+}
+
+/**
+ * @brief Health callback that records the last failing test
+ */
+static void health_hook(int test, void *arg) {
+    *(int*)arg = test;
+}
+
+/**
+ * @brief Test 23: Online health tests
+ */
+static int test_health(void) {
+    print_header("TEST 23: Online Health Tests");
+
+    int all_passed = 1;
+    int last_test = 0;
+    if (truernd_set_health_callback(health_hook, &last_test) != 0) {
+        print_fail("Health tests not compiled in");
+        return 0;
+    }
+
+    /* Every hardware fill above ran through the tests; none may have tripped */
+    uint64_t before = truernd_health_failures();
+    printf("Failures so far: %llu\n", (unsigned long long)before);
+    if (before != 0) all_passed = 0;
+
+    uint64_t words[64];
+    if (truernd_fill_backend(TRUERND_BACKEND_HW, words, sizeof(words)) != 0) all_passed = 0;
+
+    /* A word repeated straight after itself trips the repetition count test */
+    words[40] = words[39];
+    last_test = 0;
+    int rc = truernd__health_block((uint8_t*)words, sizeof(words), words, 64);
+    printf("  repeated word: rc=%d test=%d\n", rc, last_test);
+    if (rc != TRUERND_ERR_HEALTH || last_test != TRUERND_HEALTH_RCT || words[39] != 0) all_passed = 0;
+
+    /* One byte value in a twentieth of a window trips the adaptive proportion test */
+    uint8_t block[TRUERND__APT_WINDOW];
+    if (truernd_fill_backend(TRUERND_BACKEND_HW, block, sizeof(block)) != 0) all_passed = 0;
+    for (size_t i = 0; i < sizeof(block); i += 24) block[i] = 0x5A;
+    truernd__health.apt_seen = 0;
+    last_test = 0;
+    rc = truernd__health_block(block, sizeof(block), NULL, 0);
+    printf("  biased bytes:  rc=%d test=%d\n", rc, last_test);
+    if (rc != TRUERND_ERR_HEALTH || last_test != TRUERND_HEALTH_APT) all_passed = 0;
+
+    /* The same bias split over small odd-sized blocks must still be caught */
+    if (truernd_fill_backend(TRUERND_BACKEND_HW, block, sizeof(block)) != 0) all_passed = 0;
+    for (size_t i = 0; i < sizeof(block); i += 24) block[i] = 0x5A;
+    last_test = 0;
+    rc = 0;
+    for (size_t off = 0; off < sizeof(block) && rc == 0; off += 37) {
+        size_t n = sizeof(block) - off < 37 ? sizeof(block) - off : 37;
+        rc = truernd__health_block(block + off, n, NULL, 0);
+    }
+    if (rc != TRUERND_ERR_HEALTH || last_test != TRUERND_HEALTH_APT) all_passed = 0;
+
+    /* Healthy output passes again afterwards, and the count saw all three */
+    uint8_t buf[4096];
+    for (int r = 0; r < 64; r++) {
+        if (truernd_fill_backend(TRUERND_BACKEND_HW, buf, sizeof(buf)) != 0) all_passed = 0;
+    }
+    if (truernd_health_failures() != before + 3) all_passed = 0;
+    truernd_set_health_callback(NULL, NULL);
+
+    if (all_passed) {
+        print_pass("Health tests pass real output and catch degraded blocks");
+        return 1;
+    } else {
+        print_fail("Health tests missed a failure or raised a false alarm");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 24: Source mixing pipeline
+ */
+static int test_mixing(void) {
+    print_header("TEST 24: Source Mixing");
+
+    int all_passed = 1;
+    static const struct { const char *msg; uint8_t digest[32]; } vectors[] = {
+        { "", { 0xe3, 0xb0, 0xc4, 0x42, 0x98, 0xfc, 0x1c, 0x14, 0x9a, 0xfb, 0xf4, 0xc8, 0x99, 0x6f, 0xb9, 0x24,
+                0x27, 0xae, 0x41, 0xe4, 0x64, 0x9b, 0x93, 0x4c, 0xa4, 0x95, 0x99, 0x1b, 0x78, 0x52, 0xb8, 0x55 } },
+        { "abc", { 0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea, 0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+                   0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c, 0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad } },
+        { "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+          { 0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8, 0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+            0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67, 0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1 } },
+    };
+    for (size_t v = 0; v < sizeof(vectors) / sizeof(vectors[0]); v++) {
+        uint8_t digest[32];
+        truernd__sha256((const uint8_t*)vectors[v].msg, strlen(vectors[v].msg), digest);
+        if (memcmp(digest, vectors[v].digest, 32) != 0) all_passed = 0;
+    }
+    printf("SHA-256 (%s): %s\n",
+           truernd_capabilities() & TRUERND_CAP_SHA2 ? "hardware" : "scalar",
+           all_passed ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+
+    /* The scalar rounds must agree with whichever kernel the dispatcher picks */
+    uint8_t data[640];
+    if (truernd_fill(data, sizeof(data)) != 0) all_passed = 0;
+    uint32_t a[8] = { 1, 2, 3, 4, 5, 6, 7, 8 }, b[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    truernd__sha256_blocks(a, data, sizeof(data) / 64);
+    truernd__sha256_blocks_scalar(b, data, sizeof(data) / 64);
+    if (memcmp(a, b, sizeof(a)) != 0) all_passed = 0;
+
+    truernd_mix_t saved;
+    truernd_get_mix(&saved);
+    truernd_backend_t bound = truernd_get_backend();
+    static const truernd_mix_t mixes[] = {
+        { TRUERND_MIX_HW | TRUERND_MIX_OS, TRUERND_MIX_XOR },
+        { TRUERND_MIX_HW | TRUERND_MIX_OS, TRUERND_MIX_SHA256 },
+        { TRUERND_MIX_HW | TRUERND_MIX_OS | TRUERND_MIX_JITTER, TRUERND_MIX_SHA256 },
+        { TRUERND_MIX_OS | TRUERND_MIX_JITTER, TRUERND_MIX_SHA256 },
+        { TRUERND_MIX_HW, TRUERND_MIX_SHA256 },
+    };
+    uint8_t buf[3 * TRUERND_MIX_BATCH + 13];
+    for (size_t m = 0; m < sizeof(mixes) / sizeof(mixes[0]); m++) {
+        memset(buf, 0, sizeof(buf));
+        int ok = truernd_set_mix(&mixes[m]) == 0 &&
+                 truernd_set_backend(TRUERND_BACKEND_MIXED) == 0 &&
+                 truernd_fill(buf, sizeof(buf)) == 0;
+        size_t zeros = 0;
+        for (size_t i = 0; i < sizeof(buf); i++) zeros += buf[i] == 0;
+        if (zeros > sizeof(buf) / 64) ok = 0;
+        printf("  sources 0x%x mode %d: %s\n", mixes[m].sources, mixes[m].mode,
+               ok ? ANSI_GREEN "PASS" ANSI_RESET : ANSI_RED "FAIL" ANSI_RESET);
+        if (!ok) all_passed = 0;
+    }
+
+    static const truernd_mix_t invalid[] = {
+        { 0, TRUERND_MIX_XOR },
+        { TRUERND_MIX_JITTER, TRUERND_MIX_SHA256 },
+        { TRUERND_MIX_OS | TRUERND_MIX_JITTER, TRUERND_MIX_XOR },
+        { TRUERND_MIX_OS, 7 },
+    };
+    for (size_t m = 0; m < sizeof(invalid) / sizeof(invalid[0]); m++) {
+        if (truernd_set_mix(&invalid[m]) != -1) all_passed = 0;
+    }
+    truernd_set_mix(&saved);
+    truernd_set_backend(bound);
+
+    if (all_passed) {
+        print_pass("Mixed sources hash and combine correctly");
+        return 1;
+    } else {
+        print_fail("Source mixing produced wrong output");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 25: Inline getters against the out-of-line symbols
+ */
+static int test_inline_getters(void) {
+    print_header("TEST 25: Inline Getters");
+
+    int all_passed = 1;
+    printf("TRUERND_INLINE_GETTERS=%d\n", TRUERND_INLINE_GETTERS);
+
+    /* Both forms keep the NULL and failure contract */
+    if (truernd_get32_inline(NULL) != -1 || truernd_get64_inline(NULL) != -1) all_passed = 0;
+    if ((truernd_get32)(NULL) != -1 || (truernd_get64)(NULL) != -1) all_passed = 0;
+
+    /* The exported symbols must still be reachable through a pointer */
+    int (*abi64)(uint64_t *) = truernd_get64;
+    uint64_t a = 0, b = 0, c = 0;
+    if (abi64(&a) != 0 || truernd_get64_inline(&b) != 0 || truernd_get64(&c) != 0) all_passed = 0;
+    if (a == b || b == c || a == c) all_passed = 0;
+
+    uint32_t x = 0, y = 0;
+    if ((truernd_get32)(&x) != 0 || truernd_get32_inline(&y) != 0 || x == y) all_passed = 0;
+    if (truernd_gen64_inline() == truernd_gen64_inline()) all_passed = 0;
+    if ((truernd_gen64)() == 0 && truernd_gen32_inline() == 0) all_passed = 0;
+
+    /* A tight loop of inline draws: every word must be fresh */
+    const int n = 1000000;
+    uint64_t prev = 0, repeats = 0;
+    clock_t start = clock();
+    for (int i = 0; i < n; i++) {
+        uint64_t v;
+        if (truernd_get64_inline(&v) != 0) continue;
+        repeats += v == prev;
+        prev = v;
+    }
+    double secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+    printf("  %d inline draws in %.3f s, %llu repeats\n", n, secs, (unsigned long long)repeats);
+    if (repeats != 0) all_passed = 0;
+
+    if (all_passed) {
+        print_pass("Inline and out-of-line getters agree");
+        return 1;
+    } else {
+        print_fail("Inline getters broke the getter contract");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 26: Split-word 32/16/8-bit draws
+ */
+static int test_split_words(void) {
+    print_header("TEST 26: Split-Word Draws");
+
+    int all_passed = 1;
+
+    /* Two 32-bit draws per hardware word, four 16-bit, eight 8-bit */
+    truernd__split_local.bits = 0;
+    truernd__split_local.avail = 0;
+    uint32_t a = 0, b = 0;
+    if (truernd_get32_split(&a) != 0 || truernd__split_local.avail != 32) all_passed = 0;
+    if (truernd_get32_split(&b) != 0 || truernd__split_local.avail != 0) all_passed = 0;
+    if (a == b) all_passed = 0;
+    uint16_t h;
+    for (unsigned int left = 48; left != (unsigned int)-16; left -= 16) {
+        if (truernd_get16(&h) != 0 || truernd__split_local.avail != left) all_passed = 0;
+    }
+
+    /* A draw wider than what is cached takes the rest and tops up from a new word */
+    uint8_t byte;
+    uint32_t w;
+    if (truernd_get8(&byte) != 0 || truernd__split_local.avail != 56) all_passed = 0;
+    if (truernd_get32_split(&w) != 0 || truernd__split_local.avail != 24) all_passed = 0;
+    if (truernd_get32_split(&w) != 0 || truernd__split_local.avail != 56) all_passed = 0;
+    if (truernd__split_local.bits >> truernd__split_local.avail) all_passed = 0;
+
+    /* The combining step must put cached bits low and fresh bits above them */
+    truernd__split_t sp = { 0xABCD, 16, 0 };
+    uint32_t out;
+    truernd__split_take(&sp, 32, 0x1122334455667788ull, &out);
+    if (out != 0x7788ABCDu || sp.bits != 0x112233445566ull || sp.avail != 48) all_passed = 0;
+    printf("  split take: %08x, %u bits left\n", out, sp.avail);
+
+    /* Every byte value turns up over 64K 8-bit draws */
+    static unsigned int counts[256];
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < 65536; i++) {
+        if (truernd_get8(&byte) != 0) { all_passed = 0; break; }
+        counts[byte]++;
+    }
+    unsigned int lo = ~0u, hi = 0;
+    for (int i = 0; i < 256; i++) {
+        if (counts[i] < lo) lo = counts[i];
+        if (counts[i] > hi) hi = counts[i];
+    }
+    printf("  get8 bucket counts: %u..%u (expect about 256)\n", lo, hi);
+    if (lo < 160 || hi > 360) all_passed = 0;
+
+    /* Pool draws share one split word across widths */
+    truernd_pool_t *pool = truernd_pool_local();
+    truernd_pool_refill(pool);
+    pool->rest = 0;
+    pool->rest_bits = 0;
+    size_t words = pool->avail;
+    uint32_t p32;
+    uint16_t p16;
+    uint8_t p8;
+    if (truernd_pool_get32(pool, &p32) != 0 || pool->avail != words - 1) all_passed = 0;
+    if (truernd_pool_get16(pool, &p16) != 0 || truernd_pool_get8(pool, &p8) != 0) all_passed = 0;
+    if (pool->avail != words - 1 || pool->rest_bits != 8) all_passed = 0;
+    if (truernd_pool_get16(pool, &p16) != 0 || pool->avail != words - 2 || pool->rest_bits != 56) all_passed = 0;
+    if (truernd_pool_get16(NULL, &p16) != -1 || truernd_get8(NULL) != -1) all_passed = 0;
+
+    if (all_passed) {
+        print_pass("Narrow draws use every bit of each word exactly once");
+        return 1;
+    } else {
+        print_fail("Split-word draws wasted or reused bits");
+        return 0;
+    }
+}
+
+/* Next outputs of every buffered source, for comparing a fork child with its parent */
+typedef struct fork_sample {
+    uint64_t pool[4];
+    uint64_t drbg[4];
+    uint64_t ring[4];
+    uint32_t split[2];
+    int rc;
+} fork_sample_t;
+
+static void take_fork_sample(fork_sample_t *fs, truernd_pool_t *heap_pool, truernd_drbg_t *drbg,
+                             truernd_ring_t *ring) {
+    memset(fs, 0, sizeof(*fs));
+    fs->rc |= truernd_pool_get64(truernd_pool_local(), &fs->pool[0]);
+    fs->rc |= truernd_pool_get64(truernd_pool_local(), &fs->pool[1]);
+    fs->rc |= truernd_pool_get64(heap_pool, &fs->pool[2]);
+    fs->rc |= truernd_pool_get64(heap_pool, &fs->pool[3]);
+    fs->rc |= truernd_drbg_fill(drbg, fs->drbg, sizeof(fs->drbg));
+    fs->rc |= truernd_ring_get(ring, fs->ring, sizeof(fs->ring));
+    fs->rc |= truernd_get32_split(&fs->split[0]);
+    fs->rc |= truernd_get32_split(&fs->split[1]);
+}
+
+/**
+ * @brief Test 27: Fork and snapshot invalidation
+ */
+static int test_fork_safety(void) {
+    print_header("TEST 27: Fork Safety");
+
+#if defined(__unix__) || defined(__APPLE__)
+    int all_passed = 1;
+
+    /* Prime every buffer so a child would inherit unused output */
+    static truernd_ring_slot_t slots[64];
+    truernd_ring_t ring;
+    truernd_drbg_t drbg;
+    truernd_pool_t *heap_pool = NULL;
+    long page = sysconf(_SC_PAGESIZE);
+    if (posix_memalign((void**)&heap_pool, (size_t)page, sizeof(*heap_pool)) != 0) {
+        print_fail("Could not allocate a page-aligned pool");
+        return 0;
+    }
+    truernd_pool_init(heap_pool);
+    int wiped = truernd_wipe_on_fork(heap_pool, sizeof(*heap_pool));
+    printf("MADV_WIPEONFORK on a heap pool: %s\n", wiped == 0 ? "yes" : "unavailable");
+    if (truernd_wipe_on_fork((uint8_t*)heap_pool + 1, 64) != -1) all_passed = 0;
+
+    uint32_t prime;
+    uint64_t word;
+    if (truernd_ring_init(&ring, slots, 64, 32) != 0 || truernd_ring_produce(&ring, 64) != 64) all_passed = 0;
+    if (truernd_drbg_init(&drbg, 0) != 0 || truernd_drbg_fill(&drbg, &word, sizeof(word)) != 0) all_passed = 0;
+    if (truernd_pool_refill(truernd_pool_local()) != 0 || truernd_pool_refill(heap_pool) != 0) all_passed = 0;
+    if (truernd_get32_split(&prime) != 0) all_passed = 0;
+
+    /* Parent and child each take the next values; none may match */
+    int fds[2];
+    fork_sample_t mine, theirs;
+    memset(&theirs, 0, sizeof(theirs));
+    if (pipe(fds) != 0) all_passed = 0;
+    pid_t pid = fork();
+    if (pid == 0) {
+        fork_sample_t fs;
+        take_fork_sample(&fs, heap_pool, &drbg, &ring);
+        ssize_t w = write(fds[1], &fs, sizeof(fs));
+        _exit(w == (ssize_t)sizeof(fs) ? 0 : 1);
+    }
+    take_fork_sample(&mine, heap_pool, &drbg, &ring);
+    int status = 0;
+    if (pid < 0 || read(fds[0], &theirs, sizeof(theirs)) != (ssize_t)sizeof(theirs)) all_passed = 0;
+    if (pid > 0) waitpid(pid, &status, 0);
+    close(fds[0]);
+    close(fds[1]);
+
+    const char *names[] = { "thread pool", "thread pool", "heap pool", "heap pool" };
+    for (int i = 0; i < 4; i++) {
+        if (mine.pool[i] == theirs.pool[i]) {
+            printf("  %s word %d repeated in the child\n", names[i], i);
+            all_passed = 0;
+        }
+        if (mine.drbg[i] == theirs.drbg[i] || mine.ring[i] == theirs.ring[i]) all_passed = 0;
+    }
+    if (mine.split[0] == theirs.split[0] || mine.split[1] == theirs.split[1]) all_passed = 0;
+    if (mine.rc != 0 || theirs.rc != 0 || status != 0) all_passed = 0;
+    printf("  child diverged: pool %016llx/%016llx, drbg %016llx/%016llx\n",
+           (unsigned long long)mine.pool[0], (unsigned long long)theirs.pool[0],
+           (unsigned long long)mine.drbg[0], (unsigned long long)theirs.drbg[0]);
+
+    /* A pool the helper filled, then switched back to SYNC and released, must
+     * be left alone by the child; the poison shows any write into it. It gets
+     * pages of its own, clear of heap_pool's MADV_WIPEONFORK range */
+    truernd_pool_t *released = NULL;
+    if (posix_memalign((void**)&released, (size_t)page, sizeof(*released)) != 0) all_passed = 0;
+    if (released) {
+        truernd_pool_init(released);
+        if (truernd_pool_set_mode(released, TRUERND_POOL_ASYNC) != 0 || truernd_pool_refill(released) != 0) {
+            all_passed = 0;
+        }
+        while (released->avail > TRUERND_POOL_PREFETCH_AT && truernd_pool_get64(released, &word) == 0) {}
+        if (truernd_pool_get64(released, &word) != 0 || released->shadow_state == TRUERND__SHADOW_IDLE) {
+            all_passed = 0;
+        }
+        if (truernd_pool_set_mode(released, TRUERND_POOL_SYNC) != 0) all_passed = 0;
+        memset(released, 0x5A, sizeof(*released));
+        int poison = released->shadow_state;
+
+        pid = fork();
+        if (pid == 0) _exit(released->shadow_state == poison ? 0 : 1);
+        status = -1;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || status != 0) {
+            printf("  fork child wrote into a released async pool\n");
+            all_passed = 0;
+        }
+        free(released);
+    }
+
+    /* In-process invalidation drops the word that was next in line */
+    truernd_pool_t *pool = truernd_pool_local();
+    if (truernd_pool_refill(pool) != 0) all_passed = 0;
+    uint64_t next = pool->active[pool->avail - 1];
+    truernd_invalidate_all();
+    if (truernd_pool_get64(pool, &word) != 0 || word == next || pool->avail != TRUERND_POOL_WORDS - 1) {
+        all_passed = 0;
+    }
+    free(heap_pool);
+
+    if (all_passed) {
+        print_pass("Buffered state is discarded across fork and invalidation");
+        return 1;
+    } else {
+        print_fail("A fork child or invalidation reused buffered output");
+        return 0;
+    }
+#else
+    print_warning("No fork() on this platform, skipping");
+    return 1;
+#endif
+}
+
+/**
+ * @brief Test 28: NUMA-local ring groups
+ */
+static int test_numa_rings(void) {
+    print_header("TEST 28: NUMA-Local Rings");
+
+    int all_passed = 1;
+    unsigned int nodes = truernd_numa_nodes();
+    unsigned int node = truernd_numa_node();
+    printf("Nodes: %u, this thread on node %u\n", nodes, node);
+    if (nodes == 0 || nodes > TRUERND_MAX_NODES || node >= nodes) all_passed = 0;
+
+    /* The node is cached and only asked for again every TRUERND_NODE_RECHECK calls */
+    truernd__node_local.left = 0;
+    truernd_numa_node();
+    if (truernd__node_local.left != TRUERND_NODE_RECHECK) all_passed = 0;
+    truernd_numa_node();
+    if (truernd__node_local.left != TRUERND_NODE_RECHECK - 1) all_passed = 0;
+
+#if defined(__linux__)
+    unsigned long mask[2] = {0};
+    long highest = truernd__parse_list("0-3,8,10-11\n", mask, 2);
+    if (highest != 11 || mask[0] != 0xD0Ful || mask[1] != 0) all_passed = 0;
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+    truernd_ring_group_t group;
+    if (truernd_ring_group_init(&group, 3, 8) != -1) all_passed = 0;
+    if (truernd_ring_group_init(&group, 256, 8) != 0 || group.nnodes != nodes) {
+        print_fail("Could not map the per-node rings");
+        return 0;
+    }
+    for (unsigned int i = 0; i < group.nnodes; i++) {
+        if (((uintptr_t)group.rings[i]->slots & (TRUERND_CACHE_LINE - 1)) != 0) all_passed = 0;
+    }
+    if (truernd_ring_group_start(&group) != 0) all_passed = 0;
+
+    /* Draws from the local ring are fresh, whether or not the producer kept up */
+    static uint64_t seen[4096];
+    for (size_t i = 0; i < 4096; i++) {
+        if (truernd_ring_group_get(&group, &seen[i], sizeof(seen[i])) != 0) all_passed = 0;
+    }
+    size_t repeats = 0;
+    for (size_t i = 1; i < 4096; i++) repeats += seen[i] == seen[i - 1];
+    if (repeats != 0) all_passed = 0;
+    printf("  4096 draws from the node-%u ring, level now %zu\n", node,
+           truernd_ring_level(group.rings[node < group.nnodes ? node : 0]));
+
+    truernd_ring_group_free(&group);
+    if (group.nnodes != 0 || group.rings[0] != NULL) all_passed = 0;
+    if (truernd_ring_group_get(&group, seen, 8) != -1) all_passed = 0;
+#endif
+
+    if (all_passed) {
+        print_pass("Ring groups place, route and tear down per node");
+        return 1;
+    } else {
+        print_fail("NUMA ring group misbehaved");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 29: Contexts in caller storage and the static arena
+ */
+static int test_contexts(void) {
+    print_header("TEST 29: Caller-Owned Contexts");
+
+    int all_passed = 1;
+    printf("TRUERND_CTX_SIZE: %zu bytes, arena of %d\n", (size_t)TRUERND_CTX_SIZE, TRUERND_STATIC_ARENA);
+
+    /* Any alignment works as long as TRUERND_CTX_SIZE bytes are there */
+    static uint8_t storage[TRUERND_CTX_SIZE + 1];
+    if (truernd_ctx_init(storage + 1, TRUERND_CTX_SIZE - TRUERND_CACHE_LINE) != NULL) all_passed = 0;
+    truernd_ctx_t *ctx = truernd_ctx_init(storage + 1, TRUERND_CTX_SIZE);
+    if (!ctx || ((uintptr_t)ctx & (TRUERND_CACHE_LINE - 1)) != 0 ||
+        (uint8_t*)(ctx + 1) > storage + sizeof(storage)) {
+        print_fail("Context did not fit its storage");
+        return 0;
+    }
+
+    uint64_t a = 0, b = 0, block[64];
+    uint32_t c = 0;
+    if (truernd_ctx_get64(ctx, &a) != 0 || truernd_ctx_get64(ctx, &b) != 0 || a == b) all_passed = 0;
+    if (truernd_ctx_get32(ctx, &c) != 0) all_passed = 0;
+    if (truernd_seed_is_supported()) {
+        memset(block, 0, sizeof(block));
+        if (truernd_ctx_fill(ctx, block, sizeof(block)) != 0 || block[0] == block[63]) all_passed = 0;
+    }
+
+    truernd_ctx_destroy(ctx);
+    for (size_t i = 0; i < sizeof(*ctx); i++) {
+        if (((uint8_t*)ctx)[i] != 0) { all_passed = 0; break; }
+    }
+    if (truernd_ctx_fill(ctx, block, sizeof(block)) != -1) all_passed = 0;
+    if (truernd_ctx_get64(ctx, &a) != -1 || truernd_ctx_get32(ctx, &c) != -1) all_passed = 0;
+
+    /* The arena hands out each slot once until it comes back */
+    truernd_ctx_t *taken[TRUERND_STATIC_ARENA + 1];
+    int got = 0;
+    for (int i = 0; i <= TRUERND_STATIC_ARENA; i++) {
+        taken[i] = truernd_ctx_acquire();
+        got += taken[i] != NULL;
+    }
+    if (got != TRUERND_STATIC_ARENA || taken[TRUERND_STATIC_ARENA] != NULL) all_passed = 0;
+    if (TRUERND_STATIC_ARENA > 0) {
+        if (truernd_ctx_get64(taken[0], &a) != 0) all_passed = 0;
+        truernd_ctx_release(taken[0]);
+        if (truernd_ctx_acquire() != taken[0] || taken[0]->pool.avail != 0) all_passed = 0;
+    }
+    for (int i = 0; i < TRUERND_STATIC_ARENA; i++) truernd_ctx_release(taken[i]);
+
+    if (all_passed) {
+        print_pass("Contexts live in caller or arena storage without malloc");
+        return 1;
+    } else {
+        print_fail("Context storage misbehaved");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 30: Deterministic replay backend
+ */
+static int test_replay(void) {
+    print_header("TEST 30: Replay Backend");
+
+    int all_passed = 1;
+    truernd_backend_t bound = truernd_get_backend();
+
+    /* xoshiro256++ reference: state {1, 2, 3, 4} gives 41943041 first */
+    uint64_t xs[4] = { 1, 2, 3, 4 };
+    if (truernd__xoshiro256pp(xs) != 41943041ull) all_passed = 0;
+
+    /* AUTO and FASTEST must never land on it */
+    if (truernd_set_backend(TRUERND_BACKEND_AUTO) != 0 || truernd_get_backend() == TRUERND_BACKEND_REPLAY) all_passed = 0;
+    if (truernd_set_backend(TRUERND_BACKEND_FASTEST) != 0 || truernd_get_backend() == TRUERND_BACKEND_REPLAY) all_passed = 0;
+
+    /* Same seed, same bytes, through truernd_fill() and the pool alike */
+    uint8_t a[100], b[100];
+    uint64_t pa, pb;
+    if (truernd_set_backend(TRUERND_BACKEND_REPLAY) != 0) all_passed = 0;
+    truernd_replay_seed(42);
+    if (truernd_fill(a, sizeof(a)) != 0) all_passed = 0;
+    if (truernd_pool_refill(truernd_pool_local()) != 0 || truernd_pool_get64(truernd_pool_local(), &pa) != 0) all_passed = 0;
+    truernd_replay_seed(42);
+    if (truernd_fill(b, sizeof(b)) != 0) all_passed = 0;
+    if (truernd_pool_refill(truernd_pool_local()) != 0 || truernd_pool_get64(truernd_pool_local(), &pb) != 0) all_passed = 0;
+    if (memcmp(a, b, sizeof(a)) != 0 || pa != pb) all_passed = 0;
+    truernd_replay_seed(43);
+    if (truernd_fill(b, sizeof(b)) != 0 || memcmp(a, b, sizeof(a)) == 0) all_passed = 0;
+    printf("  seed 42 stream starts %02x%02x%02x%02x, repeatable: %s\n", a[0], a[1], a[2], a[3],
+           pa == pb ? "yes" : "no");
+
+    /* A recording plays back in order and wraps */
+    uint8_t rec[100], out[80];
+    for (int i = 0; i < 100; i++) rec[i] = (uint8_t)i;
+    if (truernd_replay_data(rec, 0) != -1 || truernd_replay_data(rec, sizeof(rec)) != 0) all_passed = 0;
+    if (truernd_fill(out, 30) != 0 || out[0] != 0 || out[29] != 29) all_passed = 0;
+    if (truernd_fill(out, 80) != 0 || out[0] != 30 || out[69] != 99 || out[70] != 0 || out[79] != 9) all_passed = 0;
+    truernd_replay_data(NULL, 0);
+
+    truernd_pool_init(truernd_pool_local());
+    truernd_set_backend(bound);
+
+    if (all_passed) {
+        print_pass("Replay is repeatable and never chosen by default");
+        return 1;
+    } else {
+        print_fail("Replay backend did not repeat or leaked into AUTO");
+        return 0;
+    }
+}
+
+/**
+ * @brief Test 31: Kernel entropy feeding
+ */
+static int test_kernel_feed(void) {
+    print_header("TEST 31: Kernel Entropy Feed");
+
+    int all_passed = 1;
+    int seeded = truernd_kernel_seeded();
+    printf("  kernel CRNG: %s\n", seeded == 1 ? "seeded" : seeded == 0 ? "not seeded" : "unknown");
+
+    /* A running system is long past seeding: the feeder must notice and
+     * return without an ioctl (which would need CAP_SYS_ADMIN) */
+    if (seeded == 1) {
+        if (truernd_feed_kernel(0, 0, 1) != 0) all_passed = 0;
+        if (truernd_feed_kernel(1u << 20, 1000, 0) != 0) all_passed = 0;
+    }
+
+    if (all_passed) {
+        print_pass("Feeder stops once the kernel is seeded");
+        return 1;
+    } else {
+        print_fail("Feeder did not detect a seeded kernel");
+        return 0;
+    }
+}
+
 /**
  * @brief Main test runner
  */
@@ -400,6 +2050,29 @@ int main(void) {
     total_tests++; passed_tests += test_performance();
     total_tests++; passed_tests += test_error_handling();
     total_tests++; passed_tests += test_gen_functions();
+    total_tests++; passed_tests += test_pool();
+    total_tests++; passed_tests += test_drbg();
+    total_tests++; passed_tests += test_retry_policy();
+    total_tests++; passed_tests += test_backends();
+    total_tests++; passed_tests += test_parallel();
+    total_tests++; passed_tests += test_uniform();
+    total_tests++; passed_tests += test_typed_fill();
+    total_tests++; passed_tests += test_stats();
+    total_tests++; passed_tests += test_ring();
+    total_tests++; passed_tests += test_pool_modes();
+    total_tests++; passed_tests += test_file_fill();
+    total_tests++; passed_tests += test_nt_fill();
+    total_tests++; passed_tests += test_fixed_fill();
+    total_tests++; passed_tests += test_identifiers();
+    total_tests++; passed_tests += test_health();
+    total_tests++; passed_tests += test_mixing();
+    total_tests++; passed_tests += test_inline_getters();
+    total_tests++; passed_tests += test_split_words();
+    total_tests++; passed_tests += test_fork_safety();
+    total_tests++; passed_tests += test_numa_rings();
+    total_tests++; passed_tests += test_contexts();
+    total_tests++; passed_tests += test_replay();
+    total_tests++; passed_tests += test_kernel_feed();
 
     printf("\n");
     print_thick_separator();
@@ -0,0 +1,107 @@
+/*
+ * Tests for the C++ front-end in truerandom.hpp
+ */
+
+#define TRUERANDOM_IMPLEMENTATION
+#include "truerandom.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+static int failures = 0;
+
+static void check(bool ok, const char *what) {
+    std::printf("%s %s\n", ok ? "PASS" : "FAIL", what);
+    if (!ok) failures++;
+}
+
+/* Fill N bytes between guard bytes and check that only those changed */
+template <std::size_t N>
+static bool guarded_fill() {
+    unsigned char buf[16 + N + 16];
+    std::memset(buf, 0xA5, sizeof(buf));
+    if (truernd::fill<N>(buf + 16) != 0) return false;
+    std::size_t changed = 0;
+    for (std::size_t i = 0; i < 16; i++) {
+        if (buf[i] != 0xA5 || buf[16 + N + i] != 0xA5) return false;
+    }
+    for (std::size_t i = 0; i < N; i++) changed += buf[16 + i] != 0xA5;
+    return N < 16 || changed * 10 >= N * 9;
+}
+
+template <std::size_t... N>
+static bool guarded_fills() {
+    return (guarded_fill<N>() && ...);
+}
+
+int main() {
+    if (!truernd_is_supported()) {
+        std::printf("No hardware RNG, skipping\n");
+        return 0;
+    }
+
+    truernd_pool_init(truernd_pool_local());
+    check(guarded_fills<1, 7, 8, 9, 16, 31, 32, 33, TRUERND_POOL_WORDS * 8 + 1>(),
+          "fill<N> from a drained pool writes exactly N bytes");
+    truernd_pool_refill(truernd_pool_local());
+    check(guarded_fills<1, 7, 8, 9, 16, 31, 32, 33>(),
+          "fill<N> from a full pool writes exactly N bytes");
+
+    std::uint32_t words[5] = {};
+    check(truernd::fill(words) == 0 && (words[0] | words[4]) != 0, "fill(T (&)[N])");
+
+    std::array<std::uint64_t, 2> key{};
+    check(truernd::generate(key) == 0 && (key[0] | key[1]) != 0, "generate(T &)");
+
+    std::uint64_t a = truernd::generate<std::uint64_t>();
+    std::uint64_t b = truernd::generate<std::uint64_t>();
+    check(a != b, "generate<T>() returns fresh values");
+
+#ifdef __cpp_lib_span
+    std::byte uuid[16] = {};
+    check(truernd::fill(std::span<std::byte, 16>(uuid)) == 0, "fill(std::span<std::byte, N>)");
+#endif
+
+    /* Engines must work with <random> and drain whole blocks without repeats */
+    {
+        truernd::engine hw;
+        truernd::drbg_engine drbg;
+        std::uniform_int_distribution<int> die(1, 6);
+        int counts[7] = {};
+        for (int i = 0; i < 6000; i++) counts[die(hw)]++;
+        bool spread = true;
+        for (int f = 1; f <= 6; f++) spread = spread && counts[f] > 700 && counts[f] < 1300;
+        check(spread, "engine drives uniform_int_distribution");
+
+        std::vector<std::uint64_t> seen;
+        for (std::size_t i = 0; i < 3 * truernd::drbg_engine::block_words + 5; i++) seen.push_back(drbg());
+        std::sort(seen.begin(), seen.end());
+        check(std::adjacent_find(seen.begin(), seen.end()) == seen.end(),
+              "drbg_engine output spans refills without repeats");
+
+        std::vector<int> deck(52);
+        for (int i = 0; i < 52; i++) deck[i] = i;
+        std::vector<int> shuffled = deck;
+        std::shuffle(shuffled.begin(), shuffled.end(), drbg);
+        std::vector<int> sorted = shuffled;
+        std::sort(sorted.begin(), sorted.end());
+        check(sorted == deck && shuffled != deck, "std::shuffle with drbg_engine permutes");
+
+        truernd::drbg_engine chacha(TRUERND_DRBG_CHACHA20, 4096);
+        check(chacha() != chacha() && chacha.reseed() == 0, "ChaCha20 drbg_engine with reseed");
+        hw.discard(100);
+
+        std::uint64_t before = chacha();
+        truernd_invalidate_all();
+        std::uint64_t after = chacha();
+        check(before != after, "engines keep drawing after truernd_invalidate_all()");
+        check(truernd::engine::min() == 0 && truernd::engine::max() == ~0ull, "engine range");
+    }
+
+    std::printf("%s\n", failures ? "C++ front-end tests FAILED" : "All C++ front-end tests passed");
+    return failures ? 1 : 0;
+}
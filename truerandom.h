@@ -7,6 +7,12 @@
 #ifndef TRUERANDOM_H
 #define TRUERANDOM_H
 
+/* madvise() and MAP_HUGETLB need glibc's default feature set, even under -std=c99.
+ * This only takes effect when the header is the first include of the TU. */
+#if defined(TRUERANDOM_IMPLEMENTATION) && defined(__linux__) && !defined(_DEFAULT_SOURCE)
+#define _DEFAULT_SOURCE
+#endif
+
 #include <stdint.h>
 #include <stddef.h>
 
@@ -22,6 +28,118 @@ extern "C" {
 #define TRUERND_MAX_RETRIES 10
 #endif
 
+#ifndef TRUERND_POOL_WORDS
+#define TRUERND_POOL_WORDS 64
+#endif
+
+#ifndef TRUERND_POOL_PREFETCH_AT
+#define TRUERND_POOL_PREFETCH_AT (TRUERND_POOL_WORDS / 2)
+#endif
+
+#ifndef TRUERND_POOL_SLICE_WORDS
+#define TRUERND_POOL_SLICE_WORDS 4
+#endif
+
+#ifndef TRUERND_SEED_RETRIES
+#define TRUERND_SEED_RETRIES 100
+#endif
+
+#ifndef TRUERND_DRBG_RESEED_BYTES
+#define TRUERND_DRBG_RESEED_BYTES (1u << 20)
+#endif
+
+#ifndef TRUERND_BACKOFF_MIN
+#define TRUERND_BACKOFF_MIN 4
+#endif
+
+#ifndef TRUERND_BACKOFF_MAX
+#define TRUERND_BACKOFF_MAX 1024
+#endif
+
+#ifndef TRUERND_OS_FALLBACK
+#define TRUERND_OS_FALLBACK 0
+#endif
+
+#ifndef TRUERND_DEFAULT_BACKEND
+#define TRUERND_DEFAULT_BACKEND TRUERND_BACKEND_AUTO
+#endif
+
+#ifndef TRUERND_PARALLEL_MIN_CHUNK
+#define TRUERND_PARALLEL_MIN_CHUNK (256u * 1024u)
+#endif
+
+#ifndef TRUERND_PARALLEL_MAX_THREADS
+#define TRUERND_PARALLEL_MAX_THREADS 256
+#endif
+
+#ifndef TRUERND_NT_THRESHOLD
+#define TRUERND_NT_THRESHOLD (4u * 1024u * 1024u)
+#endif
+
+#ifndef TRUERND_FILE_WINDOW
+#define TRUERND_FILE_WINDOW (64u * 1024u * 1024u)
+#endif
+
+#ifndef TRUERND_STREAM_CHUNK
+#define TRUERND_STREAM_CHUNK (2u * 1024u * 1024u)
+#endif
+
+#ifndef TRUERND_RING_BATCH
+#define TRUERND_RING_BATCH 16
+#endif
+
+#ifndef TRUERND_STATS
+#define TRUERND_STATS 0
+#endif
+
+#ifndef TRUERND_STATS_SLOTS
+#define TRUERND_STATS_SLOTS 256
+#endif
+
+#ifndef TRUERND_HEALTH
+#define TRUERND_HEALTH 0
+#endif
+
+#ifndef TRUERND_MIX_BATCH
+#define TRUERND_MIX_BATCH 2048
+#endif
+
+#ifndef TRUERND_HEALTH_APT_CUTOFF
+#define TRUERND_HEALTH_APT_CUTOFF 20
+#endif
+
+#ifndef TRUERND_INLINE_GETTERS
+#define TRUERND_INLINE_GETTERS 1
+#endif
+
+#ifndef TRUERND_SPLIT_WORDS
+#define TRUERND_SPLIT_WORDS 0
+#endif
+
+#ifndef TRUERND_MAX_NODES
+#define TRUERND_MAX_NODES 8
+#endif
+
+#ifndef TRUERND_NODE_RECHECK
+#define TRUERND_NODE_RECHECK 256
+#endif
+
+#ifndef TRUERND_STATIC_ARENA
+#define TRUERND_STATIC_ARENA 0
+#endif
+
+#ifndef TRUERND_REPLAY
+#define TRUERND_REPLAY 0
+#endif
+
+#ifndef TRUERND_FEED_BATCH
+#define TRUERND_FEED_BATCH 4096
+#endif
+
+#ifndef TRUERND_FEED_CREDIT
+#define TRUERND_FEED_CREDIT 1
+#endif
+
 /*
  * End User Configurations
  */
@@ -50,10 +168,214 @@ extern "C" {
     #define NAKED __attribute__((naked))
 #endif
 
+/* 
+ * @brief Alignment and thread-local storage attributes
+ */
+#define TRUERND_CACHE_LINE 64
+
+#if defined(_MSC_VER)
+    #define TRUERND_ALIGNED(n) __declspec(align(n))
+    #define TRUERND_TLS __declspec(thread)
+#else
+    #define TRUERND_ALIGNED(n) __attribute__((aligned(n)))
+    #define TRUERND_TLS __thread
+#endif
+
+/**
+ * @brief Pool refill modes for truernd_pool_set_mode()
+ */
+#define TRUERND_POOL_SYNC   0   /* Refill in place when empty */
+#define TRUERND_POOL_SLICED 1   /* Refill the shadow buffer a slice per draw */
+#define TRUERND_POOL_ASYNC  2   /* Refill the shadow buffer on a helper thread */
+
+/**
+ * @brief Buffered entropy pool, refilled TRUERND_POOL_WORDS words at a time
+ * @note A zero-initialized pool is valid, empty and in TRUERND_POOL_SYNC mode
+ */
+typedef struct truernd_pool {
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t words[TRUERND_POOL_WORDS];
+    size_t avail;           /* Words left to hand out, taken from the top down */
+    uint64_t rest;          /* Unconsumed bits of the last word split by a narrow draw */
+    unsigned int rest_bits; /* How many bits of rest are left, from the bottom */
+    uint32_t gen;           /* truernd__generation the contents were drawn under */
+    uint64_t *active;       /* words or spare, whichever is handed out; NULL before first use */
+    size_t prefetch_at;     /* avail at or below which draws take the refill path */
+    int mode;               /* TRUERND_POOL_SYNC, TRUERND_POOL_SLICED or TRUERND_POOL_ASYNC */
+    int shadow_state;       /* Async: idle, pending on the helper thread, or ready */
+    size_t shadow_filled;   /* Sliced: shadow words refilled so far */
+    uint64_t *shadow;       /* Async: buffer the helper is filling */
+    struct truernd_pool *next_pending;  /* Async: helper queue link */
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t spare[TRUERND_POOL_WORDS];
+} truernd_pool_t;
+
+/**
+ * @brief Implementations truernd_fill() can be bound to at runtime
+ */
+typedef enum truernd_backend {
+    TRUERND_BACKEND_AUTO = 0,       /* Hardware draws, else a DRBG, else the OS */
+    TRUERND_BACKEND_FASTEST,        /* A DRBG, else hardware draws, else the OS */
+    TRUERND_BACKEND_HW,             /* Unrolled RDRAND / RNDR kernel */
+    TRUERND_BACKEND_DRBG_CHACHA20,  /* Per-thread RDSEED/RNDRRS-seeded ChaCha20 */
+    TRUERND_BACKEND_DRBG_AES,       /* Per-thread RDSEED/RNDRRS-seeded AES-256-CTR */
+    TRUERND_BACKEND_OS,             /* truernd_os_fill() */
+    TRUERND_BACKEND_MIXED,          /* Several sources combined, see truernd_set_mix() */
+    TRUERND_BACKEND_REPLAY,         /* Deterministic test stream, NOT random; needs TRUERND_REPLAY */
+    TRUERND_BACKEND_COUNT
+} truernd_backend_t;
+
+/**
+ * @brief Source pipeline behind TRUERND_BACKEND_MIXED
+ */
+typedef struct truernd_mix {
+    unsigned int sources;   /* TRUERND_MIX_HW, TRUERND_MIX_OS and/or TRUERND_MIX_JITTER */
+    int          mode;      /* TRUERND_MIX_XOR or TRUERND_MIX_SHA256 */
+} truernd_mix_t;
+
+/**
+ * @brief Caller-provided thread pool for truernd_fill_parallel_ex()
+ * @note run() must call task(arg, i) exactly once for every i in [0, ntasks),
+ *       in any order and on any threads, and return once all calls finished
+ */
+typedef struct truernd_executor {
+    void *ctx;              /* Passed back to run() */
+    unsigned int workers;   /* Number of tasks to split the buffer into */
+    void (*run)(void *ctx, void (*task)(void *arg, size_t index), void *arg, size_t ntasks);
+} truernd_executor_t;
+
+/**
+ * @brief What to do between failed hardware draws
+ * @note Defaults come from TRUERND_MAX_RETRIES, TRUERND_SEED_RETRIES,
+ *       TRUERND_BACKOFF_MIN, TRUERND_BACKOFF_MAX and TRUERND_OS_FALLBACK
+ */
+typedef struct truernd_retry_policy {
+    int      max_retries;   /* RDRAND/RNDR attempts per word before giving up */
+    int      seed_retries;  /* RDSEED/RNDRRS attempts per word before giving up */
+    uint32_t backoff_min;   /* pause/yield spins after the first failure, 0 for a tight loop */
+    uint32_t backoff_max;   /* Cap for the spin count, which doubles after every failure */
+    int      os_fallback;   /* Non-zero to take the word from the OS once attempts run out */
+} truernd_retry_policy_t;
+
+/**
+ * @brief Counters summed over every thread, see truernd_stats_snapshot()
+ * @note Direct truernd_get32()/truernd_get64() calls are naked and not counted;
+ *       everything built on the retrying draws and truernd_fill() is
+ */
+typedef struct truernd_stats {
+    uint64_t draws;             /* Hardware draws issued, including retries and seeding */
+    uint64_t underflows;        /* Draws that came back with the carry/Z flag clear */
+    uint64_t retries;           /* Extra attempts made after an underflow */
+    uint64_t max_retry_streak;  /* Most retries one word needed */
+    uint64_t failures;          /* Words that ran out of attempts */
+    uint64_t bytes;             /* Bytes produced by successful backend fills */
+    uint64_t cycles;            /* TSC/CNTVCT ticks spent inside backend fills */
+    uint64_t threads;           /* Threads that have recorded anything */
+} truernd_stats_t;
+
+/**
+ * @brief One cache line of a shared entropy ring
+ * @note seq encodes the slot state for the current lap, see truernd_ring_init()
+ */
+typedef struct truernd_ring_slot {
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t seq;
+    uint8_t data[32];
+    uint32_t gen;               /* truernd__generation data was produced under */
+} truernd_ring_slot_t;
+
+struct truernd_ring;
+
+/**
+ * @brief Called by the consumer whose draw takes the ring to its low watermark
+ */
+typedef void (*truernd_ring_low_fn)(struct truernd_ring *ring, void *arg);
+
+/**
+ * @brief Lock-free single-producer, multi-consumer ring of random chunks
+ * @note Slots are caller memory; the producer and consumer cursors sit on
+ *       their own cache lines
+ */
+typedef struct truernd_ring {
+    truernd_ring_slot_t *slots;
+    uint64_t mask;                  /* Slot count minus one */
+    size_t chunk;                   /* Bytes per slot and per draw */
+    size_t low_watermark;           /* Filled slots at or below which on_low fires */
+    truernd_ring_low_fn on_low;
+    void *on_low_arg;
+    void *worker;                   /* Background producer, see truernd_ring_start() */
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t head;  /* Next position to produce */
+    int low_fired;                  /* Set once on_low has fired for this drain */
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t tail;  /* Next consumer ticket */
+} truernd_ring_t;
+
+/**
+ * @brief One ring per NUMA node, each in its own node's memory
+ * @note Set up with truernd_ring_group_init(); draws go to the caller's node
+ */
+typedef struct truernd_ring_group {
+    unsigned int nnodes;
+    truernd_ring_t *rings[TRUERND_MAX_NODES];  /* Ring header and slots share one mapping */
+    size_t map_len;                            /* Bytes mapped per node */
+} truernd_ring_group_t;
+
+/**
+ * @brief DRBG ciphers for truernd_drbg_init_ex()
+ */
+#define TRUERND_DRBG_CHACHA20 0   /* ChaCha20, vectorized with SSE2/NEON */
+#define TRUERND_DRBG_AES256   1   /* AES-256-CTR on AES-NI or ARMv8 AES */
+
+/**
+ * @brief DRBG seeded from RDSEED (x86) or RNDRRS (ARM64)
+ */
+typedef struct truernd_drbg {
+    uint32_t key[8];
+    int      cipher;            /* TRUERND_DRBG_CHACHA20 or TRUERND_DRBG_AES256 */
+    uint64_t counter;           /* Next ChaCha20 block under the current key */
+    uint64_t reseed_interval;   /* Output bytes between reseeds */
+    uint64_t until_reseed;      /* Output bytes left before the next reseed */
+    uint32_t gen;               /* truernd__generation of the last reseed */
+} truernd_drbg_t;
+
+/**
+ * @brief A pool and a DRBG in caller-provided storage
+ * @note Built by truernd_ctx_init() inside any buffer of TRUERND_CTX_SIZE
+ *       bytes, so request threads can own random state without touching
+ *       the allocator
+ */
+typedef struct truernd_ctx {
+    truernd_pool_t pool;
+    truernd_drbg_t drbg;        /* Seeded on the first truernd_ctx_fill() */
+    uint32_t magic;             /* TRUERND__CTX_MAGIC while initialized */
+} truernd_ctx_t;
+
+/** @brief Storage truernd_ctx_init() needs, whatever the buffer's alignment */
+#define TRUERND_CTX_SIZE (sizeof(truernd_ctx_t) + TRUERND_CACHE_LINE - 1)
+
 /** \addtogroup PUBLIC API
  *  @{
  */
 
+/**
+ * @brief Capability bits reported by truernd_capabilities()
+ */
+#define TRUERND_CAP_RDRAND  (1u << 0)   /* x86 RDRAND */
+#define TRUERND_CAP_RDSEED  (1u << 1)   /* x86 RDSEED */
+#define TRUERND_CAP_RNDR    (1u << 2)   /* ARM64 RNDR */
+#define TRUERND_CAP_RNDRRS  (1u << 3)   /* ARM64 RNDRRS */
+#define TRUERND_CAP_AES     (1u << 4)   /* x86 AES-NI or ARMv8 AES instructions */
+#define TRUERND_CAP_NEON    (1u << 5)   /* ARM64 Advanced SIMD */
+#define TRUERND_CAP_AVX2    (1u << 6)   /* x86 AVX2, with OS support */
+#define TRUERND_CAP_AVX512  (1u << 7)   /* x86 AVX-512F, with OS support */
+#define TRUERND_CAP_SSSE3   (1u << 8)   /* x86 SSSE3 */
+#define TRUERND_CAP_SHA2    (1u << 9)   /* x86 SHA-NI or ARMv8 SHA-256 instructions */
+
+/**
+ * @brief Get the hardware capabilities of the host CPU
+ * @return Bitmask of TRUERND_CAP_* flags
+ * @note CPUID/ID registers are read once and cached, so later calls cost one
+ *       load. Define TRUERND_PROBE_AT_STARTUP to probe from a constructor.
+ */
+static inline unsigned int 
+truernd_capabilities(void);
+
 /**
  * @brief Check if hardware random number generation is supported
  * @return 1 if supported, 0 if not supported
@@ -61,19 +383,26 @@ extern "C" {
 int 
 truernd_is_supported(void);
 
+/**
+ * @brief Check if the hardware seed source (RDSEED or RNDRRS) is supported
+ * @return 1 if supported, 0 if not supported
+ */
+int 
+truernd_seed_is_supported(void);
+
 /**
  * @brief Generate a 32-bit true random number (single attempt)
  * @return The random value
  */
 NAKED uint32_t 
-truernd_gen32(void);
+(truernd_gen32)(void);
 
 /**
  * @brief Generate a 64-bit true random number (single attempt)
  * @return The random value
  */
 NAKED uint64_t 
-truernd_gen64(void);
+(truernd_gen64)(void);
 
 /**
  * @brief Generate a 32-bit true random number (single attempt)
@@ -81,7 +410,7 @@ truernd_gen64(void);
  * @return 0 on success, -1 on failure
  */
 NAKED int 
-truernd_get32(uint32_t *out);
+(truernd_get32)(uint32_t *out);
 
 /**
  * @brief Generate a 64-bit true random number (single attempt)
@@ -89,305 +418,4887 @@ truernd_get32(uint32_t *out);
  * @return 0 on success, -1 on failure
  */
 NAKED int 
-truernd_get64(uint64_t *out);
+(truernd_get64)(uint64_t *out);
 
 /**
- * @brief Fill a buffer with random bytes
- * @param buf Buffer to fill
- * @param len Length of buffer in bytes
- * @return 0 on success, -1 on failure
- * @note Assumes little-endian byte order for byte extraction from 64-bit values
+ * @brief Inline forms of the single-attempt getters
+ * @note Same contract as truernd_get32() and friends, but written as
+ *       constrained asm (intrinsics under MSVC) so the draw is scheduled with
+ *       the caller and its value stays in a register. With
+ *       TRUERND_INLINE_GETTERS (the default) calls to the plain names expand
+ *       to these; the out-of-line symbols stay exported either way and can
+ *       still be named as (truernd_get64) or through a function pointer
  */
-static inline int 
-truernd_fill(void *buf, size_t len);
-
-/** @}*/
-
-#ifdef __cplusplus
-}
-#endif
-
-#endif /* TRUERANDOM_H */
-
-#ifdef TRUERANDOM_IMPLEMENTATION
-
-#ifdef __cplusplus
-extern "C" {
+#if defined(_MSC_VER) && defined(truernd_ARCH_X86)
+#include <immintrin.h>
 #endif
 
-/* Intel/AMD x86/x64 implementation using RDRAND */
-#if defined(truernd_ARCH_X86)
-
-#include <cpuid.h>
-
-NAKED int 
-truernd_is_supported(void) {
+static inline int
+truernd_get64_inline(uint64_t *out) {
+    if (!out) return -1;
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+    uint64_t val;
+    unsigned char ok;
     __asm__ volatile(
-            "xor     %esi, %esi     \n\t"
-            "xor     %eax, %eax     \n\t"
-            "xchg    %rdi, %rbx     \n\t"
-            "cpuid                  \n\t"
-            "xchg    %rdi, %rbx     \n\t"
-            "test    %eax, %eax     \n\t"
-            "je      1f             \n\t"
-            "mov     $1, %eax       \n\t"
-            "xchg    %rsi, %rbx     \n\t"
-            "cpuid                  \n\t"
-            "xchg    %rsi, %rbx     \n\t"
-            "mov     %esi, %ecx     \n\t"
-            "shr     $30, %esi      \n\t"
-            "and     $1, %esi       \n\t"
-            "1:                     \n\t"
-            "mov     %eax, %esi     \n\t"
-            "ret                    \n\t"
+        "rdrand %0              \n\t"
+        "setc   %1              \n\t"
+        : "=r"(val), "=qm"(ok)
+        :
+        : "cc"
     );
-}
-
-NAKED uint32_t 
-truernd_gen32(void) {
+    if (!ok) return -1;
+    *out = val;
+    return 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__i386__)
+    uint32_t lo, hi;
+    unsigned char ok_lo, ok_hi;
     __asm__ volatile(
-        "rdrand %eax       \n\t"
-        "jnc    1f         \n\t"
-        "ret               \n\t"
-
-        "1:                \n\t"
-        "xor    %eax, %eax \n\t"
-        "ret               \n\t"
+        "rdrand %0              \n\t"
+        "setc   %2              \n\t"
+        "rdrand %1              \n\t"
+        "setc   %3              \n\t"
+        : "=r"(lo), "=r"(hi), "=qm"(ok_lo), "=qm"(ok_hi)
+        :
+        : "cc"
     );
-}
-
-NAKED uint64_t 
-truernd_gen64(void) {
+    if (!(ok_lo & ok_hi)) return -1;
+    *out = ((uint64_t)hi << 32) | lo;
+    return 0;
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+    uint64_t val;
+    uint32_t ok;
     __asm__ volatile(
-        "rdrand %rax            \n\t"
-        "jnc    1f              \n\t"
-        "ret                    \n\t"
-    "1:                         \n\t"
-        "xor    %rax, %rax      \n\t"
-        "ret                    \n\t"
+        "mrs  %0, RNDR          \n\t"
+        "cset %w1, ne           \n\t"
+        : "=r"(val), "=r"(ok)
+        :
+        : "cc"
     );
+    if (!ok) return -1;
+    *out = val;
+    return 0;
+#elif defined(_MSC_VER) && defined(_M_X64)
+    unsigned __int64 val;
+    if (!_rdrand64_step(&val)) return -1;
+    *out = val;
+    return 0;
+#else
+    return (truernd_get64)(out);
+#endif
 }
 
-NAKED int 
-truernd_get32(uint32_t *) {
+static inline int
+truernd_get32_inline(uint32_t *out) {
+    if (!out) return -1;
+#if (defined(__GNUC__) || defined(__clang__)) && defined(truernd_ARCH_X86)
+    uint32_t val;
+    unsigned char ok;
     __asm__ volatile(
-        "test   %rdi, %rdi      \n\t"
-        "jz     1f              \n\t"
+        "rdrand %0              \n\t"
+        "setc   %1              \n\t"
+        : "=r"(val), "=qm"(ok)
+        :
+        : "cc"
+    );
+    if (!ok) return -1;
+    *out = val;
+    return 0;
+#elif defined(_MSC_VER) && defined(truernd_ARCH_X86)
+    unsigned int val;
+    if (!_rdrand32_step(&val)) return -1;
+    *out = val;
+    return 0;
+#else
+    /* RNDR is 64 bits only; keep the low half like the out-of-line version */
+    uint64_t val;
+    if (truernd_get64_inline(&val) != 0) return -1;
+    *out = (uint32_t)val;
+    return 0;
+#endif
+}
 
-        "rdrand %ecx            \n\t"
-        "jnc    1f              \n\t"
+static inline uint32_t
+truernd_gen32_inline(void) {
+    uint32_t val;
+    return truernd_get32_inline(&val) == 0 ? val : 0;
+}
 
-        "movl   %ecx, (%rdi)    \n\t"
-        "xor    %eax, %eax      \n\t"
-        "ret                    \n\t"
-    "1:                         \n\t"
-        "mov    $-1, %eax       \n\t"
-        "ret                    \n\t"
-    );
+static inline uint64_t
+truernd_gen64_inline(void) {
+    uint64_t val;
+    return truernd_get64_inline(&val) == 0 ? val : 0;
 }
 
-NAKED int 
-truernd_get64(uint64_t *) {
-    __asm__ volatile(
-        "test   %rdi, %rdi         \n\t"
-        "jz     1f                 \n\t"
+/* Bumped in a fork child and by truernd_invalidate_all(). Buffered state is
+ * stamped with the value it was filled under and dropped on a mismatch */
+extern uint32_t truernd__generation;
 
-        "rdrand %rcx               \n\t"
-        "jnc    1f                 \n\t"
+#if defined(__GNUC__) || defined(__clang__)
+    #define TRUERND__GENERATION() __atomic_load_n(&truernd__generation, __ATOMIC_RELAXED)
+#else
+    #define TRUERND__GENERATION() (*(volatile uint32_t *)&truernd__generation)
+#endif
 
-        "movq   %rcx, (%rdi)       \n\t"
-        "xor    %eax, %eax         \n\t"
-        "ret                       \n\t"
-    "1:                            \n\t"
-        "mov    $-1, %eax          \n\t"
-        "ret                       \n\t"
-    );
+/* Unconsumed low bits of the last word split by a narrow draw */
+typedef struct truernd__split {
+    uint64_t bits;
+    unsigned int avail;
+    uint32_t gen;
+} truernd__split_t;
+
+/* Take n <= 32 bits: what is left of the cached word first, topped up from
+ * val only when it runs short. Consumed bits are shifted out, so the cache
+ * never holds a value that was handed out. Returns 1 if val was used */
+static inline int
+truernd__split_take(truernd__split_t *sp, unsigned int n, uint64_t val, uint32_t *out) {
+    uint64_t mask = ((uint64_t)1 << n) - 1;
+    if (sp->avail >= n) {
+        *out = (uint32_t)(sp->bits & mask);
+        sp->bits >>= n;
+        sp->avail -= n;
+        return 0;
+    }
+    *out = (uint32_t)((sp->bits | (val << sp->avail)) & mask);
+    sp->bits = val >> (n - sp->avail);
+    sp->avail = 64 - (n - sp->avail);
+    return 1;
 }
 
-/* ARM implementation using RNDR */
-#elif defined(truernd_ARCH_ARM)
+/* Per-thread cache for the split getters. Each translation unit has its
+ * own, which is harmless: every cached bit is still handed out once */
+static TRUERND_TLS truernd__split_t truernd__split_local;
 
-#if defined(__aarch64__) || defined(_M_ARM64)
+static inline int
+truernd__split_get(unsigned int n, uint32_t *out) {
+    uint64_t val = 0;
+    if (!out) return -1;
+    if (truernd__split_local.gen != TRUERND__GENERATION()) {
+        truernd__split_local.bits = 0;
+        truernd__split_local.avail = 0;
+        truernd__split_local.gen = TRUERND__GENERATION();
+    }
+    if (truernd__split_local.avail < n && truernd_get64_inline(&val) != 0) return -1;
+    truernd__split_take(&truernd__split_local, n, val, out);
+    return 0;
+}
 
-NAKED int 
-truernd_is_supported(void) {
-    __asm__ volatile(
-        "mrs x0, ID_AA64ISAR0_EL1 \n\t"
-        "lsr x0, x0, #60          \n\t"
-        "and x0, x0, #0xF         \n\t"
-        "cmp x0, #0               \n\t"
-        "cset w0, ne              \n\t"
-        "ret                      \n\t"
-    );
+/**
+ * @brief 32-bit draw that uses both halves of each hardware word
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ * @note Runs one 64-bit RDRAND / RNDR per two calls and caches the other
+ *       half thread-locally. With TRUERND_SPLIT_WORDS, truernd_get32() and
+ *       truernd_gen32() use it too
+ */
+static inline int
+truernd_get32_split(uint32_t *out) {
+    return truernd__split_get(32, out);
 }
 
-NAKED uint32_t 
-truernd_gen32(void) {
-    __asm__ volatile(
-        "mrs x0, RNDR             \n\t"
-        "b.eq 1f                  \n\t"
-        "ret                      \n\t"
-    "1:                           \n\t"
-        "mov w0, #0               \n\t"
-        "ret                      \n\t"
-    );
+/**
+ * @brief 16-bit draw, four per hardware word
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ */
+static inline int
+truernd_get16(uint16_t *out) {
+    uint32_t val;
+    if (!out || truernd__split_get(16, &val) != 0) return -1;
+    *out = (uint16_t)val;
+    return 0;
 }
 
-NAKED uint64_t 
-truernd_gen64(void) {
-    __asm__ volatile(
-        "mrs x0, RNDR             \n\t"
-        "b.eq 1f                  \n\t"
-        "ret                      \n\t"
-    "1:                           \n\t"
-        "mov x0, #0               \n\t"
-        "ret                      \n\t"
-    );
+/**
+ * @brief 8-bit draw, eight per hardware word
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ */
+static inline int
+truernd_get8(uint8_t *out) {
+    uint32_t val;
+    if (!out || truernd__split_get(8, &val) != 0) return -1;
+    *out = (uint8_t)val;
+    return 0;
 }
 
-NAKED int 
-truernd_get32(uint32_t *out) {
-    __asm__ volatile(
-        "cbz x0, 1f               \n\t"
+static inline uint32_t
+truernd_gen32_split(void) {
+    uint32_t val;
+    return truernd_get32_split(&val) == 0 ? val : 0;
+}
 
-        "mrs x1, RNDR             \n\t"
-        "b.eq 1f                  \n\t"
+#if TRUERND_INLINE_GETTERS
+#define truernd_gen64()    truernd_gen64_inline()
+#define truernd_get64(out) truernd_get64_inline(out)
+#endif
+
+#if TRUERND_SPLIT_WORDS
+#define truernd_gen32()    truernd_gen32_split()
+#define truernd_get32(out) truernd_get32_split(out)
+#elif TRUERND_INLINE_GETTERS
+#define truernd_gen32()    truernd_gen32_inline()
+#define truernd_get32(out) truernd_get32_inline(out)
+#endif
+
+/**
+ * @brief Fill a buffer with random bytes from the bound backend
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @return 0 on success, -1 on failure, TRUERND_ERR_HEALTH (-2) if the output
+ *         failed a health test in TRUERND_HEALTH builds
+ * @note With the hardware backend, draws are issued four at a time and the
+ *       body of the buffer is written with aligned 64-bit stores; only the
+ *       unaligned head and tail are handled separately. Fills of at least
+ *       TRUERND_NT_THRESHOLD bytes use non-temporal stores
+ */
+int 
+truernd_fill(void *buf, size_t len);
+
+/**
+ * @brief Store policy flags for truernd_fill_ex()
+ */
+#define TRUERND_FILL_CACHED (1u << 0)   /* Always use ordinary cached stores */
+#define TRUERND_FILL_NT     (1u << 1)   /* Always use non-temporal stores */
+
+/**
+ * @brief Fill a buffer, choosing how its stores treat the cache
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @param flags TRUERND_FILL_CACHED, TRUERND_FILL_NT, or 0 to decide by TRUERND_NT_THRESHOLD
+ * @return 0 on success, -1 on failure, TRUERND_ERR_HEALTH (-2) if the output
+ *         failed a health test in TRUERND_HEALTH builds
+ * @note Non-temporal fills generate 16 KiB at a time into an L1 buffer and
+ *       stream it out with MOVNTDQ or STNP, then fence, so bulk output
+ *       does not evict other threads' working sets
+ */
+int 
+truernd_fill_ex(void *buf, size_t len, unsigned int flags);
+
+/**
+ * @brief Fill a small buffer whose length is known at compile time
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes, ideally a constant
+ * @return 0 on success, -1 on failure
+ * @note Takes ceil(len / 8) words straight from the thread-local pool. With a
+ *       constant len the copy and the wipe compile to fixed-size moves behind
+ *       a single avail check; lengths beyond the pool go to truernd_fill()
+ */
+static inline int 
+truernd_fill_fixed(void *buf, size_t len);
+
+/**
+ * @brief truernd_fill_fixed() for a length that must be a compile-time constant
+ * @note On GNU compilers a non-constant n is a compile error at every -O
+ *       level. The check sits where an integer constant expression is
+ *       required (a bit-field width in C, an array bound in C++), so it cannot
+ *       be taken as a VLA and left to the optimiser
+ */
+#if defined(__GNUC__) && defined(__cplusplus)
+#define TRUERND_FILL_FIXED(buf, n) \
+    ((void)sizeof(char[__builtin_constant_p(n) ? 1 : -1]), truernd_fill_fixed((buf), (n)))
+#elif defined(__GNUC__)
+#define TRUERND_FILL_FIXED(buf, n) \
+    ((void)sizeof(struct { int ok : __builtin_constant_p(n) ? 1 : -1; }), truernd_fill_fixed((buf), (n)))
+#else
+#define TRUERND_FILL_FIXED(buf, n) truernd_fill_fixed((buf), (n))
+#endif
+
+/**
+ * @brief Bind truernd_fill() and the pools to a backend
+ * @param backend Backend to use; AUTO and FASTEST are resolved for the host
+ * @return 0 on success, -1 if the backend is not available on this host
+ * @note Without a call, TRUERND_DEFAULT_BACKEND is bound on the first fill
+ */
+int 
+truernd_set_backend(truernd_backend_t backend);
+
+/**
+ * @brief Get the backend truernd_fill() is bound to
+ * @return A concrete backend, never AUTO or FASTEST
+ */
+truernd_backend_t 
+truernd_get_backend(void);
+
+/**
+ * @brief Check if a backend can run on this host
+ * @param backend Backend to check
+ * @return 1 if available, 0 if not
+ */
+int 
+truernd_backend_available(truernd_backend_t backend);
+
+/**
+ * @brief Short name of a backend, for logs and benchmarks
+ * @param backend Backend to name
+ * @return Static string, "unknown" for out-of-range values
+ */
+const char *
+truernd_backend_name(truernd_backend_t backend);
+
+/**
+ * @brief Fill a buffer through one backend, whichever is bound
+ * @param backend Backend to draw from; AUTO and FASTEST are resolved for the host
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @return 0 on success, -1 on failure or if the backend is not available here,
+ *         TRUERND_ERR_HEALTH (-2) if the output failed a health test in
+ *         TRUERND_HEALTH builds
+ * @note Lets a caller that needs a specific source (the C++ engine wants raw
+ *       hardware draws) bypass the process-wide binding
+ */
+int 
+truernd_fill_backend(truernd_backend_t backend, void *buf, size_t len);
+
+/**
+ * @brief Sources and combiners for truernd_mix_t
+ */
+#define TRUERND_MIX_HW      (1u << 0)   /* RDRAND / RNDR through the hardware kernel */
+#define TRUERND_MIX_OS      (1u << 1)   /* truernd_os_fill() */
+#define TRUERND_MIX_JITTER  (1u << 2)   /* CPU timing jitter, hashed in per batch (SHA256 only) */
+
+#define TRUERND_MIX_XOR     0   /* XOR the streams; output is as strong as the best source */
+#define TRUERND_MIX_SHA256  1   /* Hash 64 source bytes into every 32 output bytes */
+
+/**
+ * @brief Choose what TRUERND_BACKEND_MIXED combines, and how
+ * @param mix Pipeline to use, or NULL for HW + OS through SHA-256
+ * @return 0 on success, -1 if a source is unavailable or the combination is invalid
+ * @note Sources are drawn TRUERND_MIX_BATCH bytes at a time, so the OS call
+ *       and the hardware kernel run on large blocks. SHA-256 uses SHA-NI or
+ *       the ARMv8 SHA-256 instructions when present. Set it before other
+ *       threads draw from the mixed backend
+ */
+int 
+truernd_set_mix(const truernd_mix_t *mix);
+
+/**
+ * @brief Get the pipeline TRUERND_BACKEND_MIXED uses
+ * @param[out] mix Receives the current pipeline
+ */
+void 
+truernd_get_mix(truernd_mix_t *mix);
+
+/**
+ * @brief Restart the replay backend's PRNG stream from a seed
+ * @param seed Any value; the same seed gives the same bytes
+ * @note TRUERND_BACKEND_REPLAY is NOT FOR PRODUCTION: it exists so benchmarks
+ *       and tests of code built on truernd_fill() measure that code rather
+ *       than DRNG contention. It is only available when built with
+ *       TRUERND_REPLAY, and AUTO / FASTEST never select it. Each thread gets
+ *       xoshiro256++ seeded from seed and the order in which threads first
+ *       draw, so single-threaded runs repeat exactly
+ */
+void 
+truernd_replay_seed(uint64_t seed);
+
+/**
+ * @brief Replay recorded bytes instead of the PRNG
+ * @param data Recording, e.g. a file mapped by the caller; must stay valid
+ *             while bound. NULL switches back to the PRNG
+ * @param len Length of the recording in bytes
+ * @return 0 on success, -1 if len is 0 or the build lacks TRUERND_REPLAY
+ * @note Fills take consecutive bytes and wrap at the end. The position is
+ *       shared by all threads and rewinds on every call
+ */
+int 
+truernd_replay_data(const void *data, size_t len);
+
+/**
+ * @brief Number of online CPUs
+ * @return CPU count, at least 1
+ */
+unsigned int 
+truernd_cpu_count(void);
+
+/**
+ * @brief Fill a large buffer from several threads at once
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @param nthreads Worker threads, 0 for one per online CPU
+ * @return 0 on success, otherwise the first error a worker observed: -1, or
+ *         TRUERND_ERR_HEALTH (-2) if a chunk failed a health test in
+ *         TRUERND_HEALTH builds
+ * @note The buffer is split on cache-line boundaries and every worker draws
+ *       through its own per-thread backend state. Chunks are never smaller
+ *       than TRUERND_PARALLEL_MIN_CHUNK bytes.
+ */
+int 
+truernd_fill_parallel(void *buf, size_t len, unsigned int nthreads);
+
+/**
+ * @brief Fill a large buffer on a caller-provided thread pool
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @param exec Executor that runs the fill tasks
+ * @return 0 on success, otherwise the first error a task observed
+ */
+int 
+truernd_fill_parallel_ex(void *buf, size_t len, const truernd_executor_t *exec);
+
+/**
+ * @brief Flags for truernd_fill_file() and truernd_fill_stream()
+ */
+#define TRUERND_MAP_HUGEPAGE (1u << 0)  /* madvise(MADV_HUGEPAGE) the mapping */
+#define TRUERND_MAP_HUGETLB  (1u << 1)  /* Stream through a MAP_HUGETLB buffer if the system has one */
+#define TRUERND_MAP_SYNC     (1u << 2)  /* msync() each window before unmapping it */
+
+/**
+ * @brief Fill a range of a regular file with random bytes in place
+ * @param fd File descriptor open for reading and writing
+ * @param offset Byte offset of the range
+ * @param len Length of the range in bytes; the file grows to cover it
+ * @param flags TRUERND_MAP_* flags
+ * @return 0 on success, -1 on failure or where mmap() is unavailable
+ * @note The file is mapped TRUERND_FILE_WINDOW bytes at a time and filled
+ *       with non-temporal stores through an L1-sized buffer, so nothing is copied
+ *       through a heap buffer and the output does not displace the cache
+ */
+int 
+truernd_fill_file(int fd, uint64_t offset, uint64_t len, unsigned int flags);
+
+/**
+ * @brief Write random bytes to any descriptor, including pipes and sockets
+ * @param fd File descriptor open for writing
+ * @param len Bytes to write at the descriptor's current position
+ * @param flags TRUERND_MAP_* flags for the bounce buffer
+ * @return 0 on success, -1 on failure, including a write() that returns 0
+ * @note For descriptors that cannot be mapped: one TRUERND_STREAM_CHUNK
+ *       mapping is refilled and passed to write() until len bytes are out.
+ *       Non-blocking descriptors work too; a full one is waited on with poll()
+ */
+int 
+truernd_fill_stream(int fd, uint64_t len, unsigned int flags);
+
+/**
+ * @brief Replace the retry policy used by every retrying draw
+ * @param policy New policy, or NULL to restore the compile-time defaults
+ * @note Not synchronized: set it before other threads start drawing
+ */
+void 
+truernd_set_retry_policy(const truernd_retry_policy_t *policy);
+
+/**
+ * @brief Read the current retry policy
+ * @param[out] policy Pointer to store the policy
+ */
+void 
+truernd_get_retry_policy(truernd_retry_policy_t *policy);
+
+/**
+ * @brief Sum the per-thread counters without taking any lock
+ * @param[out] stats Pointer to store the totals
+ * @return 0 on success, -1 if stats is NULL or the library was built without TRUERND_STATS
+ * @note Each counter is read atomically but not all at the same instant, so
+ *       totals taken while other threads draw may be a few events apart
+ */
+int 
+truernd_stats_snapshot(truernd_stats_t *stats);
+
+/**
+ * @brief Returned by fills whose hardware output failed a health test
+ */
+#define TRUERND_ERR_HEALTH (-2)
+
+/**
+ * @brief Health tests, as passed to a truernd_health_fn
+ */
+#define TRUERND_HEALTH_RCT 1   /* Repetition count: two equal consecutive words */
+#define TRUERND_HEALTH_APT 2   /* Adaptive proportion: one byte value too common in a 512-byte window */
+
+/**
+ * @brief Called on the failing thread each time a block fails a health test
+ */
+typedef void (*truernd_health_fn)(int test, void *arg);
+
+/**
+ * @brief Install a callback for health test failures
+ * @param fn Callback, or NULL for none
+ * @param arg Passed through to fn
+ * @return 0 on success, -1 if the library was built without TRUERND_HEALTH
+ * @note Set it before other threads start drawing
+ */
+int 
+truernd_set_health_callback(truernd_health_fn fn, void *arg);
+
+/**
+ * @brief Count of blocks that failed a health test since startup
+ * @return Failures across all threads, 0 without TRUERND_HEALTH
+ */
+uint64_t 
+truernd_health_failures(void);
+
+/**
+ * @brief Fill a buffer from the operating system's CSPRNG
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @return 0 on success, -1 on failure or if no OS source is known
+ * @note getrandom() on Linux, BCryptGenRandom() on Windows, arc4random_buf() on Apple and BSD
+ */
+int 
+truernd_os_fill(void *buf, size_t len);
+
+/**
+ * @brief Check whether the kernel's CRNG has been seeded
+ * @return 1 if seeded, 0 if not yet, -1 if it cannot be told (not Linux, no getrandom)
+ */
+int 
+truernd_kernel_seeded(void);
+
+/**
+ * @brief Seed the Linux CRNG from the hardware RNG with batched RNDADDENTROPY calls
+ * @param batch Bytes submitted per ioctl, 0 for TRUERND_FEED_BATCH
+ * @param interval_ms Pause between batches in milliseconds
+ * @param max_batches Batches to submit before giving up, 0 for no limit
+ * @return 0 once the kernel reports itself seeded (or, where that cannot be
+ *         told, after the first batch), -1 on failure or if it is still
+ *         unseeded after max_batches
+ * @note Returns at once, submitting nothing, when the kernel is already
+ *       seeded. Each batch is one truernd_fill_backend(TRUERND_BACKEND_HW)
+ *       and one ioctl on /dev/random, credited at TRUERND_FEED_CREDIT bits per
+ *       byte. The hardware backend is used whatever truernd_fill() is bound
+ *       to, since the OS source would block on the very pool being fed.
+ *       RNDADDENTROPY needs CAP_SYS_ADMIN
+ */
+int 
+truernd_feed_kernel(size_t batch, unsigned int interval_ms, unsigned int max_batches);
+
+/**
+ * @brief Reset a pool to the empty state
+ * @param pool Pool to initialize
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_pool_init(truernd_pool_t *pool);
+
+/**
+ * @brief Refill the whole pool from the hardware in one bulk draw
+ * @param pool Pool to refill
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_pool_refill(truernd_pool_t *pool);
+
+/**
+ * @brief Choose how a pool refills
+ * @param pool Pool to configure
+ * @param mode TRUERND_POOL_SYNC, TRUERND_POOL_SLICED or TRUERND_POOL_ASYNC
+ * @return 0 on success, -1 on failure or if ASYNC is unavailable
+ * @note SLICED and ASYNC double-buffer the pool: once TRUERND_POOL_PREFETCH_AT
+ *       words are left, a shadow buffer is refilled either TRUERND_POOL_SLICE_WORDS
+ *       per draw or on a shared helper thread, and an empty pool swaps buffers by
+ *       pointer. Switch an ASYNC pool back to SYNC before freeing it; the
+ *       thread-local pool does this itself at thread exit
+ */
+int 
+truernd_pool_set_mode(truernd_pool_t *pool, int mode);
+
+/**
+ * @brief Get the calling thread's own pool
+ * @return Pointer to the thread-local pool, never NULL
+ */
+static inline truernd_pool_t *
+truernd_pool_local(void);
+
+/**
+ * @brief Take a 32-bit random number from a pool, refilling it when empty
+ * @param pool Pool to draw from
+ * @param[out] out Pointer to store the random number
+ * @note Each 64-bit word serves two consecutive 32-bit draws
+ * @return 0 on success, -1 on failure
+ */
+static inline int 
+truernd_pool_get32(truernd_pool_t *pool, uint32_t *out);
+
+/**
+ * @brief Take a 64-bit random number from a pool, refilling it when empty
+ * @param pool Pool to draw from
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ */
+static inline int 
+truernd_pool_get64(truernd_pool_t *pool, uint64_t *out);
+
+/**
+ * @brief Take a 16-bit random number from a pool
+ * @param pool Pool to draw from
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ * @note Shares the split word with truernd_pool_get32(): four per word
+ */
+static inline int 
+truernd_pool_get16(truernd_pool_t *pool, uint16_t *out);
+
+/**
+ * @brief Take an 8-bit random number from a pool
+ * @param pool Pool to draw from
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ * @note Shares the split word with truernd_pool_get32(): eight per word
+ */
+static inline int 
+truernd_pool_get8(truernd_pool_t *pool, uint8_t *out);
+
+/**
+ * @brief Drop every buffered random value in the process
+ * @note Pools, DRBGs, split getters, ring slots and the C++ engines discard
+ *       what they hold on their next draw, from any thread. A fork child
+ *       does this by itself through pthread_atfork(); call it after a VM
+ *       snapshot is restored, since userspace gets no generation counter
+ *       for that
+ */
+void 
+truernd_invalidate_all(void);
+
+/**
+ * @brief Have the kernel zero pages of caller memory in fork children
+ * @param mem Page-aligned start, e.g. of a heap-allocated pool
+ * @param len Length in bytes
+ * @return 0 on success, -1 if unaligned or MADV_WIPEONFORK is unavailable
+ * @note A zeroed pool is a valid empty pool, so this closes the window
+ *       before the child's first draw; truernd_invalidate_all() still covers
+ *       everything else
+ */
+int 
+truernd_wipe_on_fork(void *mem, size_t len);
+
+/**
+ * @brief Set up a ring over caller-provided slots
+ * @param ring Ring to initialize
+ * @param slots Slot array, cache-line aligned
+ * @param nslots Slot count, a power of two no smaller than 2
+ * @param chunk Bytes per draw, 8, 16 or 32
+ * @return 0 on success, -1 on failure
+ * @note The ring starts empty with the low watermark at a quarter of its size.
+ *       The producer fills only chunk bytes of each slot, so no backend
+ *       output is thrown away; takes of another size need a ring of their own
+ */
+int 
+truernd_ring_init(truernd_ring_t *ring, truernd_ring_slot_t *slots, size_t nslots,
+                  size_t chunk);
+
+/**
+ * @brief Set the low watermark and the callback fired when a draw reaches it
+ * @param ring Ring to configure
+ * @param low_watermark Filled slot count at or below which the callback fires
+ * @param on_low Callback, or NULL for none
+ * @param arg Passed through to the callback
+ * @return 0 on success, -1 on failure
+ * @note The callback fires once per drain and is re-armed by the next produce
+ */
+int 
+truernd_ring_set_low_watermark(truernd_ring_t *ring, size_t low_watermark,
+                               truernd_ring_low_fn on_low, void *arg);
+
+/**
+ * @brief Fill free slots from the bound backend, TRUERND_RING_BATCH at a time
+ * @param ring Ring to fill
+ * @param max_slots Most slots to produce
+ * @return Slots produced, 0 if the ring is full or the fill failed
+ * @note Only one thread may produce into a ring at a time
+ */
+size_t 
+truernd_ring_produce(truernd_ring_t *ring, size_t max_slots);
+
+/**
+ * @brief Filled slots waiting for consumers
+ * @param ring Ring to inspect
+ * @return Slot count, approximate while consumers or the producer are active
+ */
+size_t 
+truernd_ring_level(const truernd_ring_t *ring);
+
+/**
+ * @brief Take one chunk from a ring
+ * @param ring Ring to draw from
+ * @param[out] out Buffer to store the chunk
+ * @param len Chunk size, the one the ring was set up with
+ * @return 0 on success, -1 on failure
+ * @note One atomic fetch-add claims a slot; if the producer has not reached it,
+ *       the chunk comes straight from truernd_fill() instead of waiting
+ */
+static inline int 
+truernd_ring_get(truernd_ring_t *ring, void *out, size_t len);
+
+/**
+ * @brief Start a background thread that keeps a ring full
+ * @param ring Ring to produce into; nothing else may produce while it runs
+ * @return 0 on success, -1 on failure or without pthreads
+ * @note The thread sleeps while the ring is full and wakes at the low watermark.
+ *       Like any thread it does not survive fork(): a child still draws
+ *       fresh output from the ring, but must not stop or restart its
+ *       parent's producer
+ */
+int 
+truernd_ring_start(truernd_ring_t *ring);
+
+/**
+ * @brief Stop and join the background producer started by truernd_ring_start()
+ * @param ring Ring whose producer to stop
+ * @note Call once consumers have stopped drawing from the ring
+ */
+void 
+truernd_ring_stop(truernd_ring_t *ring);
+
+/**
+ * @brief Number of NUMA nodes, from the highest online node id
+ * @return Node count, 1 on non-NUMA systems or outside Linux, at most TRUERND_MAX_NODES
+ */
+unsigned int 
+truernd_numa_nodes(void);
+
+/**
+ * @brief NUMA node of the CPU the calling thread runs on
+ * @return Node id, 0 when unknown
+ * @note getcpu() is asked once every TRUERND_NODE_RECHECK calls and the answer
+ *       cached thread-locally, so a migrated thread follows within that many
+ *       draws and the common case is a TLS decrement
+ */
+static inline unsigned int 
+truernd_numa_node(void);
+
+/**
+ * @brief Set up one ring per NUMA node
+ * @param group Group to initialize
+ * @param nslots Slots per ring, a power of two no smaller than 2
+ * @param chunk Bytes per draw, 8, 16 or 32, see truernd_ring_init()
+ * @return 0 on success, -1 on failure or without mmap
+ * @note Each ring and its slots are mapped together and bound to their node
+ *       with mbind(MPOL_PREFERRED) before first touch, so consumers and the
+ *       node's producer never pull slot lines across the interconnect
+ */
+int 
+truernd_ring_group_init(truernd_ring_group_t *group, size_t nslots, size_t chunk);
+
+/**
+ * @brief Take one chunk from the calling thread's node-local ring
+ * @param group Group to draw from
+ * @param[out] out Buffer to store the chunk
+ * @param len Chunk size, the one the group was set up with
+ * @return 0 on success, -1 on failure
+ */
+static inline int 
+truernd_ring_group_get(truernd_ring_group_t *group, void *out, size_t len);
+
+/**
+ * @brief Start one producer per node, each pinned to its node's CPUs
+ * @param group Group to produce into
+ * @return 0 on success, -1 on failure; producers already started keep running
+ */
+int 
+truernd_ring_group_start(truernd_ring_group_t *group);
+
+/**
+ * @brief Stop the producers, then wipe and unmap every ring
+ * @param group Group to tear down; it is zeroed afterwards
+ */
+void 
+truernd_ring_group_free(truernd_ring_group_t *group);
+
+/**
+ * @brief Build a context inside caller-provided storage
+ * @param mem Buffer of at least TRUERND_CTX_SIZE bytes, any alignment
+ * @param size Size of mem in bytes
+ * @return The context, cache-line aligned within mem, or NULL if mem is too small
+ */
+truernd_ctx_t *
+truernd_ctx_init(void *mem, size_t size);
+
+/**
+ * @brief Take a 64-bit random number from a context's pool
+ * @param ctx Context to draw from
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ */
+static inline int 
+truernd_ctx_get64(truernd_ctx_t *ctx, uint64_t *out);
+
+/**
+ * @brief Take a 32-bit random number from a context's pool
+ * @param ctx Context to draw from
+ * @param[out] out Pointer to store the random number
+ * @return 0 on success, -1 on failure
+ */
+static inline int 
+truernd_ctx_get32(truernd_ctx_t *ctx, uint32_t *out);
+
+/**
+ * @brief Fill a buffer from a context's DRBG
+ * @param ctx Context to draw from
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @return 0 on success, -1 on failure
+ * @note The DRBG is seeded from RDSEED / RNDRRS on first use, with AES-256-CTR
+ *       where AES instructions exist and ChaCha20 elsewhere
+ */
+int 
+truernd_ctx_fill(truernd_ctx_t *ctx, void *buf, size_t len);
+
+/**
+ * @brief Wipe a context; its storage can be reused or freed afterwards
+ * @param ctx Context to destroy
+ * @note Every truernd_ctx_* draw on a destroyed context fails with -1
+ */
+void 
+truernd_ctx_destroy(truernd_ctx_t *ctx);
+
+/**
+ * @brief Claim a context from the static arena
+ * @return A fresh context, or NULL if all TRUERND_STATIC_ARENA are taken
+ * @note With TRUERND_STATIC_ARENA > 0, ring producers also come from a
+ *       static table of that size, so the library never calls malloc
+ */
+truernd_ctx_t *
+truernd_ctx_acquire(void);
+
+/**
+ * @brief Wipe a context and return it to the static arena
+ * @param ctx Context from truernd_ctx_acquire()
+ */
+void 
+truernd_ctx_release(truernd_ctx_t *ctx);
+
+/**
+ * @brief Unbiased random number in [0, bound) from the thread-local pool
+ * @param bound Exclusive upper bound
+ * @return The random value, 0 if bound is 0 or on failure
+ * @note Lemire's multiply-shift; the rejection loop runs with probability below bound / 2^32
+ */
+static inline uint32_t 
+truernd_uniform_u32(uint32_t bound);
+
+/**
+ * @brief Unbiased random number in [0, bound) from the thread-local pool
+ * @param bound Exclusive upper bound
+ * @return The random value, 0 if bound is 0 or on failure
+ * @note Lemire's multiply-shift; the rejection loop runs with probability below bound / 2^64
+ */
+static inline uint64_t 
+truernd_uniform_u64(uint64_t bound);
+
+/**
+ * @brief Uniform double in [0, 1) with 53 random mantissa bits
+ * @return The random value, 0.0 on failure
+ */
+static inline double 
+truernd_double01(void);
+
+/**
+ * @brief Uniform float in [0, 1) with 24 random mantissa bits
+ * @return The random value, 0.0f on failure
+ */
+static inline float 
+truernd_float01(void);
+
+/**
+ * @brief Fill an array with unbiased random numbers in [0, bound)
+ * @param[out] out Array to fill
+ * @param n Number of elements
+ * @param bound Exclusive upper bound, must be non-zero
+ * @return 0 on success, -1 on failure
+ * @note Raw words are filled in bulk, reduced in place with AVX-512, AVX2 or
+ *       NEON, and the rare rejected lanes are redrawn in a second pass
+ */
+int 
+truernd_fill_u32_bounded(uint32_t *out, size_t n, uint32_t bound);
+
+/**
+ * @brief Fill an array with uniform doubles in [0, 1), 53 random mantissa bits each
+ * @param[out] out Array to fill
+ * @param n Number of elements
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_fill_double(double *out, size_t n);
+
+/**
+ * @brief Fill an array with uniform floats in [0, 1), 24 random mantissa bits each
+ * @param[out] out Array to fill
+ * @param n Number of elements
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_fill_float(float *out, size_t n);
+
+/**
+ * @brief Buffer sizes for the identifier functions, including the NUL
+ */
+#define TRUERND_UUID_STR_LEN 37
+#define TRUERND_B64URL_LEN(nbytes) ((((nbytes) * 4 + 2) / 3) + 1)
+
+/**
+ * @brief Generate an RFC 9562 version 4 UUID in binary form
+ * @param[out] out 16 bytes, in network byte order
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_uuid4(uint8_t out[16]);
+
+/**
+ * @brief Generate a version 4 UUID as a lowercase string
+ * @param[out] out TRUERND_UUID_STR_LEN bytes: 8-4-4-4-12 hex digits and a NUL
+ * @return 0 on success, -1 on failure
+ * @note Drawn from the thread-local pool and hex-encoded with SSSE3 or NEON
+ *       table lookups where available
+ */
+int 
+truernd_uuid4_str(char out[TRUERND_UUID_STR_LEN]);
+
+/**
+ * @brief Generate a random token encoded as unpadded base64url (RFC 4648 section 5)
+ * @param[out] out TRUERND_B64URL_LEN(nbytes) bytes for the text and its NUL
+ * @param nbytes Random bytes in the token
+ * @return 0 on success, -1 on failure
+ * @note Encodes 12 bytes per SSSE3 step or 48 per NEON step; the raw bytes
+ *       never leave a stack buffer that is wiped afterwards
+ */
+int 
+truernd_token_b64url(char *out, size_t nbytes);
+
+/**
+ * @brief Seed a DRBG from the hardware seed source
+ * @param drbg DRBG to initialize
+ * @param reseed_interval Output bytes between reseeds, 0 for TRUERND_DRBG_RESEED_BYTES
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_drbg_init(truernd_drbg_t *drbg, uint64_t reseed_interval);
+
+/**
+ * @brief Seed a DRBG for a given cipher
+ * @param drbg DRBG to initialize
+ * @param reseed_interval Output bytes between reseeds, 0 for TRUERND_DRBG_RESEED_BYTES
+ * @param cipher TRUERND_DRBG_CHACHA20 or TRUERND_DRBG_AES256
+ * @return 0 on success, -1 on failure or if the cipher has no hardware support
+ */
+int 
+truernd_drbg_init_ex(truernd_drbg_t *drbg, uint64_t reseed_interval, int cipher);
+
+/**
+ * @brief Mix fresh hardware seed material into a DRBG
+ * @param drbg DRBG to reseed
+ * @return 0 on success, -1 on failure
+ */
+int 
+truernd_drbg_reseed(truernd_drbg_t *drbg);
+
+/**
+ * @brief Fill a buffer with DRBG output, reseeding as configured
+ * @param drbg Initialized DRBG
+ * @param buf Buffer to fill
+ * @param len Length of buffer in bytes
+ * @return 0 on success, -1 on failure
+ * @note The key is replaced after every call, so earlier output cannot be
+ *       recovered from a later state
+ */
+int 
+truernd_drbg_fill(truernd_drbg_t *drbg, void *buf, size_t len);
+
+/** @}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TRUERANDOM_H */
+
+#ifdef TRUERANDOM_IMPLEMENTATION
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Intel/AMD x86/x64 implementation using RDRAND */
+#if defined(truernd_ARCH_X86)
+
+#include <cpuid.h>
+#ifndef bit_SHA
+#define bit_SHA (1 << 29)
+#endif
+
+/* Register state the OS saves on context switch, from XCR0 */
+static inline uint64_t
+truernd__xgetbv(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static unsigned int 
+truernd__probe(void) {
+    unsigned int eax, ebx, ecx, edx, caps = 0;
+    uint64_t xcr0 = 0;
+
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        if (ecx & bit_RDRND) caps |= TRUERND_CAP_RDRAND;
+        if (ecx & bit_AES)   caps |= TRUERND_CAP_AES;
+        if (ecx & bit_SSSE3) caps |= TRUERND_CAP_SSSE3;
+        if (ecx & bit_OSXSAVE) xcr0 = truernd__xgetbv();
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+        if (ebx & bit_RDSEED) caps |= TRUERND_CAP_RDSEED;
+        if (ebx & bit_SHA)    caps |= TRUERND_CAP_SHA2;
+        /* Vector units only count when the OS saves their registers */
+        if ((ebx & bit_AVX2) && (xcr0 & 0x06) == 0x06) caps |= TRUERND_CAP_AVX2;
+        if ((ebx & bit_AVX512F) && (xcr0 & 0xE6) == 0xE6) caps |= TRUERND_CAP_AVX512;
+    }
+    return caps;
+}
+
+static inline int 
+truernd__seed64(uint64_t *out) {
+#if defined(__x86_64__)
+    unsigned char ok;
+    __asm__ volatile(
+        "rdseed %0              \n\t"
+        "setc   %1              \n\t"
+        : "=r"(*out), "=qm"(ok)
+        :
+        : "cc"
+    );
+    return ok ? 0 : -1;
+#else
+    (void)out;
+    return -1;
+#endif
+}
+
+NAKED uint32_t 
+(truernd_gen32)(void) {
+    __asm__ volatile(
+        "rdrand %eax       \n\t"
+        "jnc    1f         \n\t"
+        "ret               \n\t"
+
+        "1:                \n\t"
+        "xor    %eax, %eax \n\t"
+        "ret               \n\t"
+    );
+}
+
+NAKED uint64_t 
+(truernd_gen64)(void) {
+    __asm__ volatile(
+        "rdrand %rax            \n\t"
+        "jnc    1f              \n\t"
+        "ret                    \n\t"
+    "1:                         \n\t"
+        "xor    %rax, %rax      \n\t"
+        "ret                    \n\t"
+    );
+}
+
+NAKED int 
+(truernd_get32)(uint32_t *) {
+    __asm__ volatile(
+        "test   %rdi, %rdi      \n\t"
+        "jz     1f              \n\t"
+
+        "rdrand %ecx            \n\t"
+        "jnc    1f              \n\t"
+
+        "movl   %ecx, (%rdi)    \n\t"
+        "xor    %eax, %eax      \n\t"
+        "ret                    \n\t"
+    "1:                         \n\t"
+        "mov    $-1, %eax       \n\t"
+        "ret                    \n\t"
+    );
+}
+
+NAKED int 
+(truernd_get64)(uint64_t *) {
+    __asm__ volatile(
+        "test   %rdi, %rdi         \n\t"
+        "jz     1f                 \n\t"
+
+        "rdrand %rcx               \n\t"
+        "jnc    1f                 \n\t"
+
+        "movq   %rcx, (%rdi)       \n\t"
+        "xor    %eax, %eax         \n\t"
+        "ret                       \n\t"
+    "1:                            \n\t"
+        "mov    $-1, %eax          \n\t"
+        "ret                       \n\t"
+    );
+}
+
+/* ARM implementation using RNDR */
+#elif defined(truernd_ARCH_ARM)
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+
+#if defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMD
+#define HWCAP_ASIMD (1 << 1)
+#endif
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#ifndef HWCAP2_RNG
+#define HWCAP2_RNG (1 << 16)
+#endif
+#endif
+
+static unsigned int 
+truernd__probe(void) {
+    unsigned int caps = 0;
+
+#if defined(__linux__)
+    /* The kernel's hwcaps avoid trapping on the ID register read */
+    unsigned long hwcap = getauxval(AT_HWCAP), hwcap2 = getauxval(AT_HWCAP2);
+    int rng = (hwcap2 & HWCAP2_RNG) != 0;
+    if (hwcap & HWCAP_ASIMD) caps |= TRUERND_CAP_NEON;
+    if (hwcap & HWCAP_AES)   caps |= TRUERND_CAP_AES;
+    if (hwcap & HWCAP_SHA2)  caps |= TRUERND_CAP_SHA2;
+#else
+    uint64_t isar0;
+    __asm__ volatile("mrs %0, ID_AA64ISAR0_EL1" : "=r"(isar0));
+    int rng = ((isar0 >> 60) & 0xF) != 0;
+    if (((isar0 >> 4) & 0xF) != 0) caps |= TRUERND_CAP_AES;
+    if (((isar0 >> 12) & 0xF) != 0) caps |= TRUERND_CAP_SHA2;
+    caps |= TRUERND_CAP_NEON;  /* Mandatory in AArch64 */
+#endif
+
+    /* RNDRRS is part of FEAT_RNG, so it is present exactly when RNDR is */
+    if (rng) caps |= TRUERND_CAP_RNDR | TRUERND_CAP_RNDRRS;
+    return caps;
+}
+
+static inline int 
+truernd__seed64(uint64_t *out) {
+    uint32_t ok;
+    __asm__ volatile(
+        "mrs  %0, RNDRRS          \n\t"
+        "cset %w1, ne             \n\t"
+        : "=r"(*out), "=r"(ok)
+        :
+        : "cc"
+    );
+    return ok ? 0 : -1;
+}
+
+NAKED uint32_t 
+(truernd_gen32)(void) {
+    __asm__ volatile(
+        "mrs x0, RNDR             \n\t"
+        "b.eq 1f                  \n\t"
+        "ret                      \n\t"
+    "1:                           \n\t"
+        "mov w0, #0               \n\t"
+        "ret                      \n\t"
+    );
+}
+
+NAKED uint64_t 
+(truernd_gen64)(void) {
+    __asm__ volatile(
+        "mrs x0, RNDR             \n\t"
+        "b.eq 1f                  \n\t"
+        "ret                      \n\t"
+    "1:                           \n\t"
+        "mov x0, #0               \n\t"
+        "ret                      \n\t"
+    );
+}
+
+NAKED int 
+(truernd_get32)(uint32_t *out) {
+    __asm__ volatile(
+        "cbz x0, 1f               \n\t"
+
+        "mrs x1, RNDR             \n\t"
+        "b.eq 1f                  \n\t"
+
+        "str w1, [x0]             \n\t"
+        "mov w0, #0               \n\t"
+        "ret                      \n\t"
+    "1:                           \n\t"
+        "mov w0, #-1              \n\t"
+        "ret                      \n\t"
+    );
+}
+
+NAKED int 
+(truernd_get64)(uint64_t *out) {
+    __asm__ volatile(
+        "cbz x0, 1f               \n\t"
+
+        "mrs x1, RNDR             \n\t"
+        "b.eq 1f                  \n\t"
+
+        "str x1, [x0]             \n\t"
+        "mov w0, #0               \n\t"
+        "ret                      \n\t"
+    "1:                           \n\t"
+        "mov w0, #-1              \n\t"
+        "ret                      \n\t"
+    );
+}
+
+#else /* 32-bit ARM - RNDR not available */
+
+static unsigned int 
+truernd__probe(void) {
+    return 0;
+}
+
+static inline int 
+truernd__seed64(uint64_t *out) {
+    (void)out;
+    return -1;
+}
+
+NAKED int 
+(truernd_get32)(uint32_t *out) {
+    __asm__ volatile(
+        "mov r0, #-1              \n\t"
+        "bx lr                    \n\t"
+    );
+}
+
+NAKED int 
+(truernd_get64)(uint64_t *out) {
+    __asm__ volatile(
+        "mov r0, #-1              \n\t"
+        "bx lr                    \n\t"
+    );
+}
+
+NAKED uint32_t 
+(truernd_gen32)(void) {
+    __asm__ volatile(
+        "mov r0, #0               \n\t"
+        "bx lr                    \n\t"
+    );
+}
+
+NAKED  uint64_t 
+(truernd_gen64)(void) {
+    __asm__ volatile(
+        "mov r0, #0               \n\t"
+        "mov r1, #0               \n\t"
+        "bx lr                    \n\t"
+    );
+}
+
+#endif /* __aarch64__ */
+
+/* Unsupported architecture */
+#else
+
+static unsigned int 
+truernd__probe(void) {
+    return 0;
+}
+
+static inline int 
+truernd__seed64(uint64_t *out) {
+    (void)out;
+    return -1;
+}
+
+int 
+(truernd_get32)(uint32_t *out) {
+    (void)out;
+    return -1;
+}
+
+int 
+(truernd_get64)(uint64_t *out) {
+    (void)out;
+    return -1;
+}
+
+uint32_t 
+(truernd_gen32)(void) {
+    return 0;
+}
+
+uint64_t 
+(truernd_gen64)(void) {
+    return 0;
+}
+
+#endif /* Architecture selection */
+
+/*
+ * Cached capability detection
+ */
+
+#if defined(__GNUC__) || defined(__clang__)
+    #define TRUERND__LOAD_RELAXED(p)     __atomic_load_n(p, __ATOMIC_RELAXED)
+    #define TRUERND__STORE_RELAXED(p, v) __atomic_store_n(p, v, __ATOMIC_RELAXED)
+#else
+    #define TRUERND__LOAD_RELAXED(p)     (*(volatile __typeof__(*(p)) *)(p))
+    #define TRUERND__STORE_RELAXED(p, v) (*(volatile __typeof__(*(p)) *)(p) = (v))
+#endif
+
+/* Set in the cache once probed, so 0 means "not probed yet" */
+#define TRUERND__CAP_PROBED (1u << 31)
+
+static unsigned int truernd__caps;
+
+/* Racing first callers all store the same value, so no once-guard is needed */
+static unsigned int
+truernd__caps_probe(void) {
+    unsigned int caps = truernd__probe() | TRUERND__CAP_PROBED;
+    TRUERND__STORE_RELAXED(&truernd__caps, caps);
+    return caps;
+}
+
+static inline unsigned int 
+truernd_capabilities(void) {
+    unsigned int caps = TRUERND__LOAD_RELAXED(&truernd__caps);
+    if (caps == 0) caps = truernd__caps_probe();
+    return caps & ~TRUERND__CAP_PROBED;
+}
+
+#if defined(TRUERND_PROBE_AT_STARTUP) && (defined(__GNUC__) || defined(__clang__))
+__attribute__((constructor)) static void
+truernd__caps_init(void) {
+    truernd__caps_probe();
+}
+#endif
+
+int 
+truernd_is_supported(void) {
+    return (truernd_capabilities() & (TRUERND_CAP_RDRAND | TRUERND_CAP_RNDR)) ? 1 : 0;
+}
+
+int 
+truernd_seed_is_supported(void) {
+    return (truernd_capabilities() & (TRUERND_CAP_RDSEED | TRUERND_CAP_RNDRRS)) ? 1 : 0;
+}
+
+/*
+ * Instrumentation counters
+ *
+ * Each thread claims a cache-line slot on its first event and is its only
+ * writer, so updates are plain relaxed stores. Threads past the slot count
+ * share the last slot through atomic adds. Slots are never released, which
+ * keeps the totals monotonic across thread exit.
+ */
+
+#include <string.h>
+
+/* Cheapest monotonic counter the core offers */
+static inline uint64_t
+truernd__ticks(void) {
+#if defined(truernd_ARCH_X86)
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+#elif defined(__aarch64__)
+    uint64_t v;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+    return v;
+#else
+    return 0;
+#endif
+}
+
+#if TRUERND_STATS
+
+typedef struct truernd__stats_slot {
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint64_t draws;
+    uint64_t underflows;
+    uint64_t retries;
+    uint64_t max_retry_streak;
+    uint64_t failures;
+    uint64_t bytes;
+    uint64_t cycles;
+} truernd__stats_slot;
+
+static truernd__stats_slot truernd__stats_slots[TRUERND_STATS_SLOTS];
+static unsigned int truernd__stats_claimed;
+static TRUERND_TLS truernd__stats_slot *truernd__stats_mine;
+
+#define TRUERND__STATS_SHARED (&truernd__stats_slots[TRUERND_STATS_SLOTS - 1])
+
+static inline truernd__stats_slot *
+truernd__stats_self(void) {
+    truernd__stats_slot *slot = truernd__stats_mine;
+    if (!slot) {
+        unsigned int i = __atomic_fetch_add(&truernd__stats_claimed, 1, __ATOMIC_RELAXED);
+        slot = i < TRUERND_STATS_SLOTS - 1 ? &truernd__stats_slots[i] : TRUERND__STATS_SHARED;
+        truernd__stats_mine = slot;
+    }
+    return slot;
+}
+
+static inline void
+truernd__stats_add(truernd__stats_slot *slot, uint64_t *field, uint64_t n) {
+    if (slot == TRUERND__STATS_SHARED) __atomic_fetch_add(field, n, __ATOMIC_RELAXED);
+    else TRUERND__STORE_RELAXED(field, TRUERND__LOAD_RELAXED(field) + n);
+}
+
+static inline void
+truernd__stats_max(truernd__stats_slot *slot, uint64_t *field, uint64_t v) {
+    uint64_t cur = TRUERND__LOAD_RELAXED(field);
+    if (slot != TRUERND__STATS_SHARED) {
+        if (v > cur) TRUERND__STORE_RELAXED(field, v);
+        return;
+    }
+    while (v > cur && !__atomic_compare_exchange_n(field, &cur, v, 1,
+                                                   __ATOMIC_RELAXED, __ATOMIC_RELAXED)) { }
+}
+
+#define TRUERND__STAT_ADD(field, n) do { \
+    truernd__stats_slot *s_ = truernd__stats_self(); \
+    truernd__stats_add(s_, &s_->field, (uint64_t)(n)); \
+} while (0)
+
+#define TRUERND__STAT_MAX(field, v) do { \
+    truernd__stats_slot *s_ = truernd__stats_self(); \
+    truernd__stats_max(s_, &s_->field, (uint64_t)(v)); \
+} while (0)
+
+int 
+truernd_stats_snapshot(truernd_stats_t *stats) {
+    if (!stats) return -1;
+    memset(stats, 0, sizeof(*stats));
+
+    unsigned int claimed = TRUERND__LOAD_RELAXED(&truernd__stats_claimed);
+    stats->threads = claimed;
+    if (claimed > TRUERND_STATS_SLOTS - 1) claimed = TRUERND_STATS_SLOTS;
+    for (unsigned int i = 0; i < claimed; i++) {
+        truernd__stats_slot *slot = &truernd__stats_slots[i];
+        uint64_t streak = TRUERND__LOAD_RELAXED(&slot->max_retry_streak);
+        stats->draws      += TRUERND__LOAD_RELAXED(&slot->draws);
+        stats->underflows += TRUERND__LOAD_RELAXED(&slot->underflows);
+        stats->retries    += TRUERND__LOAD_RELAXED(&slot->retries);
+        stats->failures   += TRUERND__LOAD_RELAXED(&slot->failures);
+        stats->bytes      += TRUERND__LOAD_RELAXED(&slot->bytes);
+        stats->cycles     += TRUERND__LOAD_RELAXED(&slot->cycles);
+        if (streak > stats->max_retry_streak) stats->max_retry_streak = streak;
+    }
+    return 0;
+}
+
+#else
+
+#define TRUERND__STAT_ADD(field, n) ((void)0)
+#define TRUERND__STAT_MAX(field, v) ((void)0)
+
+int 
+truernd_stats_snapshot(truernd_stats_t *stats) {
+    if (stats) memset(stats, 0, sizeof(*stats));
+    return -1;
+}
+
+#endif /* TRUERND_STATS */
+
+/*
+ * Retry policy
+ */
+
+#if defined(__linux__)
+#include <errno.h>
+#include <sys/random.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <bcrypt.h>
+#if defined(_MSC_VER)
+#pragma comment(lib, "bcrypt")
+#endif
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+#include <stdlib.h>
+#endif
+
+static truernd_retry_policy_t truernd__retry_policy = {
+    TRUERND_MAX_RETRIES,
+    TRUERND_SEED_RETRIES,
+    TRUERND_BACKOFF_MIN,
+    TRUERND_BACKOFF_MAX,
+    TRUERND_OS_FALLBACK
+};
+
+void 
+truernd_set_retry_policy(const truernd_retry_policy_t *policy) {
+    static const truernd_retry_policy_t defaults = {
+        TRUERND_MAX_RETRIES,
+        TRUERND_SEED_RETRIES,
+        TRUERND_BACKOFF_MIN,
+        TRUERND_BACKOFF_MAX,
+        TRUERND_OS_FALLBACK
+    };
+    truernd__retry_policy = policy ? *policy : defaults;
+}
+
+void 
+truernd_get_retry_policy(truernd_retry_policy_t *policy) {
+    if (policy) *policy = truernd__retry_policy;
+}
+
+int 
+truernd_os_fill(void *buf, size_t len) {
+    if (!buf || len == 0) return -1;
+
+#if defined(__linux__)
+    uint8_t *ptr = (uint8_t*)buf;
+    while (len > 0) {
+        ssize_t n = getrandom(ptr, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        ptr += n;
+        len -= (size_t)n;
+    }
+    return 0;
+#elif defined(_WIN32)
+    uint8_t *ptr = (uint8_t*)buf;
+    while (len > 0) {
+        ULONG n = len > 0x7FFFFFFF ? 0x7FFFFFFF : (ULONG)len;
+        if (BCryptGenRandom(NULL, ptr, n, BCRYPT_USE_SYSTEM_PREFERRED_RNG) != 0) return -1;
+        ptr += n;
+        len -= n;
+    }
+    return 0;
+#elif defined(__APPLE__) || defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+    arc4random_buf(buf, len);
+    return 0;
+#else
+    return -1;
+#endif
+}
+
+/* Spin-wait hint that leaves the DRNG alone and yields the core to its sibling */
+static inline void
+truernd__cpu_relax(uint32_t spins) {
+    while (spins--) {
+#if defined(truernd_ARCH_X86)
+        __asm__ volatile("pause" ::: "memory");
+#elif defined(__aarch64__)
+        __asm__ volatile("yield" ::: "memory");
+#endif
+    }
+}
+
+/* Retry a failed draw under the current policy, with bounded exponential backoff */
+static int
+truernd__retry64(int (*draw)(uint64_t *), int attempts, uint64_t *out) {
+    uint32_t spins = truernd__retry_policy.backoff_min;
+    uint32_t cap = truernd__retry_policy.backoff_max;
+
+    for (int i = 1; i < attempts; i++) {
+        truernd__cpu_relax(spins);
+        spins = spins > cap / 2 ? cap : spins * 2;
+        TRUERND__STAT_ADD(draws, 1);
+        TRUERND__STAT_ADD(retries, 1);
+        if (draw(out) == 0) {
+            TRUERND__STAT_MAX(max_retry_streak, i);
+            return 0;
+        }
+        TRUERND__STAT_ADD(underflows, 1);
+    }
+
+    TRUERND__STAT_MAX(max_retry_streak, attempts > 1 ? attempts - 1 : 0);
+    TRUERND__STAT_ADD(failures, 1);
+    if (truernd__retry_policy.os_fallback) return truernd_os_fill(out, sizeof(*out));
+    return -1;
+}
+
+/* Single 64-bit draw under the retry policy */
+static inline int
+truernd__draw64(uint64_t *out) {
+    TRUERND__STAT_ADD(draws, 1);
+    if (truernd_get64(out) == 0) return 0;
+    TRUERND__STAT_ADD(underflows, 1);
+    return truernd__retry64(truernd_get64, truernd__retry_policy.max_retries, out);
+}
+
+/*
+ * Online health tests
+ *
+ * SP 800-90B's repetition count and adaptive proportion tests, run on every
+ * block the hardware kernel produces. Samples are whole 64-bit words for
+ * the RCT (cutoff 2, so any repeat fails) and bytes for the APT, both sized
+ * for a false alarm rate of 2^-40 at 8 bits of entropy per byte. Windows
+ * carry over between blocks per thread, and each block is scanned with
+ * vector compares rather than sample by sample.
+ */
+
+#if defined(truernd_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define TRUERND__HAVE_X86_SIMD 1
+#else
+#define TRUERND__HAVE_X86_SIMD 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TRUERND__HAVE_NEON 1
+#else
+#define TRUERND__HAVE_NEON 0
+#endif
+
+#if TRUERND_HEALTH
+
+#define TRUERND__APT_WINDOW 512
+
+typedef struct truernd__health_state {
+    uint64_t last;          /* Last word of the previous block, for the RCT */
+    uint32_t apt_seen;      /* Samples of the current window so far, 0 to start one */
+    uint32_t apt_count;     /* Samples equal to the window's first */
+    uint8_t  apt_ref;       /* The window's first sample */
+    uint8_t  have_last;
+} truernd__health_state;
+
+static TRUERND_TLS truernd__health_state truernd__health;
+static truernd_health_fn truernd__health_cb;
+static void *truernd__health_arg;
+static uint64_t truernd__health_failed;
+
+int 
+truernd_set_health_callback(truernd_health_fn fn, void *arg) {
+    truernd__health_arg = arg;
+    truernd__health_cb = fn;
+    return 0;
+}
+
+uint64_t 
+truernd_health_failures(void) {
+    return __atomic_load_n(&truernd__health_failed, __ATOMIC_RELAXED);
+}
+
+#if TRUERND__HAVE_X86_SIMD
+
+/* Per-lane byte counts cannot wrap: a call covers at most one window */
+__attribute__((target("avx2"))) static size_t
+truernd__count_eq_avx2(const uint8_t *p, size_t n, uint8_t ref, size_t *done) {
+    const __m256i r = _mm256_set1_epi8((char)ref);
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(const void*)(p + i));
+        acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, r));
+    }
+    __m256i sad = _mm256_sad_epu8(acc, _mm256_setzero_si256());
+    __m128i sum = _mm_add_epi64(_mm256_castsi256_si128(sad), _mm256_extracti128_si256(sad, 1));
+    sum = _mm_add_epi64(sum, _mm_unpackhi_epi64(sum, sum));
+    *done = i;
+    return (size_t)_mm_cvtsi128_si32(sum);
+}
+
+/* Non-zero if two consecutive words of x[0..n) match */
+__attribute__((target("avx2"))) static int
+truernd__has_repeat_avx2(const uint64_t *x, size_t n, size_t *done) {
+    __m256i acc = _mm256_setzero_si256();
+    size_t i = 0;
+    for (; i + 5 <= n; i += 4) {
+        __m256i a = _mm256_loadu_si256((const __m256i*)(const void*)(x + i));
+        __m256i b = _mm256_loadu_si256((const __m256i*)(const void*)(x + i + 1));
+        acc = _mm256_or_si256(acc, _mm256_cmpeq_epi64(a, b));
+    }
+    *done = i;
+    return !_mm256_testz_si256(acc, acc);
+}
+
+#endif /* TRUERND__HAVE_X86_SIMD */
+
+#if TRUERND__HAVE_NEON
+
+static size_t
+truernd__count_eq_neon(const uint8_t *p, size_t n, uint8_t ref, size_t *done) {
+    const uint8x16_t r = vdupq_n_u8(ref);
+    uint8x16_t acc = vdupq_n_u8(0);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        acc = vsubq_u8(acc, vceqq_u8(vld1q_u8(p + i), r));
+    }
+    *done = i;
+    return vaddlvq_u8(acc);
+}
+
+#endif /* TRUERND__HAVE_NEON */
+
+/* Bytes of p[0..n) equal to ref, n at most one window */
+static inline size_t
+truernd__count_eq(const uint8_t *p, size_t n, uint8_t ref) {
+    size_t count = 0, i = 0;
+#if TRUERND__HAVE_X86_SIMD
+    if (truernd_capabilities() & TRUERND_CAP_AVX2) count = truernd__count_eq_avx2(p, n, ref, &i);
+#elif TRUERND__HAVE_NEON
+    count = truernd__count_eq_neon(p, n, ref, &i);
+#endif
+    for (; i < n; i++) count += p[i] == ref;
+    return count;
+}
+
+static inline int
+truernd__has_repeat(const uint64_t *x, size_t n) {
+    size_t i = 0;
+#if TRUERND__HAVE_X86_SIMD
+    if ((truernd_capabilities() & TRUERND_CAP_AVX2) && truernd__has_repeat_avx2(x, n, &i)) return 1;
+#endif
+    int repeat = 0;
+    for (; i + 1 < n; i++) repeat |= x[i] == x[i + 1];
+    return repeat;
+}
+
+/* Run both tests over a finished block; words is its aligned body */
+static int
+truernd__health_block(uint8_t *buf, size_t len, const uint64_t *words, size_t nwords) {
+    truernd__health_state *h = &truernd__health;
+    int failed = 0;
+
+    if (nwords > 0) {
+        if ((h->have_last && words[0] == h->last) || truernd__has_repeat(words, nwords)) {
+            failed = TRUERND_HEALTH_RCT;
+        }
+        h->last = words[nwords - 1];
+        h->have_last = 1;
+    }
+
+    const uint8_t *p = buf;
+    size_t left = len;
+    while (!failed && left > 0) {
+        if (h->apt_seen == 0) {
+            h->apt_ref = *p++;
+            h->apt_seen = 1;
+            h->apt_count = 1;
+            left--;
+            continue;
+        }
+        size_t m = TRUERND__APT_WINDOW - h->apt_seen;
+        if (m > left) m = left;
+        h->apt_count += (uint32_t)truernd__count_eq(p, m, h->apt_ref);
+        if (h->apt_count >= TRUERND_HEALTH_APT_CUTOFF) failed = TRUERND_HEALTH_APT;
+        h->apt_seen = (uint32_t)((h->apt_seen + m) % TRUERND__APT_WINDOW);
+        p += m;
+        left -= m;
+    }
+    if (!failed) return 0;
+
+    /* Never hand out a failing block; restart the APT window on fresh output */
+    memset(buf, 0, len);
+    h->apt_seen = 0;
+    __atomic_fetch_add(&truernd__health_failed, 1, __ATOMIC_RELAXED);
+    truernd_health_fn cb = truernd__health_cb;
+    if (cb) cb(failed, truernd__health_arg);
+    return TRUERND_ERR_HEALTH;
+}
+
+#else
+
+int 
+truernd_set_health_callback(truernd_health_fn fn, void *arg) {
+    (void)fn;
+    (void)arg;
+    return -1;
+}
+
+uint64_t 
+truernd_health_failures(void) {
+    return 0;
+}
+
+#endif /* TRUERND_HEALTH */
+
+/*
+ * Bulk fill kernel
+ */
+
+/* Store a word with a single (possibly unaligned) 64-bit move */
+static inline void
+truernd__store64(void *dst, uint64_t val) {
+    memcpy(dst, &val, sizeof(val));
+}
+
+/* Issue four hardware draws back to back, 0 only if all four succeeded */
+static inline int
+truernd__draw4(uint8_t *dst) {
+#if defined(__x86_64__)
+    uint64_t a, b, c, d;
+    unsigned char ca, cb, cc, cd;
+    __asm__ volatile(
+        "rdrand %0              \n\t"
+        "setc   %4              \n\t"
+        "rdrand %1              \n\t"
+        "setc   %5              \n\t"
+        "rdrand %2              \n\t"
+        "setc   %6              \n\t"
+        "rdrand %3              \n\t"
+        "setc   %7              \n\t"
+        : "=r"(a), "=r"(b), "=r"(c), "=r"(d),
+          "=qm"(ca), "=qm"(cb), "=qm"(cc), "=qm"(cd)
+        :
+        : "cc"
+    );
+    if (!(ca & cb & cc & cd)) return -1;
+#elif defined(__aarch64__)
+    uint64_t a, b, c, d;
+    uint32_t ca, cb, cc, cd;
+    __asm__ volatile(
+        "mrs  %0, RNDR          \n\t"
+        "cset %w4, ne           \n\t"
+        "mrs  %1, RNDR          \n\t"
+        "cset %w5, ne           \n\t"
+        "mrs  %2, RNDR          \n\t"
+        "cset %w6, ne           \n\t"
+        "mrs  %3, RNDR          \n\t"
+        "cset %w7, ne           \n\t"
+        : "=r"(a), "=r"(b), "=r"(c), "=r"(d),
+          "=r"(ca), "=r"(cb), "=r"(cc), "=r"(cd)
+        :
+        : "cc"
+    );
+    if (!(ca & cb & cc & cd)) return -1;
+#else
+    uint64_t a, b, c, d;
+    if (truernd_get64(&a) != 0 || truernd_get64(&b) != 0 ||
+        truernd_get64(&c) != 0 || truernd_get64(&d) != 0) return -1;
+#endif
+    truernd__store64(dst,      a);
+    truernd__store64(dst + 8,  b);
+    truernd__store64(dst + 16, c);
+    truernd__store64(dst + 24, d);
+    return 0;
+}
+
+/* Fill nwords 64-bit words at dst, four draws per iteration */
+static inline int
+truernd__fill_words(uint8_t *dst, size_t nwords) {
+    while (nwords >= 4) {
+        TRUERND__STAT_ADD(draws, 4);
+        if (truernd__draw4(dst) != 0) {
+            TRUERND__STAT_ADD(underflows, 1);
+            /* Underflow somewhere in the block: redo it word by word */
+            for (int i = 0; i < 4; i++) {
+                uint64_t val;
+                if (truernd__draw64(&val) != 0) return -1;
+                truernd__store64(dst + i * 8, val);
+            }
+        }
+        dst += 32;
+        nwords -= 4;
+    }
+
+    while (nwords > 0) {
+        uint64_t val;
+        if (truernd__draw64(&val) != 0) return -1;
+        truernd__store64(dst, val);
+        dst += 8;
+        nwords--;
+    }
+
+    return 0;
+}
+
+/* Fill fewer than 8 bytes from a single draw */
+static inline int
+truernd__fill_bytes(uint8_t *dst, size_t len) {
+    uint64_t val;
+    if (truernd__draw64(&val) != 0) return -1;
+    memcpy(dst, &val, len);
+    return 0;
+}
+
+/* Hardware backend: unrolled RDRAND/RNDR kernel */
+static int
+truernd__fill_hw(void *buf, size_t len) {
+
+    uint8_t *ptr = (uint8_t*)buf;
+
+    /* Unaligned head, so the body is written with aligned 64-bit stores */
+    size_t head = (size_t)(-(uintptr_t)ptr & 7);
+    if (head > len) head = len;
+    if (head > 0) {
+        if (truernd__fill_bytes(ptr, head) != 0) return -1;
+        ptr += head;
+        len -= head;
+    }
+
+#if TRUERND_HEALTH
+    size_t total = head + len;
+    const uint64_t *words = (const uint64_t*)(void*)ptr;
+    size_t nwords = len / 8;
+#endif
+    if (len >= 8) {
+        if (truernd__fill_words(ptr, len / 8) != 0) return -1;
+        ptr += len & ~(size_t)7;
+        len &= 7;
+    }
+
+    if (len > 0) {
+        if (truernd__fill_bytes(ptr, len) != 0) return -1;
+    }
+
+#if TRUERND_HEALTH
+    return truernd__health_block((uint8_t*)buf, total, words, nwords);
+#else
+    return 0;
+#endif
+}
+
+/*
+ * ChaCha20 DRBG
+ */
+
+#define TRUERND__ROTL32(v, n) (((v) << (n)) | ((v) >> (32 - (n))))
+
+#define TRUERND__QR(a, b, c, d)                         \
+    do {                                                \
+        a += b; d ^= a; d = TRUERND__ROTL32(d, 16);     \
+        c += d; b ^= c; b = TRUERND__ROTL32(b, 12);     \
+        a += b; d ^= a; d = TRUERND__ROTL32(d, 8);      \
+        c += d; b ^= c; b = TRUERND__ROTL32(b, 7);      \
+    } while (0)
+
+#define TRUERND__DOUBLE_ROUND(x)                        \
+    do {                                                \
+        TRUERND__QR(x[0], x[4], x[8],  x[12]);          \
+        TRUERND__QR(x[1], x[5], x[9],  x[13]);          \
+        TRUERND__QR(x[2], x[6], x[10], x[14]);          \
+        TRUERND__QR(x[3], x[7], x[11], x[15]);          \
+        TRUERND__QR(x[0], x[5], x[10], x[15]);          \
+        TRUERND__QR(x[1], x[6], x[11], x[12]);          \
+        TRUERND__QR(x[2], x[7], x[8],  x[13]);          \
+        TRUERND__QR(x[3], x[4], x[9],  x[14]);          \
+    } while (0)
+
+/* Overwrite secrets in a way the compiler cannot elide */
+static inline void
+truernd__wipe(void *buf, size_t len) {
+#if defined(__GNUC__) || defined(__clang__)
+    /* The empty asm claims to read the buffer, so the memset has to happen */
+    memset(buf, 0, len);
+    __asm__ volatile("" : : "r"(buf) : "memory");
+#else
+    volatile uint8_t *p = (volatile uint8_t*)buf;
+    while (len--) *p++ = 0;
+#endif
+}
+
+static inline void
+truernd__store32le(uint8_t *dst, uint32_t val) {
+    dst[0] = (uint8_t)val;
+    dst[1] = (uint8_t)(val >> 8);
+    dst[2] = (uint8_t)(val >> 16);
+    dst[3] = (uint8_t)(val >> 24);
+}
+
+/* Original ChaCha20 layout: 64-bit block counter in words 12-13, 64-bit nonce in 14-15 */
+static inline void
+truernd__chacha20_setup(uint32_t st[16], const uint32_t key[8], uint64_t counter, uint64_t nonce) {
+    st[0] = 0x61707865; st[1] = 0x3320646e; st[2] = 0x79622d32; st[3] = 0x6b206574;
+    for (int i = 0; i < 8; i++) st[4 + i] = key[i];
+    st[12] = (uint32_t)counter;
+    st[13] = (uint32_t)(counter >> 32);
+    st[14] = (uint32_t)nonce;
+    st[15] = (uint32_t)(nonce >> 32);
+}
+
+static inline void
+truernd__chacha20_block(const uint32_t st[16], uint8_t out[64]) {
+    uint32_t x[16];
+    for (int i = 0; i < 16; i++) x[i] = st[i];
+    for (int i = 0; i < 10; i++) TRUERND__DOUBLE_ROUND(x);
+    for (int i = 0; i < 16; i++) truernd__store32le(out + 4 * i, x[i] + st[i]);
+    truernd__wipe(x, sizeof(x));
+}
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+
+/* Four blocks per pass, one lane per block; maps onto SSE2 and NEON */
+#define TRUERND__CHACHA_LANES 4
+
+typedef uint32_t truernd__u32x4 __attribute__((vector_size(16)));
+
+#if defined(__clang__)
+    #define TRUERND__SHUF4(a, b, i, j, k, l) __builtin_shufflevector(a, b, i, j, k, l)
+#else
+    #define TRUERND__SHUF4(a, b, i, j, k, l) __builtin_shuffle(a, b, (truernd__u32x4){i, j, k, l})
+#endif
+
+/* Transpose four word vectors and store them as words w..w+3 of four blocks */
+static inline void
+truernd__chacha20_store4(uint8_t *out, int w, truernd__u32x4 a, truernd__u32x4 b,
+                         truernd__u32x4 c, truernd__u32x4 d) {
+    truernd__u32x4 t0 = TRUERND__SHUF4(a, b, 0, 4, 1, 5);
+    truernd__u32x4 t1 = TRUERND__SHUF4(a, b, 2, 6, 3, 7);
+    truernd__u32x4 t2 = TRUERND__SHUF4(c, d, 0, 4, 1, 5);
+    truernd__u32x4 t3 = TRUERND__SHUF4(c, d, 2, 6, 3, 7);
+    truernd__u32x4 r0 = TRUERND__SHUF4(t0, t2, 0, 1, 4, 5);
+    truernd__u32x4 r1 = TRUERND__SHUF4(t0, t2, 2, 3, 6, 7);
+    truernd__u32x4 r2 = TRUERND__SHUF4(t1, t3, 0, 1, 4, 5);
+    truernd__u32x4 r3 = TRUERND__SHUF4(t1, t3, 2, 3, 6, 7);
+    memcpy(out + 4 * w,       &r0, 16);
+    memcpy(out + 4 * w + 64,  &r1, 16);
+    memcpy(out + 4 * w + 128, &r2, 16);
+    memcpy(out + 4 * w + 192, &r3, 16);
+}
+
+static inline void
+truernd__chacha20_blocks4(const uint32_t st[16], uint8_t *out) {
+    truernd__u32x4 s[16], x[16];
+    for (int i = 0; i < 16; i++) s[i] = (truernd__u32x4){st[i], st[i], st[i], st[i]};
+
+    /* Per-lane counters, carrying into the high word */
+    truernd__u32x4 lo = s[12] + (truernd__u32x4){0, 1, 2, 3};
+    s[13] -= (truernd__u32x4)(lo < s[12]);
+    s[12] = lo;
+
+    for (int i = 0; i < 16; i++) x[i] = s[i];
+    for (int i = 0; i < 10; i++) TRUERND__DOUBLE_ROUND(x);
+    for (int i = 0; i < 16; i++) x[i] += s[i];
+
+    /* x now only holds keystream that is already in out, so it is not wiped;
+     * s still holds four copies of the key */
+    for (int w = 0; w < 16; w += 4) {
+        truernd__chacha20_store4(out, w, x[w], x[w + 1], x[w + 2], x[w + 3]);
+    }
+    truernd__wipe(s, sizeof(s));
+}
+
+#else
+#define TRUERND__CHACHA_LANES 1
+#endif
+
+/* Write nblocks consecutive keystream blocks starting at counter */
+static inline void
+truernd__chacha20_blocks(const uint32_t key[8], uint64_t counter, uint64_t nonce,
+                         uint8_t *out, size_t nblocks) {
+    uint32_t st[16];
+    truernd__chacha20_setup(st, key, counter, nonce);
+
+#if TRUERND__CHACHA_LANES == 4
+    while (nblocks >= 4) {
+        truernd__chacha20_blocks4(st, out);
+        counter += 4;
+        st[12] = (uint32_t)counter;
+        st[13] = (uint32_t)(counter >> 32);
+        out += 256;
+        nblocks -= 4;
+    }
+#endif
+
+    while (nblocks > 0) {
+        truernd__chacha20_block(st, out);
+        counter++;
+        st[12] = (uint32_t)counter;
+        st[13] = (uint32_t)(counter >> 32);
+        out += 64;
+        nblocks--;
+    }
+
+    truernd__wipe(st, sizeof(st));
+}
+
+/*
+ * AES-256-CTR keystream
+ */
+
+static const uint8_t truernd__aes_sbox[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5, 0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0, 0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc, 0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a, 0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0, 0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b, 0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85, 0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5, 0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17, 0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88, 0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c, 0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9, 0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6, 0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e, 0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94, 0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68, 0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16
+};
+
+/* FIPS-197 key expansion into 15 round keys, in the byte order AES-NI and AESE expect */
+static inline void
+truernd__aes256_expand(const uint8_t key[32], uint8_t rk[240]) {
+    static const uint8_t rcon[7] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40 };
+
+    memcpy(rk, key, 32);
+    for (int i = 8; i < 60; i++) {
+        uint8_t t[4];
+        memcpy(t, rk + 4 * (i - 1), 4);
+        if (i % 8 == 0) {
+            uint8_t t0 = t[0];
+            t[0] = (uint8_t)(truernd__aes_sbox[t[1]] ^ rcon[i / 8 - 1]);
+            t[1] = truernd__aes_sbox[t[2]];
+            t[2] = truernd__aes_sbox[t[3]];
+            t[3] = truernd__aes_sbox[t0];
+        } else if (i % 8 == 4) {
+            for (int j = 0; j < 4; j++) t[j] = truernd__aes_sbox[t[j]];
+        }
+        for (int j = 0; j < 4; j++) rk[4 * i + j] = (uint8_t)(rk[4 * (i - 8) + j] ^ t[j]);
+    }
+}
+
+#if defined(truernd_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+
+#include <wmmintrin.h>
+#define TRUERND__HAVE_AES 1
+
+/* Counter block: little-endian counter in bytes 0-7, nonce in bytes 8-15 */
+__attribute__((target("aes,sse2"))) static void
+truernd__aes256_ctr(const uint8_t rk[240], uint64_t counter, uint64_t nonce,
+                    uint8_t *out, size_t nblocks) {
+    __m128i k[15];
+    for (int i = 0; i < 15; i++) k[i] = _mm_loadu_si128((const __m128i*)(rk + 16 * i));
+
+    /* Eight independent blocks keep the AES unit's pipeline full; spelled out
+     * so the blocks stay in registers instead of a stack array */
+    const __m128i n = _mm_set_epi64x((long long)nonce, 0);
+    while (nblocks >= 8) {
+        __m128i c = _mm_xor_si128(n, k[0]);
+        __m128i b0 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)counter));
+        __m128i b1 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 1)));
+        __m128i b2 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 2)));
+        __m128i b3 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 3)));
+        __m128i b4 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 4)));
+        __m128i b5 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 5)));
+        __m128i b6 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 6)));
+        __m128i b7 = _mm_xor_si128(c, _mm_set_epi64x(0, (long long)(counter + 7)));
+        for (int r = 1; r < 14; r++) {
+            b0 = _mm_aesenc_si128(b0, k[r]);
+            b1 = _mm_aesenc_si128(b1, k[r]);
+            b2 = _mm_aesenc_si128(b2, k[r]);
+            b3 = _mm_aesenc_si128(b3, k[r]);
+            b4 = _mm_aesenc_si128(b4, k[r]);
+            b5 = _mm_aesenc_si128(b5, k[r]);
+            b6 = _mm_aesenc_si128(b6, k[r]);
+            b7 = _mm_aesenc_si128(b7, k[r]);
+        }
+        _mm_storeu_si128((__m128i*)(out),       _mm_aesenclast_si128(b0, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 16),  _mm_aesenclast_si128(b1, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 32),  _mm_aesenclast_si128(b2, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 48),  _mm_aesenclast_si128(b3, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 64),  _mm_aesenclast_si128(b4, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 80),  _mm_aesenclast_si128(b5, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 96),  _mm_aesenclast_si128(b6, k[14]));
+        _mm_storeu_si128((__m128i*)(out + 112), _mm_aesenclast_si128(b7, k[14]));
+        counter += 8;
+        out += 128;
+        nblocks -= 8;
+    }
+
+    while (nblocks > 0) {
+        __m128i b = _mm_xor_si128(_mm_set_epi64x((long long)nonce, (long long)counter), k[0]);
+        for (int r = 1; r < 14; r++) b = _mm_aesenc_si128(b, k[r]);
+        _mm_storeu_si128((__m128i*)out, _mm_aesenclast_si128(b, k[14]));
+        counter++;
+        out += 16;
+        nblocks--;
+    }
+
+    truernd__wipe(k, sizeof(k));
+}
+
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_AES) || defined(__ARM_FEATURE_CRYPTO))
+
+#include <arm_neon.h>
+#define TRUERND__HAVE_AES 1
+
+static inline uint8x16_t
+truernd__aes256_neon_block(const uint8x16_t k[15], uint64_t counter, uint64_t nonce) {
+    uint8x16_t b = vreinterpretq_u8_u64(vcombine_u64(vcreate_u64(counter), vcreate_u64(nonce)));
+    for (int r = 0; r < 13; r++) b = vaesmcq_u8(vaeseq_u8(b, k[r]));
+    return veorq_u8(vaeseq_u8(b, k[13]), k[14]);
+}
+
+static void
+truernd__aes256_ctr(const uint8_t rk[240], uint64_t counter, uint64_t nonce,
+                    uint8_t *out, size_t nblocks) {
+    uint8x16_t k[15];
+    for (int i = 0; i < 15; i++) k[i] = vld1q_u8(rk + 16 * i);
+
+    while (nblocks > 0) {
+        vst1q_u8(out, truernd__aes256_neon_block(k, counter, nonce));
+        counter++;
+        out += 16;
+        nblocks--;
+    }
+
+    truernd__wipe(k, sizeof(k));
+}
+
+#else
+#define TRUERND__HAVE_AES 0
+#endif
+
+/* 256 bits from the hardware seed source, under the retry policy */
+static inline int
+truernd__seed256(uint64_t seed[4]) {
+    for (int i = 0; i < 4; i++) {
+        if (truernd__seed64(&seed[i]) == 0) continue;
+        if (truernd__retry64(truernd__seed64, truernd__retry_policy.seed_retries,
+                             &seed[i]) != 0) return -1;
+    }
+    return 0;
+}
+
+int 
+truernd_drbg_reseed(truernd_drbg_t *drbg) {
+    if (!drbg) return -1;
+
+    uint64_t seed[4];
+    if (truernd__seed256(seed) != 0) return -1;
+
+    /* XOR in rather than overwrite, so a weak seed cannot lower the state's entropy */
+    for (int i = 0; i < 4; i++) {
+        drbg->key[2 * i]     ^= (uint32_t)seed[i];
+        drbg->key[2 * i + 1] ^= (uint32_t)(seed[i] >> 32);
+    }
+    truernd__wipe(seed, sizeof(seed));
+
+    drbg->counter = 0;
+    drbg->until_reseed = drbg->reseed_interval;
+    drbg->gen = TRUERND__GENERATION();
+    return 0;
+}
+
+int 
+truernd_drbg_init_ex(truernd_drbg_t *drbg, uint64_t reseed_interval, int cipher) {
+    if (!drbg) return -1;
+    if (cipher != TRUERND_DRBG_CHACHA20 && cipher != TRUERND_DRBG_AES256) return -1;
+    if (cipher == TRUERND_DRBG_AES256 &&
+        (!TRUERND__HAVE_AES || !(truernd_capabilities() & TRUERND_CAP_AES))) return -1;
+
+    memset(drbg, 0, sizeof(*drbg));
+    drbg->cipher = cipher;
+    drbg->reseed_interval = reseed_interval ? reseed_interval : TRUERND_DRBG_RESEED_BYTES;
+    if (truernd_drbg_reseed(drbg) != 0) {
+        truernd__wipe(drbg, sizeof(*drbg));
+        return -1;
+    }
+    return 0;
+}
+
+int 
+truernd_drbg_init(truernd_drbg_t *drbg, uint64_t reseed_interval) {
+    return truernd_drbg_init_ex(drbg, reseed_interval, TRUERND_DRBG_CHACHA20);
+}
+
+/* Keystream blocks of the DRBG's cipher; rk holds the AES round keys of drbg->key */
+static inline void
+truernd__drbg_blocks(const truernd_drbg_t *drbg, const uint8_t *rk, uint64_t counter,
+                     uint8_t *out, size_t nblocks) {
+#if TRUERND__HAVE_AES
+    if (drbg->cipher == TRUERND_DRBG_AES256) {
+        truernd__aes256_ctr(rk, counter, 0, out, nblocks);
+        return;
+    }
+#else
+    (void)rk;
+#endif
+    truernd__chacha20_blocks(drbg->key, counter, 0, out, nblocks);
+}
+
+static inline void
+truernd__drbg_key_bytes(const truernd_drbg_t *drbg, uint8_t key[32]) {
+    for (int i = 0; i < 8; i++) truernd__store32le(key + 4 * i, drbg->key[i]);
+}
+
+int 
+truernd_drbg_fill(truernd_drbg_t *drbg, void *buf, size_t len) {
+    if (!drbg || !buf || len == 0 || drbg->reseed_interval == 0) return -1;
+
+    const size_t bs = drbg->cipher == TRUERND_DRBG_AES256 ? 16 : 64;
+    uint8_t *ptr = (uint8_t*)buf;
+    uint8_t block[64];
+    uint8_t rk[240];
+    int keyed = 0;
+
+    while (len > 0) {
+        /* A fork child (or a restored snapshot) must not reuse the parent's key */
+        if (drbg->until_reseed == 0 || drbg->gen != TRUERND__GENERATION()) {
+            if (truernd_drbg_reseed(drbg) != 0) {
+                truernd__wipe(rk, sizeof(rk));
+                return -1;
+            }
+            keyed = 0;
+        }
+        if (!keyed && drbg->cipher == TRUERND_DRBG_AES256) {
+            truernd__drbg_key_bytes(drbg, block);
+            truernd__aes256_expand(block, rk);
+        }
+        keyed = 1;
+
+        size_t n = len;
+        if (n > drbg->until_reseed) n = (size_t)drbg->until_reseed;
+
+        size_t full = n / bs;
+        truernd__drbg_blocks(drbg, rk, drbg->counter, ptr, full);
+        drbg->counter += full;
+
+        size_t rest = n % bs;
+        if (rest > 0) {
+            truernd__drbg_blocks(drbg, rk, drbg->counter++, block, 1);
+            memcpy(ptr + full * bs, block, rest);
+        }
+
+        ptr += n;
+        len -= n;
+        drbg->until_reseed -= n;
+    }
+
+    /* Fast key erasure: the next key comes from blocks nobody has seen */
+    truernd__drbg_blocks(drbg, rk, drbg->counter, block, 64 / bs);
+    for (int i = 0; i < 8; i++) {
+        drbg->key[i] = (uint32_t)block[4 * i] | (uint32_t)block[4 * i + 1] << 8 |
+                       (uint32_t)block[4 * i + 2] << 16 | (uint32_t)block[4 * i + 3] << 24;
+    }
+    drbg->counter = 0;
+    truernd__wipe(block, sizeof(block));
+    truernd__wipe(rk, sizeof(rk));
+    return 0;
+}
+
+/*
+ * Backend dispatch
+ */
+
+static TRUERND_TLS truernd_drbg_t truernd__local_drbg;
+
+/* Per-thread DRBG for the DRBG backends, seeded on first use */
+static inline int
+truernd__fill_local_drbg(int cipher, void *buf, size_t len) {
+    truernd_drbg_t *drbg = &truernd__local_drbg;
+    if ((drbg->reseed_interval == 0 || drbg->cipher != cipher) &&
+        truernd_drbg_init_ex(drbg, 0, cipher) != 0) return -1;
+    return truernd_drbg_fill(drbg, buf, len);
+}
+
+static int
+truernd__fill_drbg_chacha20(void *buf, size_t len) {
+    return truernd__fill_local_drbg(TRUERND_DRBG_CHACHA20, buf, len);
+}
+
+static int
+truernd__fill_drbg_aes(void *buf, size_t len) {
+    return truernd__fill_local_drbg(TRUERND_DRBG_AES256, buf, len);
+}
+
+/*
+ * Source mixing
+ *
+ * The mixed backend draws TRUERND_MIX_BATCH bytes from each configured
+ * source in one go, then combines them. XOR needs one pass; SHA-256 hashes
+ * 64 bytes of source material (32 from each of two sources), the batch's
+ * jitter digest and a counter into each 32-byte output block, which is two
+ * compression calls per block.
+ */
+
+static const uint32_t truernd__sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define TRUERND__ROTR32(v, n) (((v) >> (n)) | ((v) << (32 - (n))))
+
+static void
+truernd__sha256_blocks_scalar(uint32_t st[8], const uint8_t *p, size_t nblocks) {
+    for (; nblocks > 0; nblocks--, p += 64) {
+        uint32_t w[64], v[8];
+        for (int i = 0; i < 16; i++) {
+            w[i] = (uint32_t)p[4 * i] << 24 | (uint32_t)p[4 * i + 1] << 16 |
+                   (uint32_t)p[4 * i + 2] << 8 | p[4 * i + 3];
+        }
+        for (int i = 16; i < 64; i++) {
+            uint32_t s0 = TRUERND__ROTR32(w[i - 15], 7) ^ TRUERND__ROTR32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = TRUERND__ROTR32(w[i - 2], 17) ^ TRUERND__ROTR32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        for (int i = 0; i < 8; i++) v[i] = st[i];
+        for (int i = 0; i < 64; i++) {
+            uint32_t s1 = TRUERND__ROTR32(v[4], 6) ^ TRUERND__ROTR32(v[4], 11) ^ TRUERND__ROTR32(v[4], 25);
+            uint32_t ch = (v[4] & v[5]) ^ (~v[4] & v[6]);
+            uint32_t t1 = v[7] + s1 + ch + truernd__sha256_k[i] + w[i];
+            uint32_t s0 = TRUERND__ROTR32(v[0], 2) ^ TRUERND__ROTR32(v[0], 13) ^ TRUERND__ROTR32(v[0], 22);
+            uint32_t maj = (v[0] & v[1]) ^ (v[0] & v[2]) ^ (v[1] & v[2]);
+            v[7] = v[6]; v[6] = v[5]; v[5] = v[4]; v[4] = v[3] + t1;
+            v[3] = v[2]; v[2] = v[1]; v[1] = v[0]; v[0] = t1 + s0 + maj;
+        }
+        for (int i = 0; i < 8; i++) st[i] += v[i];
+        truernd__wipe(w, sizeof(w));
+    }
+}
+
+#if TRUERND__HAVE_X86_SIMD
+
+/* SHA-NI keeps the state as ABEF / CDGH and does two rounds per instruction */
+__attribute__((target("sha,sse4.1"))) static void
+truernd__sha256_blocks_shani(uint32_t st[8], const uint8_t *p, size_t nblocks) {
+#if defined(__AVX__)
+    /* The SHA instructions have no VEX form: entered with dirty upper YMM
+     * halves (seen at -O3 -march=x86-64-v3) each one pays the SSE/AVX
+     * transition penalty, about 20x on the mixed backend */
+    _mm256_zeroupper();
+#endif
+    const __m128i bswap = _mm_set_epi64x(0x0c0d0e0f08090a0bll, 0x0405060700010203ll);
+    __m128i dcba = _mm_loadu_si128((const __m128i*)(const void*)st);
+    __m128i hgfe = _mm_loadu_si128((const __m128i*)(const void*)(st + 4));
+    __m128i cdab = _mm_shuffle_epi32(dcba, 0xB1);
+    __m128i efgh = _mm_shuffle_epi32(hgfe, 0x1B);
+    __m128i abef = _mm_alignr_epi8(cdab, efgh, 8);
+    __m128i cdgh = _mm_blend_epi16(efgh, cdab, 0xF0);
+
+    for (; nblocks > 0; nblocks--, p += 64) {
+        __m128i abef0 = abef, cdgh0 = cdgh, w[4];
+        for (int g = 0; g < 16; g++) {
+            if (g < 4) {
+                w[g] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(const void*)(p + 16 * g)), bswap);
+            } else {
+                /* w[g & 3] still holds the words from four groups back */
+                __m128i t = _mm_sha256msg1_epu32(w[g & 3], w[(g + 1) & 3]);
+                t = _mm_add_epi32(t, _mm_alignr_epi8(w[(g + 3) & 3], w[(g + 2) & 3], 4));
+                w[g & 3] = _mm_sha256msg2_epu32(t, w[(g + 3) & 3]);
+            }
+            __m128i wk = _mm_add_epi32(w[g & 3],
+                                       _mm_loadu_si128((const __m128i*)(const void*)(truernd__sha256_k + 4 * g)));
+            cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk);
+            abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E));
+        }
+        abef = _mm_add_epi32(abef, abef0);
+        cdgh = _mm_add_epi32(cdgh, cdgh0);
+    }
+
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B);
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1);
+    _mm_storeu_si128((__m128i*)(void*)st, _mm_blend_epi16(feba, dchg, 0xF0));
+    _mm_storeu_si128((__m128i*)(void*)(st + 4), _mm_alignr_epi8(dchg, feba, 8));
+}
+
+#define TRUERND__HAVE_SHA2 1
+
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+
+static void
+truernd__sha256_blocks_arm(uint32_t st[8], const uint8_t *p, size_t nblocks) {
+    uint32x4_t abcd = vld1q_u32(st), efgh = vld1q_u32(st + 4);
+
+    for (; nblocks > 0; nblocks--, p += 64) {
+        uint32x4_t abcd0 = abcd, efgh0 = efgh, w[4];
+        for (int g = 0; g < 16; g++) {
+            if (g < 4) {
+                w[g] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(p + 16 * g)));
+            } else {
+                w[g & 3] = vsha256su1q_u32(vsha256su0q_u32(w[g & 3], w[(g + 1) & 3]),
+                                           w[(g + 2) & 3], w[(g + 3) & 3]);
+            }
+            uint32x4_t wk = vaddq_u32(w[g & 3], vld1q_u32(truernd__sha256_k + 4 * g));
+            uint32x4_t prev = abcd;
+            abcd = vsha256hq_u32(abcd, efgh, wk);
+            efgh = vsha256h2q_u32(efgh, prev, wk);
+        }
+        abcd = vaddq_u32(abcd, abcd0);
+        efgh = vaddq_u32(efgh, efgh0);
+    }
+    vst1q_u32(st, abcd);
+    vst1q_u32(st + 4, efgh);
+}
+
+#define TRUERND__HAVE_SHA2 1
+
+#else
+#define TRUERND__HAVE_SHA2 0
+#endif
+
+static inline void
+truernd__sha256_blocks(uint32_t st[8], const uint8_t *p, size_t nblocks) {
+#if TRUERND__HAVE_SHA2
+    if (truernd_capabilities() & TRUERND_CAP_SHA2) {
+#if TRUERND__HAVE_X86_SIMD
+        truernd__sha256_blocks_shani(st, p, nblocks);
+#else
+        truernd__sha256_blocks_arm(st, p, nblocks);
+#endif
+        return;
+    }
+#endif
+    truernd__sha256_blocks_scalar(st, p, nblocks);
+}
+
+static const uint32_t truernd__sha256_iv[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+/* One-shot SHA-256 */
+static void
+truernd__sha256(const uint8_t *msg, size_t len, uint8_t out[32]) {
+    uint32_t st[8];
+    uint8_t tail[128] = {0};
+    memcpy(st, truernd__sha256_iv, sizeof(st));
+    size_t whole = len / 64, rest = len % 64;
+    truernd__sha256_blocks(st, msg, whole);
+
+    memcpy(tail, msg + whole * 64, rest);
+    tail[rest] = 0x80;
+    size_t tail_len = rest < 56 ? 64 : 128;
+    uint64_t bits = (uint64_t)len * 8;
+    for (int i = 0; i < 8; i++) tail[tail_len - 1 - i] = (uint8_t)(bits >> (8 * i));
+    truernd__sha256_blocks(st, tail, tail_len / 64);
+
+    for (int i = 0; i < 8; i++) {
+        out[4 * i]     = (uint8_t)(st[i] >> 24);
+        out[4 * i + 1] = (uint8_t)(st[i] >> 16);
+        out[4 * i + 2] = (uint8_t)(st[i] >> 8);
+        out[4 * i + 3] = (uint8_t)st[i];
+    }
+    truernd__wipe(tail, sizeof(tail));
+    truernd__wipe(st, sizeof(st));
+}
+
+/* Timer deltas around a data-dependent memory walk, hashed to 32 bytes. Not a
+ * validated jitter source: it is only ever hashed in alongside the others */
+static void
+truernd__jitter32(uint8_t out[32]) {
+    volatile uint8_t walk[1024];
+    uint64_t deltas[64];
+    size_t idx = 0;
+    for (size_t i = 0; i < sizeof(walk); i++) walk[i] = (uint8_t)i;
+
+    uint64_t prev = truernd__ticks();
+    for (int i = 0; i < 64; i++) {
+        for (int k = 0; k < 16; k++) {
+            idx = (idx + walk[idx] + 67) & (sizeof(walk) - 1);
+            walk[idx] = (uint8_t)(walk[idx] ^ prev);
+        }
+        uint64_t now = truernd__ticks();
+        deltas[i] = now - prev;
+        prev = now;
+    }
+    truernd__sha256((const uint8_t*)deltas, sizeof(deltas), out);
+}
+
+static truernd_mix_t truernd__mix = { TRUERND_MIX_HW | TRUERND_MIX_OS, TRUERND_MIX_SHA256 };
+static TRUERND_TLS uint64_t truernd__mix_counter;
+
+static int
+truernd__mix_valid(const truernd_mix_t *mix) {
+    const unsigned int all = TRUERND_MIX_HW | TRUERND_MIX_OS | TRUERND_MIX_JITTER;
+    if (mix->sources == 0 || (mix->sources & ~all) != 0) return 0;
+    if (mix->mode != TRUERND_MIX_XOR && mix->mode != TRUERND_MIX_SHA256) return 0;
+    if (mix->mode == TRUERND_MIX_XOR && (mix->sources & TRUERND_MIX_JITTER)) return 0;
+    if (mix->sources == TRUERND_MIX_JITTER) return 0;  /* Never the only source */
+    if ((mix->sources & TRUERND_MIX_HW) && !truernd_is_supported()) return 0;
+    return 1;
+}
+
+int 
+truernd_set_mix(const truernd_mix_t *mix) {
+    static const truernd_mix_t defaults = { TRUERND_MIX_HW | TRUERND_MIX_OS, TRUERND_MIX_SHA256 };
+    if (!mix) mix = &defaults;
+    if (!truernd__mix_valid(mix)) return -1;
+    truernd__mix = *mix;
+    return 0;
+}
+
+void 
+truernd_get_mix(truernd_mix_t *mix) {
+    if (mix) *mix = truernd__mix;
+}
+
+/* Fill n bytes from one source of the pipeline */
+static inline int
+truernd__mix_draw(unsigned int source, uint8_t *buf, size_t n) {
+    return source == TRUERND_MIX_HW ? truernd__fill_hw(buf, n) : truernd_os_fill(buf, n);
+}
+
+static int
+truernd__fill_mixed(void *buf, size_t len) {
+    truernd_mix_t mix = truernd__mix;
+    unsigned int hw = mix.sources & TRUERND_MIX_HW, os = mix.sources & TRUERND_MIX_OS;
+    uint8_t *out = (uint8_t*)buf;
+    int rc = 0;
+
+    if (mix.mode == TRUERND_MIX_XOR) {
+        /* One source straight into the buffer, the other XORed over it */
+        TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint8_t other[TRUERND_MIX_BATCH];
+        if ((rc = truernd__mix_draw(hw ? hw : os, out, len)) != 0 || !(hw && os)) return rc;
+        for (size_t off = 0; off < len; off += TRUERND_MIX_BATCH) {
+            size_t n = len - off < TRUERND_MIX_BATCH ? len - off : TRUERND_MIX_BATCH;
+            if ((rc = truernd_os_fill(other, n)) != 0) break;
+            for (size_t i = 0; i < n; i++) out[off + i] ^= other[i];
+        }
+        truernd__wipe(other, sizeof(other));
+        return rc;
+    }
+
+    /* SHA-256: per 32 output bytes, 32 bytes of each source or 64 of the only one */
+    /* Message is material, jitter digest and counter, padded once up front:
+     * 104 bytes is 832 bits, two blocks */
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint8_t material[2 * TRUERND_MIX_BATCH];
+    uint8_t msg[128];
+    uint32_t st[8];
+    memset(msg, 0, sizeof(msg));
+    msg[104] = 0x80;
+    msg[126] = 832 >> 8;
+    msg[127] = 832 & 0xff;
+    while (len > 0 && rc == 0) {
+        size_t n = len < TRUERND_MIX_BATCH ? len : TRUERND_MIX_BATCH;
+        size_t half = (n + 31) & ~(size_t)31;
+        if (hw && os) {
+            if ((rc = truernd__fill_hw(material, half)) != 0 ||
+                (rc = truernd_os_fill(material + half, half)) != 0) break;
+        } else if ((rc = truernd__mix_draw(hw ? hw : os, material, 2 * half)) != 0) {
+            break;
+        }
+        if (mix.sources & TRUERND_MIX_JITTER) truernd__jitter32(msg + 64);
+
+        for (size_t blk = 0; blk * 32 < n; blk++) {
+            if (hw && os) {
+                memcpy(msg, material + 32 * blk, 32);
+                memcpy(msg + 32, material + half + 32 * blk, 32);
+            } else {
+                memcpy(msg, material + 64 * blk, 64);
+            }
+            uint64_t ctr = truernd__mix_counter++;
+            memcpy(msg + 96, &ctr, sizeof(ctr));
+            memcpy(st, truernd__sha256_iv, sizeof(st));
+            truernd__sha256_blocks(st, msg, 2);
+            size_t take = n - blk * 32 < 32 ? n - blk * 32 : 32;
+            for (size_t i = 0; i < take; i++) out[blk * 32 + i] = (uint8_t)(st[i / 4] >> (24 - 8 * (i % 4)));
+        }
+        out += n;
+        len -= n;
+    }
+    truernd__wipe(material, sizeof(material));
+    truernd__wipe(msg, sizeof(msg));
+    truernd__wipe(st, sizeof(st));
+    return rc;
+}
+
+/*
+ * Replay backend
+ *
+ * Not a random source: a repeatable byte stream for benchmarks and tests,
+ * compiled in only with TRUERND_REPLAY. The PRNG is xoshiro256++, seeded
+ * per thread through splitmix64, which fills at several GB/s.
+ */
+
+#if TRUERND_REPLAY
+
+static uint64_t truernd__replay_seed_value;
+static uint32_t truernd__replay_epoch = 1;      /* Bumped by every seed, so threads restart */
+static uint32_t truernd__replay_threads;        /* Streams handed out under this epoch */
+static const uint8_t *truernd__replay_bytes;
+static size_t truernd__replay_len;
+static size_t truernd__replay_pos;
+
+typedef struct truernd__replay_state {
+    uint64_t s[4];
+    uint32_t epoch;
+} truernd__replay_state;
+
+static TRUERND_TLS truernd__replay_state truernd__replay_local;
+
+static inline uint64_t
+truernd__splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t
+truernd__xoshiro256pp(uint64_t s[4]) {
+    uint64_t r = s[0] + s[3];
+    r = ((r << 23) | (r >> 41)) + s[0];
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = (s[3] << 45) | (s[3] >> 19);
+    return r;
+}
+
+void 
+truernd_replay_seed(uint64_t seed) {
+    __atomic_store_n(&truernd__replay_seed_value, seed, __ATOMIC_RELAXED);
+    __atomic_store_n(&truernd__replay_threads, 0, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&truernd__replay_epoch, 1, __ATOMIC_RELEASE);
+}
+
+int 
+truernd_replay_data(const void *data, size_t len) {
+    if (data && len == 0) return -1;
+
+    __atomic_store_n(&truernd__replay_bytes, NULL, __ATOMIC_RELEASE);
+    __atomic_store_n(&truernd__replay_len, data ? len : 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&truernd__replay_pos, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&truernd__replay_bytes, (const uint8_t*)data, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static int
+truernd__fill_replay(void *buf, size_t len) {
+    uint8_t *out = (uint8_t*)buf;
+
+    const uint8_t *rec = __atomic_load_n(&truernd__replay_bytes, __ATOMIC_ACQUIRE);
+    if (rec) {
+        size_t n = __atomic_load_n(&truernd__replay_len, __ATOMIC_RELAXED);
+        size_t at = __atomic_fetch_add(&truernd__replay_pos, len, __ATOMIC_RELAXED) % n;
+        while (len > 0) {
+            size_t take = n - at < len ? n - at : len;
+            memcpy(out, rec + at, take);
+            out += take;
+            len -= take;
+            at = 0;
+        }
+        return 0;
+    }
+
+    truernd__replay_state *st = &truernd__replay_local;
+    uint32_t epoch = __atomic_load_n(&truernd__replay_epoch, __ATOMIC_ACQUIRE);
+    if (st->epoch != epoch) {
+        uint64_t x = __atomic_load_n(&truernd__replay_seed_value, __ATOMIC_RELAXED) +
+                     0x632be59bd9b4e019ull * __atomic_fetch_add(&truernd__replay_threads, 1, __ATOMIC_RELAXED);
+        for (int i = 0; i < 4; i++) st->s[i] = truernd__splitmix64(&x);
+        st->epoch = epoch;
+    }
+
+    for (; len >= 8; len -= 8, out += 8) {
+        uint64_t v = truernd__xoshiro256pp(st->s);
+        memcpy(out, &v, 8);
+    }
+    if (len > 0) {
+        uint64_t v = truernd__xoshiro256pp(st->s);
+        memcpy(out, &v, len);
+    }
+    return 0;
+}
+
+#else
+
+void 
+truernd_replay_seed(uint64_t seed) {
+    (void)seed;
+}
+
+int 
+truernd_replay_data(const void *data, size_t len) {
+    (void)data;
+    (void)len;
+    return -1;
+}
+
+static int
+truernd__fill_replay(void *buf, size_t len) {
+    (void)buf;
+    (void)len;
+    return -1;
+}
+
+#endif /* TRUERND_REPLAY */
+
+typedef struct truernd__backend_ops {
+    const char *name;
+    int (*fill)(void *buf, size_t len);
+} truernd__backend_ops;
+
+static int truernd__fill_resolve(void *buf, size_t len);
+
+/* Indexed by truernd_backend_t */
+static const truernd__backend_ops truernd__backends[TRUERND_BACKEND_COUNT] = {
+    { "auto",          truernd__fill_resolve },
+    { "fastest",       truernd__fill_resolve },
+    { "hw",            truernd__fill_hw },
+    { "drbg-chacha20", truernd__fill_drbg_chacha20 },
+    { "drbg-aes",      truernd__fill_drbg_aes },
+    { "os",            truernd_os_fill },
+    { "mixed",         truernd__fill_mixed },
+    { "replay",        truernd__fill_replay }     /* NOT FOR PRODUCTION */
+};
+
+/* Starts at the resolver, which binds the real backend on the first fill */
+static const truernd__backend_ops *truernd__active = &truernd__backends[TRUERND_BACKEND_AUTO];
+
+int 
+truernd_backend_available(truernd_backend_t backend) {
+    unsigned int caps = truernd_capabilities();
+
+    switch (backend) {
+    case TRUERND_BACKEND_AUTO:
+    case TRUERND_BACKEND_FASTEST:
+        return 1;
+    case TRUERND_BACKEND_HW:
+        return (caps & (TRUERND_CAP_RDRAND | TRUERND_CAP_RNDR)) ? 1 : 0;
+    case TRUERND_BACKEND_DRBG_CHACHA20:
+        return (caps & (TRUERND_CAP_RDSEED | TRUERND_CAP_RNDRRS)) ? 1 : 0;
+    case TRUERND_BACKEND_DRBG_AES:
+        return TRUERND__HAVE_AES && (caps & TRUERND_CAP_AES) &&
+               (caps & (TRUERND_CAP_RDSEED | TRUERND_CAP_RNDRRS)) ? 1 : 0;
+    case TRUERND_BACKEND_MIXED:
+        return truernd__mix_valid(&truernd__mix);
+    case TRUERND_BACKEND_REPLAY:
+        return TRUERND_REPLAY ? 1 : 0;
+    case TRUERND_BACKEND_OS:
+#if defined(__linux__) || defined(_WIN32) || defined(__APPLE__) || \
+    defined(__FreeBSD__) || defined(__OpenBSD__) || defined(__NetBSD__)
+        return 1;
+#else
+        return 0;
+#endif
+    default:
+        return 0;
+    }
+}
+
+/* Concrete backend for AUTO (keep true random output) or FASTEST (prefer the DRBG) */
+static truernd_backend_t
+truernd__resolve(truernd_backend_t backend) {
+    static const truernd_backend_t order_auto[] = {
+        TRUERND_BACKEND_HW, TRUERND_BACKEND_DRBG_AES, TRUERND_BACKEND_DRBG_CHACHA20, TRUERND_BACKEND_OS
+    };
+    static const truernd_backend_t order_fastest[] = {
+        TRUERND_BACKEND_DRBG_AES, TRUERND_BACKEND_DRBG_CHACHA20, TRUERND_BACKEND_HW, TRUERND_BACKEND_OS
+    };
+
+    if (backend != TRUERND_BACKEND_AUTO && backend != TRUERND_BACKEND_FASTEST) return backend;
+
+    const truernd_backend_t *order = backend == TRUERND_BACKEND_AUTO ? order_auto : order_fastest;
+    for (int i = 0; i < 4; i++) {
+        if (truernd_backend_available(order[i])) return order[i];
+    }
+    return TRUERND_BACKEND_HW;
+}
+
+int 
+truernd_set_backend(truernd_backend_t backend) {
+    if (backend < 0 || backend >= TRUERND_BACKEND_COUNT) return -1;
+
+    backend = truernd__resolve(backend);
+    if (!truernd_backend_available(backend)) return -1;
+
+    TRUERND__STORE_RELAXED(&truernd__active, &truernd__backends[backend]);
+    return 0;
+}
+
+/* Bind TRUERND_DEFAULT_BACKEND, or the hardware kernel if it cannot run here */
+static const truernd__backend_ops *
+truernd__bind_default(void) {
+    if (truernd_set_backend(TRUERND_DEFAULT_BACKEND) != 0) {
+        TRUERND__STORE_RELAXED(&truernd__active, &truernd__backends[TRUERND_BACKEND_HW]);
+    }
+    return TRUERND__LOAD_RELAXED(&truernd__active);
+}
+
+truernd_backend_t 
+truernd_get_backend(void) {
+    const truernd__backend_ops *ops = TRUERND__LOAD_RELAXED(&truernd__active);
+    if (ops->fill == truernd__fill_resolve) ops = truernd__bind_default();
+    return (truernd_backend_t)(ops - truernd__backends);
+}
+
+const char *
+truernd_backend_name(truernd_backend_t backend) {
+    if (backend < 0 || backend >= TRUERND_BACKEND_COUNT) return "unknown";
+    return truernd__backends[backend].name;
+}
+
+static int
+truernd__fill_resolve(void *buf, size_t len) {
+    return truernd__bind_default()->fill(buf, len);
+}
+
+int 
+truernd_fill_backend(truernd_backend_t backend, void *buf, size_t len) {
+    if (!buf || len == 0) return -1;
+    if (backend < 0 || backend >= TRUERND_BACKEND_COUNT) return -1;
+
+    backend = truernd__resolve(backend);
+    if (!truernd_backend_available(backend)) return -1;
+    return truernd__backends[backend].fill(buf, len);
+}
+
+/* The bound backend's fill, without argument checks */
+static inline int
+truernd__fill(void *buf, size_t len) {
+#if TRUERND_STATS
+    uint64_t start = truernd__ticks();
+    int rc = TRUERND__LOAD_RELAXED(&truernd__active)->fill(buf, len);
+    TRUERND__STAT_ADD(cycles, truernd__ticks() - start);
+    if (rc == 0) TRUERND__STAT_ADD(bytes, len);
+    return rc;
+#else
+    return TRUERND__LOAD_RELAXED(&truernd__active)->fill(buf, len);
+#endif
+}
+
+static int
+truernd__fill_stream(void *buf, size_t len);
+
+/* Large fills bypass the cache, everything else takes the plain dispatch */
+static inline int
+truernd__fill_sized(void *buf, size_t len) {
+    if (TRUERND_NT_THRESHOLD > 0 && len >= TRUERND_NT_THRESHOLD) return truernd__fill_stream(buf, len);
+    return truernd__fill(buf, len);
+}
+
+int 
+truernd_fill(void *buf, size_t len) {
+    if (!buf || len == 0) return -1;
+    return truernd__fill_sized(buf, len);
+}
+
+int 
+truernd_fill_ex(void *buf, size_t len, unsigned int flags) {
+    if (!buf || len == 0) return -1;
+    if ((flags & TRUERND_FILL_CACHED) && (flags & TRUERND_FILL_NT)) return -1;
+
+    if (flags & TRUERND_FILL_NT) return truernd__fill_stream(buf, len);
+    if (flags & TRUERND_FILL_CACHED) return truernd__fill(buf, len);
+    return truernd__fill_sized(buf, len);
+}
+
+/*
+ * Parallel fill
+ */
+
+#if defined(__unix__) || defined(__APPLE__)
+#define TRUERND__HAVE_PTHREADS 1
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#else
+#define TRUERND__HAVE_PTHREADS 0
+#endif
+
+typedef struct truernd__parallel_job {
+    uint8_t *buf;
+    size_t len;
+    size_t ntasks;
+    int error;      /* First non-zero result, set once */
+} truernd__parallel_job;
+
+/* Start offset of a task's chunk, rounded up to a cache line boundary of the buffer */
+static inline size_t
+truernd__parallel_offset(const truernd__parallel_job *job, size_t index) {
+    if (index == 0) return 0;
+    if (index >= job->ntasks) return job->len;
+
+    size_t n = job->ntasks;
+    size_t split = (job->len / n) * index + (job->len % n) * index / n;
+    uintptr_t addr = (uintptr_t)(job->buf + split);
+    size_t pad = (size_t)(-addr & (TRUERND_CACHE_LINE - 1));
+    return split + pad > job->len ? job->len : split + pad;
+}
+
+static void
+truernd__parallel_task(void *arg, size_t index) {
+    truernd__parallel_job *job = (truernd__parallel_job*)arg;
+    size_t start = truernd__parallel_offset(job, index);
+    size_t end = truernd__parallel_offset(job, index + 1);
+    if (end <= start) return;
+
+    /* Chunks follow the store policy the whole buffer would get */
+    int rc = TRUERND_NT_THRESHOLD > 0 && job->len >= TRUERND_NT_THRESHOLD
+           ? truernd__fill_stream(job->buf + start, end - start)
+           : truernd__fill(job->buf + start, end - start);
+    if (rc != 0) {
+        int expected = 0;
+#if defined(__GNUC__) || defined(__clang__)
+        __atomic_compare_exchange_n(&job->error, &expected, rc, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+#else
+        if (job->error == expected) job->error = rc;
+#endif
+    }
+}
+
+unsigned int 
+truernd_cpu_count(void) {
+#if TRUERND__HAVE_PTHREADS && defined(_SC_NPROCESSORS_ONLN)
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (unsigned int)n : 1;
+#elif defined(_WIN32)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors ? (unsigned int)info.dwNumberOfProcessors : 1;
+#else
+    return 1;
+#endif
+}
+
+int 
+truernd_fill_parallel_ex(void *buf, size_t len, const truernd_executor_t *exec) {
+    if (!buf || len == 0 || !exec || !exec->run) return -1;
+
+    truernd__parallel_job job;
+    job.buf = (uint8_t*)buf;
+    job.len = len;
+    job.ntasks = exec->workers ? exec->workers : 1;
+    job.error = 0;
+
+    exec->run(exec->ctx, truernd__parallel_task, &job, job.ntasks);
+    return TRUERND__LOAD_RELAXED(&job.error);
+}
+
+#if TRUERND__HAVE_PTHREADS
+
+typedef struct truernd__parallel_worker {
+    void (*task)(void *arg, size_t index);
+    void *arg;
+    size_t index;
+} truernd__parallel_worker;
+
+static void *
+truernd__parallel_thread(void *arg) {
+    truernd__parallel_worker *w = (truernd__parallel_worker*)arg;
+    w->task(w->arg, w->index);
+    return NULL;
+}
+
+/* Default executor: one short-lived thread per task, the caller runs task 0 */
+static void
+truernd__parallel_run(void *ctx, void (*task)(void *arg, size_t index), void *arg, size_t ntasks) {
+    pthread_t threads[TRUERND_PARALLEL_MAX_THREADS];
+    truernd__parallel_worker workers[TRUERND_PARALLEL_MAX_THREADS];
+    int started[TRUERND_PARALLEL_MAX_THREADS];
+    (void)ctx;
+
+    for (size_t i = 1; i < ntasks; i++) {
+        workers[i].task = task;
+        workers[i].arg = arg;
+        workers[i].index = i;
+        started[i] = pthread_create(&threads[i], NULL, truernd__parallel_thread, &workers[i]) == 0;
+    }
+
+    task(arg, 0);
+
+    for (size_t i = 1; i < ntasks; i++) {
+        if (started[i]) pthread_join(threads[i], NULL);
+        else task(arg, i);  /* Could not spawn: do the chunk here */
+    }
+}
+
+#else
+
+static void
+truernd__parallel_run(void *ctx, void (*task)(void *arg, size_t index), void *arg, size_t ntasks) {
+    (void)ctx;
+    for (size_t i = 0; i < ntasks; i++) task(arg, i);
+}
+
+#endif /* TRUERND__HAVE_PTHREADS */
+
+int 
+truernd_fill_parallel(void *buf, size_t len, unsigned int nthreads) {
+    if (!buf || len == 0) return -1;
+
+    size_t n = nthreads ? nthreads : truernd_cpu_count();
+    size_t max_by_size = len / TRUERND_PARALLEL_MIN_CHUNK;
+    if (n > max_by_size) n = max_by_size;
+    if (n > TRUERND_PARALLEL_MAX_THREADS) n = TRUERND_PARALLEL_MAX_THREADS;
+    if (n <= 1) return truernd__fill_sized(buf, len);
+
+    truernd_executor_t exec;
+    exec.ctx = NULL;
+    exec.workers = (unsigned int)n;
+    exec.run = truernd__parallel_run;
+    return truernd_fill_parallel_ex(buf, len, &exec);
+}
+
+/*
+ * Buffered entropy pool
+ */
+
+static TRUERND_TLS truernd_pool_t truernd__local_pool;
+
+int 
+truernd_pool_init(truernd_pool_t *pool) {
+    if (!pool) return -1;
+
+    memset(pool, 0, sizeof(*pool));
+    pool->gen = TRUERND__GENERATION();
+    return 0;
+}
+
+int 
+truernd_pool_refill(truernd_pool_t *pool) {
+    if (!pool) return -1;
+    if (!pool->active) pool->active = pool->words;
+
+    pool->avail = 0;
+    int rc = truernd__fill(pool->active, sizeof(pool->words));
+    if (rc != 0) return rc;
+    pool->avail = TRUERND_POOL_WORDS;
+    return 0;
+}
+
+static inline truernd_pool_t *
+truernd_pool_local(void) {
+    return &truernd__local_pool;
+}
+
+/* Async shadow states */
+#define TRUERND__SHADOW_IDLE    0
+#define TRUERND__SHADOW_PENDING 1
+#define TRUERND__SHADOW_READY   2
+
+/* Hand out the shadow buffer; the drained active one, all wiped, becomes the shadow */
+static inline void
+truernd__pool_flip(truernd_pool_t *pool) {
+    pool->active = pool->active == pool->words ? pool->spare : pool->words;
+    pool->avail = TRUERND_POOL_WORDS;
+}
+
+#if TRUERND__HAVE_PTHREADS
+
+/* One helper thread refills the shadows of every async pool, in request order */
+static pthread_mutex_t truernd__prefetch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t truernd__prefetch_cond = PTHREAD_COND_INITIALIZER;
+static truernd_pool_t *truernd__prefetch_queue;       /* Oldest request, served first */
+static truernd_pool_t *truernd__prefetch_queue_tail;  /* Newest request, appended to */
+static truernd_pool_t *truernd__prefetch_current;  /* Being filled by the helper, else NULL */
+static int truernd__prefetch_running;
+static pthread_once_t truernd__prefetch_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t truernd__prefetch_key;
+
+static void *
+truernd__prefetch_thread(void *arg) {
+    (void)arg;
+    for (;;) {
+        pthread_mutex_lock(&truernd__prefetch_lock);
+        while (!truernd__prefetch_queue) {
+            pthread_cond_wait(&truernd__prefetch_cond, &truernd__prefetch_lock);
+        }
+        truernd_pool_t *pool = truernd__prefetch_queue;
+        truernd__prefetch_queue = pool->next_pending;
+        if (!truernd__prefetch_queue) truernd__prefetch_queue_tail = NULL;
+        truernd__prefetch_current = pool;
+        pthread_mutex_unlock(&truernd__prefetch_lock);
+
+        /* A failed fill still hands the buffer back; the owner just won't use it */
+        int ok = truernd__fill(pool->shadow, sizeof(pool->words)) == 0;
+
+        /* Once the state leaves PENDING the owner may switch modes and free the
+         * pool, so drop it as current under the lock a fork child takes first */
+        pthread_mutex_lock(&truernd__prefetch_lock);
+        __atomic_store_n(&pool->shadow_state,
+                         ok ? TRUERND__SHADOW_READY : TRUERND__SHADOW_IDLE, __ATOMIC_RELEASE);
+        truernd__prefetch_current = NULL;
+        pthread_mutex_unlock(&truernd__prefetch_lock);
+    }
+    return NULL;
+}
+
+static int
+truernd__prefetch_start(void) {
+    int rc = 0;
+    pthread_mutex_lock(&truernd__prefetch_lock);
+    if (!truernd__prefetch_running) {
+        pthread_t thread;
+        if (pthread_create(&thread, NULL, truernd__prefetch_thread, NULL) == 0) {
+            pthread_detach(thread);
+            truernd__prefetch_running = 1;
+        } else {
+            rc = -1;
+        }
+    }
+    pthread_mutex_unlock(&truernd__prefetch_lock);
+    return rc;
+}
+
+static void
+truernd__prefetch_post(truernd_pool_t *pool) {
+    pool->shadow = pool->active == pool->words ? pool->spare : pool->words;
+    __atomic_store_n(&pool->shadow_state, TRUERND__SHADOW_PENDING, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&truernd__prefetch_lock);
+    pool->next_pending = NULL;
+    if (truernd__prefetch_queue_tail) {
+        truernd__prefetch_queue_tail->next_pending = pool;
+    } else {
+        truernd__prefetch_queue = pool;
+    }
+    truernd__prefetch_queue_tail = pool;
+    pthread_cond_signal(&truernd__prefetch_cond);
+    pthread_mutex_unlock(&truernd__prefetch_lock);
+}
+
+/* Wait out a fill the helper may still be writing into this pool */
+static void
+truernd__prefetch_drain(truernd_pool_t *pool) {
+    while (__atomic_load_n(&pool->shadow_state, __ATOMIC_ACQUIRE) == TRUERND__SHADOW_PENDING) {
+        sched_yield();
+    }
+}
+
+static void
+truernd__prefetch_thread_exit(void *pool) {
+    truernd_pool_set_mode((truernd_pool_t*)pool, TRUERND_POOL_SYNC);
+}
+
+static void
+truernd__prefetch_key_init(void) {
+    pthread_key_create(&truernd__prefetch_key, truernd__prefetch_thread_exit);
+}
+
+#endif /* TRUERND__HAVE_PTHREADS */
+
+/*
+ * Fork and snapshot safety
+ *
+ * Nothing is wiped eagerly. A fork child and truernd_invalidate_all() only
+ * bump the generation, and every buffer (pools, DRBG keys, split words, ring
+ * slots, the C++ engines) is stamped with the generation it was filled
+ * under, so its next draw sees the mismatch and starts over. The hot paths
+ * pay one compare against a shared, read-mostly word.
+ */
+
+uint32_t truernd__generation;
+
+void 
+truernd_invalidate_all(void) {
+    __atomic_fetch_add(&truernd__generation, 1, __ATOMIC_RELAXED);
+}
+
+#if TRUERND__HAVE_PTHREADS
+
+static void
+truernd__atfork_prepare(void) {
+    pthread_mutex_lock(&truernd__prefetch_lock);
+}
+
+static void
+truernd__atfork_parent(void) {
+    pthread_mutex_unlock(&truernd__prefetch_lock);
+}
+
+/* Only the forking thread survives: the prefetch helper is gone, so no
+ * shadow it was asked for will ever arrive */
+static void
+truernd__atfork_child(void) {
+    for (truernd_pool_t *pool = truernd__prefetch_queue; pool; pool = pool->next_pending) {
+        pool->shadow_state = TRUERND__SHADOW_IDLE;
+    }
+    if (truernd__prefetch_current) truernd__prefetch_current->shadow_state = TRUERND__SHADOW_IDLE;
+    truernd__prefetch_queue = NULL;
+    truernd__prefetch_queue_tail = NULL;
+    truernd__prefetch_current = NULL;
+    truernd__prefetch_running = 0;
+    pthread_mutex_unlock(&truernd__prefetch_lock);
+    truernd_invalidate_all();
+}
+
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((constructor)) static void
+truernd__atfork_init(void) {
+    pthread_atfork(truernd__atfork_prepare, truernd__atfork_parent, truernd__atfork_child);
+}
+#endif
+
+#endif /* TRUERND__HAVE_PTHREADS */
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#ifndef MADV_WIPEONFORK
+#define MADV_WIPEONFORK 18
+#endif
+#endif
+
+int 
+truernd_wipe_on_fork(void *mem, size_t len) {
+#if defined(__linux__)
+    long page = sysconf(_SC_PAGESIZE);
+    if (!mem || len == 0 || page <= 0 || ((uintptr_t)mem & (uintptr_t)(page - 1)) != 0) return -1;
+    return madvise(mem, len, MADV_WIPEONFORK) == 0 ? 0 : -1;
+#else
+    (void)mem;
+    (void)len;
+    return -1;
+#endif
+}
+
+/*
+ * Kernel entropy feeding
+ *
+ * <linux/random.h> would redefine the GRND_* flags from <sys/random.h>, so
+ * the ioctl number is spelled out here; the ABI has not changed since 2.6.
+ */
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <time.h>
+#include <sys/ioctl.h>
+#ifndef RNDADDENTROPY
+#define RNDADDENTROPY _IOW('R', 0x03, int[2])
+#endif
+#endif
+
+int 
+truernd_kernel_seeded(void) {
+#if defined(__linux__) && defined(GRND_NONBLOCK)
+    uint8_t probe;
+    for (;;) {
+        if (getrandom(&probe, 1, GRND_NONBLOCK) == 1) return 1;
+        if (errno == EAGAIN) return 0;
+        if (errno != EINTR) return -1;
+    }
+#else
+    return -1;
+#endif
+}
+
+int 
+truernd_feed_kernel(size_t batch, unsigned int interval_ms, unsigned int max_batches) {
+#if defined(__linux__)
+    if (truernd_kernel_seeded() == 1) return 0;
+    if (batch == 0) batch = TRUERND_FEED_BATCH;
+    batch = (batch + 3) & ~(size_t)3;
+    if (batch > (size_t)INT32_MAX / 8 / TRUERND_FEED_CREDIT) return -1;
+
+    /* struct rand_pool_info: entropy_count, buf_size, then the words. Mapped
+     * rather than malloc'd so TRUERND_STATIC_ARENA builds can feed too */
+    size_t size = 2 * sizeof(int) + batch;
+    int *info = (int*)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (info == (int*)MAP_FAILED) return -1;
+    int fd = open("/dev/random", O_WRONLY | O_CLOEXEC);
+
+    int rc = -1;
+    for (unsigned int n = 0; fd >= 0 && (max_batches == 0 || n < max_batches); n++) {
+        if (n > 0 && interval_ms > 0) {
+            struct timespec ts = { (time_t)(interval_ms / 1000), (long)(interval_ms % 1000) * 1000000L };
+            while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+        }
+        if (truernd_fill_backend(TRUERND_BACKEND_HW, info + 2, batch) != 0) break;
+        info[0] = (int)(batch * 8 * TRUERND_FEED_CREDIT);
+        info[1] = (int)batch;
+        int ok = ioctl(fd, RNDADDENTROPY, info) == 0;
+        truernd__wipe(info + 2, batch);
+        if (!ok) break;
+
+        /* Where seeding cannot be observed, one credited batch is the best we can do */
+        if (truernd_kernel_seeded() != 0) {
+            rc = 0;
+            break;
+        }
+    }
+
+    if (fd >= 0) close(fd);
+    munmap(info, size);
+    return rc;
+#else
+    (void)batch;
+    (void)interval_ms;
+    (void)max_batches;
+    return -1;
+#endif
+}
+
+/* Drop everything drawn under an older generation; mode and buffers stay */
+static void
+truernd__pool_renew(truernd_pool_t *pool) {
+#if TRUERND__HAVE_PTHREADS
+    if (pool->mode == TRUERND_POOL_ASYNC) truernd__prefetch_drain(pool);
+#endif
+    truernd__wipe(pool->words, sizeof(pool->words));
+    truernd__wipe(pool->spare, sizeof(pool->spare));
+    pool->avail = 0;
+    pool->rest = 0;
+    pool->rest_bits = 0;
+    pool->shadow_state = TRUERND__SHADOW_IDLE;
+    pool->shadow_filled = 0;
+    pool->gen = TRUERND__GENERATION();
+}
+
+/* Slow path of every draw once avail reaches prefetch_at */
+static int
+truernd__pool_advance(truernd_pool_t *pool) {
+    if (!pool->active) pool->active = pool->words;
+    if (pool->gen != TRUERND__GENERATION()) truernd__pool_renew(pool);
+
+    switch (pool->mode) {
+    case TRUERND_POOL_SLICED: {
+        uint64_t *shadow = pool->active == pool->words ? pool->spare : pool->words;
+        size_t left = TRUERND_POOL_WORDS - pool->shadow_filled;
+        size_t n = pool->avail == 0 ? left : (left < TRUERND_POOL_SLICE_WORDS ? left : TRUERND_POOL_SLICE_WORDS);
+        if (n > 0 && truernd__fill(shadow + pool->shadow_filled, n * sizeof(uint64_t)) == 0) {
+            pool->shadow_filled += n;
+        }
+        if (pool->avail > 0) return 0;  /* Slice failures only matter once we need it */
+        if (pool->shadow_filled < TRUERND_POOL_WORDS) return truernd_pool_refill(pool);
+        truernd__pool_flip(pool);
+        pool->shadow_filled = 0;
+        return 0;
+    }
+#if TRUERND__HAVE_PTHREADS
+    case TRUERND_POOL_ASYNC: {
+        int state = __atomic_load_n(&pool->shadow_state, __ATOMIC_ACQUIRE);
+        if (pool->avail > 0) {
+            if (state == TRUERND__SHADOW_IDLE) truernd__prefetch_post(pool);
+            return 0;
+        }
+        if (state == TRUERND__SHADOW_READY) {
+            truernd__pool_flip(pool);
+            __atomic_store_n(&pool->shadow_state, TRUERND__SHADOW_IDLE, __ATOMIC_RELAXED);
+            return 0;
+        }
+        /* Helper hasn't finished: refill in place rather than wait for it */
+        return truernd_pool_refill(pool);
+    }
+#endif
+    default:
+        return pool->avail == 0 ? truernd_pool_refill(pool) : 0;
+    }
+}
+
+int 
+truernd_pool_set_mode(truernd_pool_t *pool, int mode) {
+    if (!pool) return -1;
+    if (mode != TRUERND_POOL_SYNC && mode != TRUERND_POOL_SLICED && mode != TRUERND_POOL_ASYNC) return -1;
+#if TRUERND__HAVE_PTHREADS
+    if (mode == TRUERND_POOL_ASYNC) {
+        if (truernd__prefetch_start() != 0) return -1;
+        if (pool == &truernd__local_pool) {
+            pthread_once(&truernd__prefetch_key_once, truernd__prefetch_key_init);
+            pthread_setspecific(truernd__prefetch_key, pool);
+        }
+    }
+    if (pool->mode == TRUERND_POOL_ASYNC) truernd__prefetch_drain(pool);
+#else
+    if (mode == TRUERND_POOL_ASYNC) return -1;
+#endif
+
+    /* Drop whatever the shadow held; the active buffer keeps handing out */
+    if (!pool->active) pool->active = pool->words;
+    truernd__wipe(pool->active == pool->words ? pool->spare : pool->words, sizeof(pool->words));
+    pool->shadow_state = TRUERND__SHADOW_IDLE;
+    pool->shadow_filled = 0;
+    pool->mode = mode;
+    pool->prefetch_at = mode == TRUERND_POOL_SYNC ? 0 : TRUERND_POOL_PREFETCH_AT;
+    return 0;
+}
+
+static inline int 
+truernd_pool_get64(truernd_pool_t *pool, uint64_t *out) {
+    if (!pool || !out) return -1;
+    if ((pool->avail <= pool->prefetch_at || pool->gen != TRUERND__GENERATION()) &&
+        truernd__pool_advance(pool) != 0) return -1;
+
+    /* Wipe each word as it leaves so the pool never holds handed-out values */
+    size_t i = --pool->avail;
+    *out = pool->active[i];
+    pool->active[i] = 0;
+    return 0;
+}
+
+/* Narrow draws split words through the same cache as the split getters */
+static inline int
+truernd__pool_take(truernd_pool_t *pool, unsigned int n, uint32_t *out) {
+    truernd__split_t sp = { pool->rest, pool->rest_bits, 0 };
+    uint64_t val = 0;
+    if (sp.avail < n && truernd_pool_get64(pool, &val) != 0) return -1;
+    truernd__split_take(&sp, n, val, out);
+    pool->rest = sp.bits;
+    pool->rest_bits = sp.avail;
+    return 0;
+}
+
+static inline int 
+truernd_pool_get32(truernd_pool_t *pool, uint32_t *out) {
+    if (!out || !pool) return -1;
+    return truernd__pool_take(pool, 32, out);
+}
+
+static inline int 
+truernd_pool_get16(truernd_pool_t *pool, uint16_t *out) {
+    uint32_t val;
+    if (!out || !pool || truernd__pool_take(pool, 16, &val) != 0) return -1;
+    *out = (uint16_t)val;
+    return 0;
+}
+
+static inline int 
+truernd_pool_get8(truernd_pool_t *pool, uint8_t *out) {
+    uint32_t val;
+    if (!out || !pool || truernd__pool_take(pool, 8, &val) != 0) return -1;
+    *out = (uint8_t)val;
+    return 0;
+}
+
+static inline int 
+truernd_fill_fixed(void *buf, size_t len) {
+    truernd_pool_t *pool = truernd_pool_local();
+    unsigned char *p = (unsigned char *)buf;
+    size_t words = (len + 7) / 8;
+
+    if (!buf) return -1;
+    if (len == 0) return 0;
+    if (words > TRUERND_POOL_WORDS) return truernd_fill(buf, len);
+
+    /* Enough words above the prefetch mark: take them all at once */
+    if (pool->avail >= pool->prefetch_at + words && pool->gen == TRUERND__GENERATION()) {
+        uint64_t *src = pool->active + (pool->avail -= words);
+        memcpy(p, src, len);
+        memset(src, 0, words * sizeof(uint64_t));
+        return 0;
+    }
+
+    /* Otherwise draw word by word so the pool refills as it normally would */
+    for (size_t i = 0; i < len; i += 8) {
+        uint64_t val;
+        if (truernd_pool_get64(pool, &val) != 0) return -1;
+        memcpy(p + i, &val, len - i < 8 ? len - i : 8);
+    }
+    return 0;
+}
+
+/*
+ * Shared entropy ring
+ *
+ * Each slot's seq says what the slot holds for the lap of position p that
+ * maps onto it: p means free, p + 1 filled, and p + nslots released for the
+ * next lap. A consumer whose ticket the producer has not reached yet
+ * releases the slot itself, so the producer steps over it rather than
+ * leaving a filled slot nobody holds a ticket for. Slots are shared memory
+ * followed by a release store, so a plain memset is enough to wipe them.
+ * Only the ring's chunk bytes of each slot are ever filled or wiped.
+ */
+
+int 
+truernd_ring_init(truernd_ring_t *ring, truernd_ring_slot_t *slots, size_t nslots,
+                  size_t chunk) {
+    if (!ring || !slots || nslots < 2 || (nslots & (nslots - 1)) != 0) return -1;
+    if (chunk != 8 && chunk != 16 && chunk != 32) return -1;
+
+    memset(ring, 0, sizeof(*ring));
+    ring->slots = slots;
+    ring->mask = nslots - 1;
+    ring->chunk = chunk;
+    ring->low_watermark = nslots / 4;
+    for (size_t i = 0; i < nslots; i++) {
+        slots[i].seq = i;
+        memset(slots[i].data, 0, sizeof(slots[i].data));
+    }
+    return 0;
+}
+
+int 
+truernd_ring_set_low_watermark(truernd_ring_t *ring, size_t low_watermark,
+                               truernd_ring_low_fn on_low, void *arg) {
+    if (!ring) return -1;
+
+    ring->low_watermark = low_watermark;
+    ring->on_low_arg = arg;
+    ring->on_low = on_low;
+    return 0;
+}
+
+size_t 
+truernd_ring_level(const truernd_ring_t *ring) {
+    if (!ring) return 0;
+
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    return head > tail ? (size_t)(head - tail) : 0;
+}
+
+size_t 
+truernd_ring_produce(truernd_ring_t *ring, size_t max_slots) {
+    if (!ring || !ring->slots) return 0;
+
+    uint8_t batch[TRUERND_RING_BATCH * sizeof(ring->slots[0].data)];
+    size_t chunk = ring->chunk;
+    size_t batch_len = TRUERND_RING_BATCH * chunk;
+    uint64_t pos = ring->head;
+    size_t produced = 0;
+    size_t used = batch_len;
+
+    while (produced < max_slots) {
+        truernd_ring_slot_t *slot = &ring->slots[pos & ring->mask];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+
+        if ((int64_t)(seq - pos) < 0) break;  /* Still holds last lap's chunk: full */
+        if (seq == pos) {
+            if (used == batch_len) {
+                if (truernd__fill(batch, batch_len) != 0) break;
+                used = 0;
+            }
+            memcpy(slot->data, batch + used, chunk);
+            truernd__wipe(batch + used, chunk);
+            used += chunk;
+            slot->gen = TRUERND__GENERATION();
+
+            uint64_t expected = pos;
+            if (__atomic_compare_exchange_n(&slot->seq, &expected, pos + 1, 0,
+                                            __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+                produced++;
+            } else {
+                memset(slot->data, 0, chunk);  /* Released under us */
+            }
+        }
+        /* Otherwise seq > pos: a consumer gave up on this position, step over it */
+        pos++;
+        __atomic_store_n(&ring->head, pos, __ATOMIC_RELEASE);
+    }
+
+    if (used < batch_len) truernd__wipe(batch + used, batch_len - used);
+    if (produced > 0) __atomic_store_n(&ring->low_fired, 0, __ATOMIC_RELAXED);
+    return produced;
+}
+
+static void
+truernd__ring_wake(truernd_ring_t *ring);
+
+static int
+truernd__ring_get_slow(truernd_ring_t *ring, truernd_ring_slot_t *slot, uint64_t ticket,
+                       void *out, size_t len) {
+    for (;;) {
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == ticket + 1) break;
+
+        if (seq == ticket) {
+            /* Producer is behind: release the slot and draw directly */
+            if (__atomic_compare_exchange_n(&slot->seq, &seq, ticket + ring->mask + 1, 0,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                return truernd__fill(out, len);
+            }
+            continue;
+        }
+
+        /* A consumer from the previous lap is still resolving this slot */
+        truernd__cpu_relax(1);
+    }
+
+    /* Produced before a fork or invalidation: wipe it and draw directly */
+    if (slot->gen != TRUERND__GENERATION()) {
+        memset(slot->data, 0, len);
+        __atomic_store_n(&slot->seq, ticket + ring->mask + 1, __ATOMIC_RELEASE);
+        return truernd__fill(out, len);
+    }
+
+    memcpy(out, slot->data, len);
+    memset(slot->data, 0, len);
+    __atomic_store_n(&slot->seq, ticket + ring->mask + 1, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static inline int 
+truernd_ring_get(truernd_ring_t *ring, void *out, size_t len) {
+    if (!ring || !out || len != ring->chunk) return -1;
+
+    uint64_t ticket = __atomic_fetch_add(&ring->tail, 1, __ATOMIC_RELAXED);
+    truernd_ring_slot_t *slot = &ring->slots[ticket & ring->mask];
+    int rc;
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == ticket + 1 &&
+        slot->gen == TRUERND__GENERATION()) {
+        memcpy(out, slot->data, len);
+        memset(slot->data, 0, len);
+        __atomic_store_n(&slot->seq, ticket + ring->mask + 1, __ATOMIC_RELEASE);
+        rc = 0;
+    } else {
+        rc = truernd__ring_get_slow(ring, slot, ticket, out, len);
+    }
+
+    /* The check before the exchange keeps the armed flag's line shared */
+    if (truernd_ring_level(ring) <= ring->low_watermark &&
+        !__atomic_load_n(&ring->low_fired, __ATOMIC_RELAXED) &&
+        !__atomic_exchange_n(&ring->low_fired, 1, __ATOMIC_RELAXED)) {
+        if (ring->on_low) ring->on_low(ring, ring->on_low_arg);
+        truernd__ring_wake(ring);
+    }
+    return rc;
+}
+
+#if TRUERND__HAVE_PTHREADS
+
+#include <stdlib.h>
+
+typedef struct truernd__ring_worker {
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    int wake;
+    int stop;
+} truernd__ring_worker;
+
+#if TRUERND_STATIC_ARENA > 0
+
+/* Producers come from a fixed table, claimed with an atomic flag per entry */
+static truernd__ring_worker truernd__ring_workers[TRUERND_STATIC_ARENA];
+static int truernd__ring_worker_used[TRUERND_STATIC_ARENA];
+
+static truernd__ring_worker *
+truernd__ring_worker_alloc(void) {
+    for (size_t i = 0; i < TRUERND_STATIC_ARENA; i++) {
+        if (!__atomic_exchange_n(&truernd__ring_worker_used[i], 1, __ATOMIC_ACQUIRE)) {
+            memset(&truernd__ring_workers[i], 0, sizeof(truernd__ring_workers[i]));
+            return &truernd__ring_workers[i];
+        }
+    }
+    return NULL;
+}
+
+static void
+truernd__ring_worker_free(truernd__ring_worker *w) {
+    __atomic_store_n(&truernd__ring_worker_used[w - truernd__ring_workers], 0, __ATOMIC_RELEASE);
+}
+
+#else
+
+static truernd__ring_worker *
+truernd__ring_worker_alloc(void) {
+    return (truernd__ring_worker*)calloc(1, sizeof(truernd__ring_worker));
+}
+
+static void
+truernd__ring_worker_free(truernd__ring_worker *w) {
+    free(w);
+}
+
+#endif /* TRUERND_STATIC_ARENA */
+
+static void
+truernd__ring_wake(truernd_ring_t *ring) {
+    truernd__ring_worker *w = (truernd__ring_worker*)__atomic_load_n(&ring->worker, __ATOMIC_ACQUIRE);
+    if (!w) return;
+
+    pthread_mutex_lock(&w->lock);
+    w->wake = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+}
+
+static void *
+truernd__ring_thread(void *arg) {
+    truernd_ring_t *ring = (truernd_ring_t*)arg;
+    truernd__ring_worker *w = (truernd__ring_worker*)ring->worker;
+
+    for (;;) {
+        size_t produced = truernd_ring_produce(ring, (size_t)ring->mask + 1);
+
+        /* Nothing produced means full (or a failed fill): sleep until woken */
+        pthread_mutex_lock(&w->lock);
+        while (!w->stop && !w->wake && produced == 0) {
+            pthread_cond_wait(&w->cond, &w->lock);
+        }
+        int stop = w->stop;
+        w->wake = 0;
+        pthread_mutex_unlock(&w->lock);
+        if (stop) return NULL;
+    }
+}
+
+int 
+truernd_ring_start(truernd_ring_t *ring) {
+    if (!ring || !ring->slots || ring->worker) return -1;
+
+    truernd__ring_worker *w = truernd__ring_worker_alloc();
+    if (!w) return -1;
+    if (pthread_mutex_init(&w->lock, NULL) != 0) {
+        truernd__ring_worker_free(w);
+        return -1;
+    }
+    if (pthread_cond_init(&w->cond, NULL) != 0) {
+        pthread_mutex_destroy(&w->lock);
+        truernd__ring_worker_free(w);
+        return -1;
+    }
+
+    __atomic_store_n(&ring->worker, (void*)w, __ATOMIC_RELEASE);
+    if (pthread_create(&w->thread, NULL, truernd__ring_thread, ring) != 0) {
+        __atomic_store_n(&ring->worker, NULL, __ATOMIC_RELEASE);
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        truernd__ring_worker_free(w);
+        return -1;
+    }
+    return 0;
+}
+
+void 
+truernd_ring_stop(truernd_ring_t *ring) {
+    if (!ring || !ring->worker) return;
+
+    truernd__ring_worker *w = (truernd__ring_worker*)ring->worker;
+    pthread_mutex_lock(&w->lock);
+    w->stop = 1;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+    pthread_join(w->thread, NULL);
+
+    __atomic_store_n(&ring->worker, NULL, __ATOMIC_RELEASE);
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    truernd__ring_worker_free(w);
+}
+
+#else
+
+static void
+truernd__ring_wake(truernd_ring_t *ring) {
+    (void)ring;
+}
+
+int 
+truernd_ring_start(truernd_ring_t *ring) {
+    (void)ring;
+    return -1;
+}
+
+void 
+truernd_ring_stop(truernd_ring_t *ring) {
+    (void)ring;
+}
+
+#endif /* TRUERND__HAVE_PTHREADS */
+
+/*
+ * NUMA-local rings
+ *
+ * Node ids come from getcpu(), which reports the node directly, and the
+ * CPU lists in /sys/devices/system/node. No libnuma: mbind() and the
+ * affinity calls go through syscall(), so the header still needs nothing
+ * beyond _DEFAULT_SOURCE.
+ */
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/syscall.h>
+#endif
+
+#define TRUERND__CPU_MASK_WORDS 16  /* 1024 CPUs */
+
+/* Thread's cached node and the calls left before asking again */
+typedef struct truernd__node_cache {
+    unsigned int node;
+    unsigned int left;
+} truernd__node_cache;
+
+static TRUERND_TLS truernd__node_cache truernd__node_local;
+
+#if defined(__linux__)
+
+/* Read a small sysfs file into buf, NUL-terminated; 0 on success */
+static int
+truernd__read_sysfs(const char *path, char *buf, size_t size) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return -1;
+    ssize_t n = read(fd, buf, size - 1);
+    close(fd);
+    if (n <= 0) return -1;
+    buf[n] = '\0';
+    return 0;
+}
+
+/* Parse a kernel list like "0-3,8,10-11" into a bitmask; returns the highest id or -1 */
+static long
+truernd__parse_list(const char *p, unsigned long *mask, size_t words) {
+    long highest = -1;
+    while (*p >= '0' && *p <= '9') {
+        unsigned long lo = 0, hi;
+        while (*p >= '0' && *p <= '9') lo = lo * 10 + (unsigned long)(*p++ - '0');
+        hi = lo;
+        if (*p == '-') {
+            p++;
+            hi = 0;
+            while (*p >= '0' && *p <= '9') hi = hi * 10 + (unsigned long)(*p++ - '0');
+        }
+        for (unsigned long i = lo; i <= hi && i < words * 8 * sizeof(unsigned long); i++) {
+            if (mask) mask[i / (8 * sizeof(unsigned long))] |= 1ul << (i % (8 * sizeof(unsigned long)));
+        }
+        if ((long)hi > highest) highest = (long)hi;
+        if (*p == ',') p++;
+    }
+    return highest;
+}
+
+#endif /* __linux__ */
+
+unsigned int 
+truernd_numa_nodes(void) {
+#if defined(__linux__)
+    static unsigned int cached;
+    unsigned int n = TRUERND__LOAD_RELAXED(&cached);
+    if (n) return n;
+
+    char buf[256];
+    long highest = -1;
+    if (truernd__read_sysfs("/sys/devices/system/node/online", buf, sizeof(buf)) == 0) {
+        highest = truernd__parse_list(buf, NULL, 0);
+    }
+    n = highest < 0 ? 1 : (unsigned int)highest + 1;
+    if (n > TRUERND_MAX_NODES) n = TRUERND_MAX_NODES;
+    TRUERND__STORE_RELAXED(&cached, n);
+    return n;
+#else
+    return 1;
+#endif
+}
+
+static unsigned int
+truernd__numa_node_slow(void) {
+    truernd__node_cache *nc = &truernd__node_local;
+    unsigned int node = 0;
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) != 0) node = 0;
+#endif
+    nc->node = node;
+    nc->left = TRUERND_NODE_RECHECK;
+    return node;
+}
+
+static inline unsigned int 
+truernd_numa_node(void) {
+    truernd__node_cache *nc = &truernd__node_local;
+    if (nc->left == 0) return truernd__numa_node_slow();
+    nc->left--;
+    return nc->node;
+}
+
+static inline int 
+truernd_ring_group_get(truernd_ring_group_t *group, void *out, size_t len) {
+    if (!group || group->nnodes == 0) return -1;
+
+    unsigned int node = truernd_numa_node();
+    return truernd_ring_get(group->rings[node < group->nnodes ? node : 0], out, len);
+}
+
+#if TRUERND__HAVE_PTHREADS
+
+#include <sys/mman.h>
+
+#define TRUERND__MPOL_PREFERRED 1
+
+int 
+truernd_ring_group_init(truernd_ring_group_t *group, size_t nslots, size_t chunk) {
+    if (!group || nslots < 2 || (nslots & (nslots - 1)) != 0) return -1;
+    if (chunk != 8 && chunk != 16 && chunk != 32) return -1;
+
+    memset(group, 0, sizeof(*group));
+    long page = sysconf(_SC_PAGESIZE);
+    size_t head = (sizeof(truernd_ring_t) + TRUERND_CACHE_LINE - 1) & ~(size_t)(TRUERND_CACHE_LINE - 1);
+    size_t len = head + nslots * sizeof(truernd_ring_slot_t);
+    if (page > 0) len = (len + (size_t)page - 1) & ~((size_t)page - 1);
+    group->map_len = len;
+
+    unsigned int nnodes = truernd_numa_nodes();
+    for (unsigned int node = 0; node < nnodes; node++) {
+        void *mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mem == MAP_FAILED) {
+            truernd_ring_group_free(group);
+            return -1;
+        }
+#if defined(__linux__) && defined(SYS_mbind)
+        /* Best effort: without it first touch below still places the pages somewhere sane */
+        unsigned long nodemask[1] = { 1ul << node };
+        (void)syscall(SYS_mbind, mem, len, TRUERND__MPOL_PREFERRED, nodemask,
+                      (unsigned long)(8 * sizeof(nodemask)), 0u);
+#endif
+        truernd_ring_t *ring = (truernd_ring_t*)mem;
+        truernd_ring_init(ring, (truernd_ring_slot_t*)((uint8_t*)mem + head), nslots, chunk);
+        group->rings[node] = ring;
+        group->nnodes = node + 1;
+    }
+    return 0;
+}
+
+/* Start a ring's producer with the calling thread temporarily pinned to
+ * node's CPUs; the new thread inherits the mask */
+static int
+truernd__ring_start_on(truernd_ring_t *ring, unsigned int node) {
+#if defined(__linux__) && defined(SYS_sched_getaffinity) && defined(SYS_sched_setaffinity)
+    unsigned long saved[TRUERND__CPU_MASK_WORDS] = {0}, mask[TRUERND__CPU_MASK_WORDS] = {0};
+    char path[64] = "/sys/devices/system/node/node", digits[12], buf[1024];
+    size_t at = strlen(path), nd = 0;
+    int pinned = 0;
+
+    do digits[nd++] = (char)('0' + node % 10); while ((node /= 10) != 0);
+    while (nd > 0) path[at++] = digits[--nd];
+    memcpy(path + at, "/cpulist", sizeof("/cpulist"));
+    if (truernd__read_sysfs(path, buf, sizeof(buf)) == 0 &&
+        truernd__parse_list(buf, mask, TRUERND__CPU_MASK_WORDS) >= 0 &&
+        syscall(SYS_sched_getaffinity, 0, sizeof(saved), saved) > 0) {
+        pinned = syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) == 0;
+    }
+    int rc = truernd_ring_start(ring);
+    if (pinned) (void)syscall(SYS_sched_setaffinity, 0, sizeof(saved), saved);
+    return rc;
+#else
+    (void)node;
+    return truernd_ring_start(ring);
+#endif
+}
+
+int 
+truernd_ring_group_start(truernd_ring_group_t *group) {
+    if (!group || group->nnodes == 0) return -1;
+
+    for (unsigned int node = 0; node < group->nnodes; node++) {
+        if (!group->rings[node]->worker && truernd__ring_start_on(group->rings[node], node) != 0) return -1;
+    }
+    return 0;
+}
+
+void 
+truernd_ring_group_free(truernd_ring_group_t *group) {
+    if (!group) return;
+
+    for (unsigned int node = 0; node < group->nnodes; node++) {
+        truernd_ring_t *ring = group->rings[node];
+        if (!ring) continue;
+        truernd_ring_stop(ring);
+        truernd__wipe(ring, group->map_len);
+        munmap(ring, group->map_len);
+    }
+    memset(group, 0, sizeof(*group));
+}
+
+#else
+
+int 
+truernd_ring_group_init(truernd_ring_group_t *group, size_t nslots, size_t chunk) {
+    (void)group;
+    (void)nslots;
+    (void)chunk;
+    return -1;
+}
+
+int 
+truernd_ring_group_start(truernd_ring_group_t *group) {
+    (void)group;
+    return -1;
+}
+
+void 
+truernd_ring_group_free(truernd_ring_group_t *group) {
+    (void)group;
+}
+
+#endif /* TRUERND__HAVE_PTHREADS */
+
+/*
+ * Caller-owned contexts
+ *
+ * A context is a pool and a DRBG laid out in memory the caller supplies,
+ * either its own buffer or a slot of the static arena. Nothing here
+ * allocates; the draw paths are the pool's and the DRBG's own.
+ */
+
+#define TRUERND__CTX_MAGIC 0x74726e63u  /* "trnc" */
+
+truernd_ctx_t *
+truernd_ctx_init(void *mem, size_t size) {
+    if (!mem) return NULL;
+
+    uintptr_t at = ((uintptr_t)mem + TRUERND_CACHE_LINE - 1) & ~(uintptr_t)(TRUERND_CACHE_LINE - 1);
+    if (size < (size_t)(at - (uintptr_t)mem) + sizeof(truernd_ctx_t)) return NULL;
+
+    truernd_ctx_t *ctx = (truernd_ctx_t*)at;
+    memset(ctx, 0, sizeof(*ctx));
+    truernd_pool_init(&ctx->pool);
+    ctx->magic = TRUERND__CTX_MAGIC;
+    return ctx;
+}
+
+static inline int 
+truernd_ctx_get64(truernd_ctx_t *ctx, uint64_t *out) {
+    if (!ctx || ctx->magic != TRUERND__CTX_MAGIC) return -1;
+    return truernd_pool_get64(&ctx->pool, out);
+}
+
+static inline int 
+truernd_ctx_get32(truernd_ctx_t *ctx, uint32_t *out) {
+    if (!ctx || ctx->magic != TRUERND__CTX_MAGIC) return -1;
+    return truernd_pool_get32(&ctx->pool, out);
+}
+
+int 
+truernd_ctx_fill(truernd_ctx_t *ctx, void *buf, size_t len) {
+    if (!ctx || ctx->magic != TRUERND__CTX_MAGIC) return -1;
+
+    if (ctx->drbg.reseed_interval == 0) {
+        int cipher = truernd_backend_available(TRUERND_BACKEND_DRBG_AES) ? TRUERND_DRBG_AES256
+                                                                          : TRUERND_DRBG_CHACHA20;
+        if (truernd_drbg_init_ex(&ctx->drbg, 0, cipher) != 0) return -1;
+    }
+    return truernd_drbg_fill(&ctx->drbg, buf, len);
+}
+
+void 
+truernd_ctx_destroy(truernd_ctx_t *ctx) {
+    if (ctx) truernd__wipe(ctx, sizeof(*ctx));
+}
+
+#if TRUERND_STATIC_ARENA > 0
+
+static truernd_ctx_t truernd__arena[TRUERND_STATIC_ARENA];
+static int truernd__arena_used[TRUERND_STATIC_ARENA];
 
-        "str w1, [x0]             \n\t"
-        "mov w0, #0               \n\t"
-        "ret                      \n\t"
-    "1:                           \n\t"
-        "mov w0, #-1              \n\t"
-        "ret                      \n\t"
-    );
+truernd_ctx_t *
+truernd_ctx_acquire(void) {
+    for (size_t i = 0; i < TRUERND_STATIC_ARENA; i++) {
+        if (!__atomic_exchange_n(&truernd__arena_used[i], 1, __ATOMIC_ACQUIRE)) {
+            return truernd_ctx_init(&truernd__arena[i], sizeof(truernd__arena[i]));
+        }
+    }
+    return NULL;
 }
 
-NAKED int 
-truernd_get64(uint64_t *out) {
-    __asm__ volatile(
-        "cbz x0, 1f               \n\t"
+void 
+truernd_ctx_release(truernd_ctx_t *ctx) {
+    if (!ctx || ctx < truernd__arena || ctx >= truernd__arena + TRUERND_STATIC_ARENA) return;
 
-        "mrs x1, RNDR             \n\t"
-        "b.eq 1f                  \n\t"
+    truernd_ctx_destroy(ctx);
+    __atomic_store_n(&truernd__arena_used[ctx - truernd__arena], 0, __ATOMIC_RELEASE);
+}
 
-        "str x1, [x0]             \n\t"
-        "mov w0, #0               \n\t"
-        "ret                      \n\t"
-    "1:                           \n\t"
-        "mov w0, #-1              \n\t"
-        "ret                      \n\t"
-    );
+#else
+
+truernd_ctx_t *
+truernd_ctx_acquire(void) {
+    return NULL;
 }
 
-#else /* 32-bit ARM - RNDR not available */
+void 
+truernd_ctx_release(truernd_ctx_t *ctx) {
+    (void)ctx;
+}
 
-NAKED int 
-truernd_is_supported(void) {
-    __asm__ volatile(
-        "mov r0, #0               \n\t"
-        "bx lr                    \n\t"
-    );
+#endif /* TRUERND_STATIC_ARENA */
+
+/*
+ * Bounded integers and floating point
+ */
+
+/* High and low halves of a 64x64-bit product */
+static inline uint64_t
+truernd__mul64(uint64_t a, uint64_t b, uint64_t *lo) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 m = (unsigned __int128)a * b;
+    *lo = (uint64_t)m;
+    return (uint64_t)(m >> 64);
+#else
+    uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+    uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+    uint64_t p0 = a_lo * b_lo, p1 = a_lo * b_hi, p2 = a_hi * b_lo, p3 = a_hi * b_hi;
+    uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+    *lo = (mid << 32) | (uint32_t)p0;
+    return p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+#endif
 }
 
-NAKED int 
-truernd_get32(uint32_t *out) {
-    __asm__ volatile(
-        "mov r0, #-1              \n\t"
-        "bx lr                    \n\t"
-    );
+static inline uint32_t 
+truernd_uniform_u32(uint32_t bound) {
+    truernd_pool_t *pool = truernd_pool_local();
+    uint32_t x;
+    if (bound == 0 || truernd_pool_get32(pool, &x) != 0) return 0;
+
+    uint64_t m = (uint64_t)x * bound;
+    uint32_t l = (uint32_t)m;
+    if (l < bound) {
+        uint32_t t = (uint32_t)-bound % bound;
+        while (l < t) {
+            if (truernd_pool_get32(pool, &x) != 0) return 0;
+            m = (uint64_t)x * bound;
+            l = (uint32_t)m;
+        }
+    }
+    return (uint32_t)(m >> 32);
 }
 
-NAKED int 
-truernd_get64(uint64_t *out) {
-    __asm__ volatile(
-        "mov r0, #-1              \n\t"
-        "bx lr                    \n\t"
-    );
+static inline uint64_t 
+truernd_uniform_u64(uint64_t bound) {
+    truernd_pool_t *pool = truernd_pool_local();
+    uint64_t x, l;
+    if (bound == 0 || truernd_pool_get64(pool, &x) != 0) return 0;
+
+    uint64_t h = truernd__mul64(x, bound, &l);
+    if (l < bound) {
+        uint64_t t = -bound % bound;
+        while (l < t) {
+            if (truernd_pool_get64(pool, &x) != 0) return 0;
+            h = truernd__mul64(x, bound, &l);
+        }
+    }
+    return h;
 }
 
-NAKED uint32_t 
-truernd_gen32(void) {
-    __asm__ volatile(
-        "mov r0, #0               \n\t"
-        "bx lr                    \n\t"
-    );
+static inline double 
+truernd_double01(void) {
+    uint64_t x;
+    if (truernd_pool_get64(truernd_pool_local(), &x) != 0) return 0.0;
+    return (double)(x >> 11) * 0x1.0p-53;
 }
 
-NAKED  uint64_t 
-truernd_gen64(void) {
-    __asm__ volatile(
-        "mov r0, #0               \n\t"
-        "mov r1, #0               \n\t"
-        "bx lr                    \n\t"
-    );
+static inline float 
+truernd_float01(void) {
+    uint32_t x;
+    if (truernd_pool_get32(truernd_pool_local(), &x) != 0) return 0.0f;
+    return (float)(x >> 8) * 0x1.0p-24f;
 }
 
-#endif /* __aarch64__ */
+/*
+ * Batch conversion kernels
+ *
+ * Arrays are filled with raw words first and converted in place. Bounded
+ * lanes that hit Lemire's rejection zone are set to the bound itself, which
+ * no accepted lane can equal, and redrawn afterwards.
+ */
 
-/* Unsupported architecture */
-#else
+/* Reduce x[0..n) in place, returning the number of rejected lanes */
+static size_t
+truernd__bounded_u32_scalar(uint32_t *x, size_t n, uint32_t bound, uint32_t t) {
+    size_t rejected = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t m = (uint64_t)x[i] * bound;
+        int reject = (uint32_t)m < t;
+        x[i] = reject ? bound : (uint32_t)(m >> 32);
+        rejected += (size_t)reject;
+    }
+    return rejected;
+}
+
+static void
+truernd__double_scalar(uint64_t *x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        double d = (double)(x[i] >> 11) * 0x1.0p-53;
+        memcpy(&x[i], &d, sizeof(d));
+    }
+}
+
+static void
+truernd__float_scalar(uint32_t *x, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        float f = (float)(x[i] >> 8) * 0x1.0p-24f;
+        memcpy(&x[i], &f, sizeof(f));
+    }
+}
+
+#if TRUERND__HAVE_X86_SIMD
+
+/* g++ 12 flags the _mm512_undefined_* placeholders inside the intrinsics at -O2 */
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+__attribute__((target("avx2"))) static size_t
+truernd__bounded_u32_avx2(uint32_t *x, size_t n, uint32_t bound, uint32_t t) {
+    const __m256i vb = _mm256_set1_epi32((int)bound);
+    const __m256i sign = _mm256_set1_epi32((int)0x80000000u);
+    const __m256i vt = _mm256_xor_si256(_mm256_set1_epi32((int)t), sign);
+    size_t rejected = 0, i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(x + i));
+        __m256i even = _mm256_mul_epu32(v, vb);
+        __m256i odd = _mm256_mul_epu32(_mm256_srli_epi64(v, 32), vb);
+        __m256i hi = _mm256_blend_epi32(_mm256_srli_epi64(even, 32), odd, 0xAA);
+        __m256i lo = _mm256_blend_epi32(even, _mm256_slli_epi64(odd, 32), 0xAA);
+        __m256i rej = _mm256_cmpgt_epi32(vt, _mm256_xor_si256(lo, sign));
+        _mm256_storeu_si256((__m256i*)(x + i), _mm256_blendv_epi8(hi, vb, rej));
+        rejected += (size_t)__builtin_popcount((unsigned int)_mm256_movemask_ps(_mm256_castsi256_ps(rej)));
+    }
+    return rejected + truernd__bounded_u32_scalar(x + i, n - i, bound, t);
+}
+
+__attribute__((target("avx512f"))) static size_t
+truernd__bounded_u32_avx512(uint32_t *x, size_t n, uint32_t bound, uint32_t t) {
+    const __m512i vb = _mm512_set1_epi32((int)bound);
+    const __m512i vt = _mm512_set1_epi32((int)t);
+    size_t rejected = 0, i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_loadu_si512((const void*)(x + i));
+        __m512i even = _mm512_mul_epu32(v, vb);
+        __m512i odd = _mm512_mul_epu32(_mm512_srli_epi64(v, 32), vb);
+        __m512i hi = _mm512_mask_blend_epi32(0xAAAA, _mm512_srli_epi64(even, 32), odd);
+        __m512i lo = _mm512_mask_blend_epi32(0xAAAA, even, _mm512_slli_epi64(odd, 32));
+        __mmask16 rej = _mm512_cmplt_epu32_mask(lo, vt);
+        _mm512_storeu_si512((void*)(x + i), _mm512_mask_mov_epi32(hi, rej, vb));
+        rejected += (size_t)__builtin_popcount((unsigned int)rej);
+    }
+    return rejected + truernd__bounded_u32_scalar(x + i, n - i, bound, t);
+}
+
+/* Exact u53 -> double: split at bit 32 and let two magic exponents do the conversion */
+__attribute__((target("avx2"))) static void
+truernd__double_avx2(uint64_t *x, size_t n) {
+    const __m256i lo_mask = _mm256_set1_epi64x(0xFFFFFFFFll);
+    const __m256i lo_magic = _mm256_set1_epi64x(0x4330000000000000ll);    /* 2^52 */
+    const __m256i hi_magic = _mm256_set1_epi64x(0x4530000000000000ll);    /* 2^84 */
+    const __m256d both = _mm256_set1_pd(0x1.0p84 + 0x1.0p52);
+    const __m256d scale = _mm256_set1_pd(0x1.0p-53);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        __m256i v = _mm256_srli_epi64(_mm256_loadu_si256((const __m256i*)(x + i)), 11);
+        __m256d lo = _mm256_castsi256_pd(_mm256_or_si256(_mm256_and_si256(v, lo_mask), lo_magic));
+        __m256d hi = _mm256_castsi256_pd(_mm256_or_si256(_mm256_srli_epi64(v, 32), hi_magic));
+        __m256d d = _mm256_add_pd(_mm256_sub_pd(hi, both), lo);
+        _mm256_storeu_pd((double*)(x + i), _mm256_mul_pd(d, scale));
+    }
+    truernd__double_scalar(x + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static void
+truernd__double_avx512(uint64_t *x, size_t n) {
+    const __m512i lo_mask = _mm512_set1_epi64(0xFFFFFFFFll);
+    const __m512i lo_magic = _mm512_set1_epi64(0x4330000000000000ll);
+    const __m512i hi_magic = _mm512_set1_epi64(0x4530000000000000ll);
+    const __m512d both = _mm512_set1_pd(0x1.0p84 + 0x1.0p52);
+    const __m512d scale = _mm512_set1_pd(0x1.0p-53);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m512i v = _mm512_srli_epi64(_mm512_loadu_si512((const void*)(x + i)), 11);
+        __m512d lo = _mm512_castsi512_pd(_mm512_or_si512(_mm512_and_si512(v, lo_mask), lo_magic));
+        __m512d hi = _mm512_castsi512_pd(_mm512_or_si512(_mm512_srli_epi64(v, 32), hi_magic));
+        __m512d d = _mm512_add_pd(_mm512_sub_pd(hi, both), lo);
+        _mm512_storeu_pd((double*)(x + i), _mm512_mul_pd(d, scale));
+    }
+    truernd__double_scalar(x + i, n - i);
+}
+
+__attribute__((target("avx2"))) static void
+truernd__float_avx2(uint32_t *x, size_t n) {
+    const __m256 scale = _mm256_set1_ps(0x1.0p-24f);
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_srli_epi32(_mm256_loadu_si256((const __m256i*)(x + i)), 8);
+        _mm256_storeu_ps((float*)(x + i), _mm256_mul_ps(_mm256_cvtepi32_ps(v), scale));
+    }
+    truernd__float_scalar(x + i, n - i);
+}
+
+__attribute__((target("avx512f"))) static void
+truernd__float_avx512(uint32_t *x, size_t n) {
+    const __m512 scale = _mm512_set1_ps(0x1.0p-24f);
+    size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_srli_epi32(_mm512_loadu_si512((const void*)(x + i)), 8);
+        _mm512_storeu_ps((float*)(x + i), _mm512_mul_ps(_mm512_cvtepi32_ps(v), scale));
+    }
+    truernd__float_scalar(x + i, n - i);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif /* TRUERND__HAVE_X86_SIMD */
+
+#if TRUERND__HAVE_NEON
+
+static size_t
+truernd__bounded_u32_neon(uint32_t *x, size_t n, uint32_t bound, uint32_t t) {
+    const uint32x4_t vb = vdupq_n_u32(bound);
+    const uint32x4_t vt = vdupq_n_u32(t);
+    const uint32x2_t vb2 = vdup_n_u32(bound);
+    size_t rejected = 0, i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t v = vld1q_u32(x + i);
+        uint64x2_t m0 = vmull_u32(vget_low_u32(v), vb2);
+        uint64x2_t m1 = vmull_u32(vget_high_u32(v), vb2);
+        uint32x4_t hi = vcombine_u32(vshrn_n_u64(m0, 32), vshrn_n_u64(m1, 32));
+        uint32x4_t lo = vcombine_u32(vmovn_u64(m0), vmovn_u64(m1));
+        uint32x4_t rej = vcltq_u32(lo, vt);
+        vst1q_u32(x + i, vbslq_u32(rej, vb, hi));
+        rejected += vaddvq_u32(vshrq_n_u32(rej, 31));
+    }
+    return rejected + truernd__bounded_u32_scalar(x + i, n - i, bound, t);
+}
+
+static void
+truernd__double_neon(uint64_t *x, size_t n) {
+    const float64x2_t scale = vdupq_n_f64(0x1.0p-53);
+    size_t i = 0;
+
+    for (; i + 2 <= n; i += 2) {
+        uint64x2_t v = vshrq_n_u64(vld1q_u64(x + i), 11);
+        vst1q_f64((double*)(x + i), vmulq_f64(vcvtq_f64_u64(v), scale));
+    }
+    truernd__double_scalar(x + i, n - i);
+}
+
+static void
+truernd__float_neon(uint32_t *x, size_t n) {
+    const float32x4_t scale = vdupq_n_f32(0x1.0p-24f);
+    size_t i = 0;
+
+    for (; i + 4 <= n; i += 4) {
+        uint32x4_t v = vshrq_n_u32(vld1q_u32(x + i), 8);
+        vst1q_f32((float*)(x + i), vmulq_f32(vcvtq_f32_u32(v), scale));
+    }
+    truernd__float_scalar(x + i, n - i);
+}
+
+#endif /* TRUERND__HAVE_NEON */
 
 int 
-truernd_is_supported(void) {
+truernd_fill_u32_bounded(uint32_t *out, size_t n, uint32_t bound) {
+    if (!out || n == 0 || bound == 0 || n > SIZE_MAX / sizeof(*out)) return -1;
+    if (truernd__fill(out, n * sizeof(*out)) != 0) return -1;
+
+    uint32_t t = (uint32_t)-bound % bound;
+    size_t rejected;
+#if TRUERND__HAVE_X86_SIMD
+    unsigned int caps = truernd_capabilities();
+    if (caps & TRUERND_CAP_AVX512)      rejected = truernd__bounded_u32_avx512(out, n, bound, t);
+    else if (caps & TRUERND_CAP_AVX2)   rejected = truernd__bounded_u32_avx2(out, n, bound, t);
+    else                                rejected = truernd__bounded_u32_scalar(out, n, bound, t);
+#elif TRUERND__HAVE_NEON
+    rejected = truernd__bounded_u32_neon(out, n, bound, t);
+#else
+    rejected = truernd__bounded_u32_scalar(out, n, bound, t);
+#endif
+
+    /* Second pass: redraw the rejected lanes, stopping once all are found */
+    for (size_t i = 0; rejected > 0 && i < n; i++) {
+        if (out[i] != bound) continue;
+        uint32_t x;
+        uint64_t m;
+        do {
+            if (truernd_pool_get32(truernd_pool_local(), &x) != 0) return -1;
+            m = (uint64_t)x * bound;
+        } while ((uint32_t)m < t);
+        out[i] = (uint32_t)(m >> 32);
+        rejected--;
+    }
     return 0;
 }
 
 int 
-truernd_get32(uint32_t *out) {
-    (void)out;
-    return -1;
+truernd_fill_double(double *out, size_t n) {
+    if (!out || n == 0 || n > SIZE_MAX / sizeof(*out)) return -1;
+    if (truernd__fill(out, n * sizeof(*out)) != 0) return -1;
+
+    uint64_t *x = (uint64_t*)(void*)out;
+#if TRUERND__HAVE_X86_SIMD
+    unsigned int caps = truernd_capabilities();
+    if (caps & TRUERND_CAP_AVX512)      truernd__double_avx512(x, n);
+    else if (caps & TRUERND_CAP_AVX2)   truernd__double_avx2(x, n);
+    else                                truernd__double_scalar(x, n);
+#elif TRUERND__HAVE_NEON
+    truernd__double_neon(x, n);
+#else
+    truernd__double_scalar(x, n);
+#endif
+    return 0;
 }
 
 int 
-truernd_get64(uint64_t *out) {
-    (void)out;
-    return -1;
+truernd_fill_float(float *out, size_t n) {
+    if (!out || n == 0 || n > SIZE_MAX / sizeof(*out)) return -1;
+    if (truernd__fill(out, n * sizeof(*out)) != 0) return -1;
+
+    uint32_t *x = (uint32_t*)(void*)out;
+#if TRUERND__HAVE_X86_SIMD
+    unsigned int caps = truernd_capabilities();
+    if (caps & TRUERND_CAP_AVX512)      truernd__float_avx512(x, n);
+    else if (caps & TRUERND_CAP_AVX2)   truernd__float_avx2(x, n);
+    else                                truernd__float_scalar(x, n);
+#elif TRUERND__HAVE_NEON
+    truernd__float_neon(x, n);
+#else
+    truernd__float_scalar(x, n);
+#endif
+    return 0;
 }
 
-uint32_t 
-truernd_gen32(void) {
+/*
+ * Identifiers and tokens
+ *
+ * Raw bytes come from the thread-local pool. Hex digits are a 16-entry table
+ * lookup (PSHUFB / TBL); base64url uses Mula's SSSE3 reshuffle or a NEON
+ * de-interleaving load. The scalar loops handle tails and other targets.
+ */
+
+static const char truernd__hex_digits[17] = "0123456789abcdef";
+static const char truernd__b64url_digits[65] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+
+/* 16 bytes to 32 lowercase hex digits */
+static void
+truernd__hex16_scalar(char *dst, const uint8_t *src) {
+    for (int i = 0; i < 16; i++) {
+        dst[2 * i]     = truernd__hex_digits[src[i] >> 4];
+        dst[2 * i + 1] = truernd__hex_digits[src[i] & 0x0f];
+    }
+}
+
+#if TRUERND__HAVE_X86_SIMD
+
+__attribute__((target("ssse3"))) static void
+truernd__hex16_ssse3(char *dst, const uint8_t *src) {
+    const __m128i lut = _mm_loadu_si128((const __m128i*)(const void*)truernd__hex_digits);
+    const __m128i nibble = _mm_set1_epi8(0x0f);
+    __m128i in = _mm_loadu_si128((const __m128i*)(const void*)src);
+    __m128i hi = _mm_shuffle_epi8(lut, _mm_and_si128(_mm_srli_epi16(in, 4), nibble));
+    __m128i lo = _mm_shuffle_epi8(lut, _mm_and_si128(in, nibble));
+    _mm_storeu_si128((__m128i*)(void*)dst, _mm_unpacklo_epi8(hi, lo));
+    _mm_storeu_si128((__m128i*)(void*)(dst + 16), _mm_unpackhi_epi8(hi, lo));
+}
+
+/* 12 bytes to 16 digits; reads 16 bytes of src */
+__attribute__((target("ssse3"))) static void
+truernd__b64url12_ssse3(char *dst, const uint8_t *src) {
+    __m128i in = _mm_loadu_si128((const __m128i*)(const void*)src);
+
+    /* Each 32-bit lane gets bytes 1,0,2,1 of its group, then the 6-bit
+     * fields are moved into place with one multiply-high and one multiply-low */
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1));
+    __m128i ac = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)),
+                                 _mm_set1_epi32(0x04000040));
+    __m128i bd = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)),
+                                 _mm_set1_epi32(0x01000010));
+    __m128i idx = _mm_or_si128(ac, bd);
+
+    /* Map 0-25, 26-51, 52-61, 62, 63 to the offset that turns each into its digit */
+    __m128i range = _mm_subs_epu8(idx, _mm_set1_epi8(51));
+    range = _mm_or_si128(range, _mm_and_si128(_mm_cmpgt_epi8(_mm_set1_epi8(26), idx),
+                                              _mm_set1_epi8(13)));
+    const __m128i offsets = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                          '0' - 52, '-' - 62, '_' - 63, 'A', 0, 0);
+    __m128i out = _mm_add_epi8(_mm_shuffle_epi8(offsets, range), idx);
+    _mm_storeu_si128((__m128i*)(void*)dst, out);
+}
+
+#endif /* TRUERND__HAVE_X86_SIMD */
+
+#if TRUERND__HAVE_NEON
+
+static void
+truernd__hex16_neon(char *dst, const uint8_t *src) {
+    uint8x16_t lut = vld1q_u8((const uint8_t*)truernd__hex_digits);
+    uint8x16_t in = vld1q_u8(src);
+    uint8x16x2_t out;
+    out.val[0] = vqtbl1q_u8(lut, vshrq_n_u8(in, 4));
+    out.val[1] = vqtbl1q_u8(lut, vandq_u8(in, vdupq_n_u8(0x0f)));
+    vst2q_u8((uint8_t*)dst, out);
+}
+
+/* 48 bytes to 64 digits: LD3 splits the groups, TBL over the whole alphabet */
+static void
+truernd__b64url48_neon(char *dst, const uint8_t *src) {
+    const uint8x16_t six = vdupq_n_u8(0x3f);
+    uint8x16x4_t lut = vld1q_u8_x4((const uint8_t*)truernd__b64url_digits);
+    uint8x16x3_t in = vld3q_u8(src);
+    uint8x16x4_t out;
+    out.val[0] = vshrq_n_u8(in.val[0], 2);
+    out.val[1] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[1], 4), vshlq_n_u8(in.val[0], 4)), six);
+    out.val[2] = vandq_u8(vorrq_u8(vshrq_n_u8(in.val[2], 6), vshlq_n_u8(in.val[1], 2)), six);
+    out.val[3] = vandq_u8(in.val[2], six);
+    for (int i = 0; i < 4; i++) out.val[i] = vqtbl4q_u8(lut, out.val[i]);
+    vst4q_u8((uint8_t*)dst, out);
+}
+
+#endif /* TRUERND__HAVE_NEON */
+
+static inline void
+truernd__hex16(char *dst, const uint8_t *src) {
+#if TRUERND__HAVE_X86_SIMD
+    if (truernd_capabilities() & TRUERND_CAP_SSSE3) truernd__hex16_ssse3(dst, src);
+    else                                            truernd__hex16_scalar(dst, src);
+#elif TRUERND__HAVE_NEON
+    truernd__hex16_neon(dst, src);
+#else
+    truernd__hex16_scalar(dst, src);
+#endif
+}
+
+/* Encode n bytes without padding and return the end of the text; src needs
+ * 4 readable bytes past n for the 16-byte SSSE3 loads */
+static char *
+truernd__b64url_encode(char *dst, const uint8_t *src, size_t n) {
+    size_t i = 0;
+#if TRUERND__HAVE_X86_SIMD
+    if (truernd_capabilities() & TRUERND_CAP_SSSE3) {
+        for (; i + 12 <= n; i += 12, dst += 16) truernd__b64url12_ssse3(dst, src + i);
+    }
+#elif TRUERND__HAVE_NEON
+    for (; i + 48 <= n; i += 48, dst += 64) truernd__b64url48_neon(dst, src + i);
+#endif
+    for (; i + 3 <= n; i += 3, dst += 4) {
+        uint32_t v = (uint32_t)src[i] << 16 | (uint32_t)src[i + 1] << 8 | src[i + 2];
+        dst[0] = truernd__b64url_digits[v >> 18];
+        dst[1] = truernd__b64url_digits[(v >> 12) & 0x3f];
+        dst[2] = truernd__b64url_digits[(v >> 6) & 0x3f];
+        dst[3] = truernd__b64url_digits[v & 0x3f];
+    }
+    if (i < n) {
+        uint32_t v = (uint32_t)src[i] << 16 | (i + 1 < n ? (uint32_t)src[i + 1] << 8 : 0);
+        *dst++ = truernd__b64url_digits[v >> 18];
+        *dst++ = truernd__b64url_digits[(v >> 12) & 0x3f];
+        if (i + 1 < n) *dst++ = truernd__b64url_digits[(v >> 6) & 0x3f];
+    }
+    return dst;
+}
+
+int 
+truernd_uuid4(uint8_t out[16]) {
+    if (!out || TRUERND_FILL_FIXED(out, 16) != 0) return -1;
+    out[6] = (uint8_t)((out[6] & 0x0f) | 0x40);  /* Version 4 */
+    out[8] = (uint8_t)((out[8] & 0x3f) | 0x80);  /* Variant 10 */
     return 0;
 }
 
-uint64_t 
-truernd_gen64(void) {
+int 
+truernd_uuid4_str(char out[TRUERND_UUID_STR_LEN]) {
+    uint8_t raw[16];
+    char hex[32];
+    if (!out || truernd_uuid4(raw) != 0) return -1;
+
+    truernd__hex16(hex, raw);
+    memcpy(out, hex, 8);
+    out[8] = '-';
+    memcpy(out + 9, hex + 8, 4);
+    out[13] = '-';
+    memcpy(out + 14, hex + 12, 4);
+    out[18] = '-';
+    memcpy(out + 19, hex + 16, 4);
+    out[23] = '-';
+    memcpy(out + 24, hex + 20, 12);
+    out[36] = '\0';
     return 0;
 }
 
-#endif /* Architecture selection */
+int 
+truernd_token_b64url(char *out, size_t nbytes) {
+    if (!out || nbytes == 0 || nbytes > (SIZE_MAX - 3) / 4) return -1;
 
-/* Common implementation for truernd_fill */
-static inline int 
-truernd_fill(void *buf, size_t len) {
-    if (!buf || len == 0) return -1;
+    /* A multiple of 3 and of 48, so only the last chunk can end mid-group */
+    uint8_t raw[48 + 4] = {0};
+    int rc = 0;
+    while (nbytes > 0) {
+        size_t n = nbytes < 48 ? nbytes : 48;
+        if (truernd_fill_fixed(raw, n) != 0) {
+            rc = -1;
+            break;
+        }
+        out = truernd__b64url_encode(out, raw, n);
+        nbytes -= n;
+    }
+    *out = '\0';
+    truernd__wipe(raw, sizeof(raw));
+    return rc;
+}
+
+/*
+ * Streaming fills and mapped files
+ *
+ * Random bytes bound for memory nobody will read soon are generated into a
+ * bounce buffer that stays in L1, then copied out with
+ * non-temporal stores so the destination never allocates cache lines.
+ */
+
+/* Large enough to amortise per-call DRBG setup, small enough to stay in L1 */
+#define TRUERND__STREAM_BOUNCE (16u * 1024u)
+
+#if defined(truernd_ARCH_X86) && (defined(__GNUC__) || defined(__clang__))
+#include <emmintrin.h>
+
+/* dst is 16-byte aligned and n a multiple of 16 */
+__attribute__((target("sse2"))) static void
+truernd__stream_copy(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i += 16) {
+        _mm_stream_si128((__m128i*)(void*)(dst + i), _mm_load_si128((const __m128i*)(const void*)(src + i)));
+    }
+}
 
+/* Order the write-combining stores before anything that follows */
+__attribute__((target("sse2"))) static void
+truernd__stream_fence(void) {
+    _mm_sfence();
+}
+
+#elif defined(__aarch64__)
+
+static void
+truernd__stream_copy(uint8_t *dst, const uint8_t *src, size_t n) {
+    for (size_t i = 0; i < n; i += 16) {
+        uint64_t a, b;
+        memcpy(&a, src + i, 8);
+        memcpy(&b, src + i + 8, 8);
+        __asm__ volatile("stnp %1, %2, [%0]" : : "r"(dst + i), "r"(a), "r"(b) : "memory");
+    }
+}
+
+static void
+truernd__stream_fence(void) {
+    __asm__ volatile("dmb ishst" ::: "memory");
+}
+
+#else
+
+static void
+truernd__stream_copy(uint8_t *dst, const uint8_t *src, size_t n) {
+    memcpy(dst, src, n);
+}
+
+static void
+truernd__stream_fence(void) {
+}
+
+#endif
+
+/* Fill through the bound backend, storing everything past the head non-temporally */
+static int
+truernd__fill_stream(void *buf, size_t len) {
+    TRUERND_ALIGNED(TRUERND_CACHE_LINE) uint8_t bounce[TRUERND__STREAM_BOUNCE];
     uint8_t *ptr = (uint8_t*)buf;
+    size_t used = 0;
+    int rc = 0;
 
-    while (len >= 8) {
-        uint64_t val;
-        int retries = 0;
-        while (truernd_get64(&val) != 0) {
-            if (++retries >= TRUERND_MAX_RETRIES) return -1;
-        }
-        for (int i = 0; i < 8; i++) {
-            *ptr++ = (uint8_t)(val >> (i * 8));
-        }
-        len -= 8;
+    size_t head = (size_t)(-(uintptr_t)ptr & 15);
+    if (head > len) head = len;
+    if (head > 0 && (rc = truernd__fill(ptr, head)) != 0) return rc;
+    ptr += head;
+    len -= head;
+
+    while (len >= 16) {
+        size_t n = len < sizeof(bounce) ? len & ~(size_t)15 : sizeof(bounce);
+        if ((rc = truernd__fill(bounce, n)) != 0) break;
+        if (n > used) used = n;
+        truernd__stream_copy(ptr, bounce, n);
+        ptr += n;
+        len -= n;
     }
+    truernd__stream_fence();
+    truernd__wipe(bounce, used);
 
-    if (len > 0) {
-        uint64_t val;
-        int retries = 0;
-        while (truernd_get64(&val) != 0) {
-            if (++retries >= TRUERND_MAX_RETRIES) return -1;
-        }
-        for (size_t i = 0; i < len; i++) {
-            *ptr++ = (uint8_t)(val >> (i * 8));
+    if (rc == 0 && len > 0) rc = truernd__fill(ptr, len);
+    return rc;
+}
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <errno.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int 
+truernd_fill_file(int fd, uint64_t offset, uint64_t len, unsigned int flags) {
+    if (fd < 0 || len == 0 || offset > UINT64_MAX - len) return -1;
+
+    uint64_t end = offset + len;
+    if ((off_t)end < 0 || (uint64_t)(off_t)end != end) return -1;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -1;
+    if ((uint64_t)st.st_size < end && ftruncate(fd, (off_t)end) != 0) return -1;
+
+    long page = sysconf(_SC_PAGESIZE);
+    if (page <= 0) page = 4096;
+
+    while (offset < end) {
+        /* Map from the page holding offset, at most one window at a time */
+        uint64_t base = offset & ~(uint64_t)(page - 1);
+        uint64_t span = end - base < TRUERND_FILE_WINDOW ? end - base : TRUERND_FILE_WINDOW;
+        void *map = mmap(NULL, (size_t)span, PROT_READ | PROT_WRITE, MAP_SHARED, fd, (off_t)base);
+        if (map == MAP_FAILED) return -1;
+
+#if defined(MADV_HUGEPAGE)
+        if (flags & TRUERND_MAP_HUGEPAGE) madvise(map, (size_t)span, MADV_HUGEPAGE);
+#endif
+#if defined(MADV_SEQUENTIAL)
+        madvise(map, (size_t)span, MADV_SEQUENTIAL);
+#endif
+
+        size_t skip = (size_t)(offset - base);
+        int rc = truernd__fill_stream((uint8_t*)map + skip, (size_t)span - skip);
+        if (rc == 0 && (flags & TRUERND_MAP_SYNC)) rc = msync(map, (size_t)span, MS_SYNC);
+        munmap(map, (size_t)span);
+        if (rc != 0) return -1;
+
+        offset = base + span;
+    }
+    return 0;
+}
+
+/* Anonymous bounce buffer, from the huge page pool when asked and available */
+static void *
+truernd__stream_map(size_t len, unsigned int flags) {
+    void *map = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+    if (flags & TRUERND_MAP_HUGETLB) {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    }
+#endif
+    if (map == MAP_FAILED) {
+        map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (map == MAP_FAILED) return NULL;
+#if defined(MADV_HUGEPAGE)
+        if (flags & (TRUERND_MAP_HUGEPAGE | TRUERND_MAP_HUGETLB)) madvise(map, len, MADV_HUGEPAGE);
+#endif
+    }
+    return map;
+}
+
+int 
+truernd_fill_stream(int fd, uint64_t len, unsigned int flags) {
+    if (fd < 0 || len == 0) return -1;
+
+    size_t chunk = len < TRUERND_STREAM_CHUNK ? (size_t)len : TRUERND_STREAM_CHUNK;
+    uint8_t *buf = (uint8_t*)truernd__stream_map(TRUERND_STREAM_CHUNK, flags);
+    if (!buf) return -1;
+
+    /* write() reads the chunk straight back, so it is filled with cached stores */
+    int rc = 0;
+    while (len > 0 && rc == 0) {
+        size_t n = len < chunk ? (size_t)len : chunk;
+        if (truernd__fill(buf, n) != 0) { rc = -1; break; }
+
+        for (size_t done = 0; done < n; ) {
+            ssize_t w = write(fd, buf + done, n - done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                /* Non-blocking descriptor is full: wait until it drains */
+                struct pollfd pfd = { fd, POLLOUT, 0 };
+                if (poll(&pfd, 1, -1) >= 0 || errno == EINTR) continue;
+            }
+            if (w <= 0) {  /* Nothing written and no way to wait: give up, don't spin */
+                rc = -1;
+                break;
+            }
+            done += (size_t)w;
         }
+        len -= n;
     }
 
-    return 0;
+    /* munmap() is opaque to the compiler, so this wipe is not elided */
+    memset(buf, 0, chunk);
+    munmap(buf, TRUERND_STREAM_CHUNK);
+    return rc;
+}
+
+#else
+
+int 
+truernd_fill_file(int fd, uint64_t offset, uint64_t len, unsigned int flags) {
+    (void)fd; (void)offset; (void)len; (void)flags;
+    return -1;
+}
+
+int 
+truernd_fill_stream(int fd, uint64_t len, unsigned int flags) {
+    (void)fd; (void)len; (void)flags;
+    return -1;
 }
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif 
@@ -0,0 +1,253 @@
+/*
+ * @file truerandom.hpp
+ * @brief C++17 front-end to truerandom.h: compile-time sized fills and <random> engines
+ * @version 0.0.4
+ */
+
+#ifndef TRUERANDOM_HPP
+#define TRUERANDOM_HPP
+
+#if __cplusplus < 201703L
+#error "truerandom.hpp needs C++17"
+#endif
+
+#include "truerandom.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+
+#if __cplusplus >= 202002L && defined(__has_include)
+#if __has_include(<span>)
+#include <span>
+#endif
+#endif
+
+/**
+ * @defgroup truernd_cpp C++ API
+ * @brief Header-only templates over the C API. They use the inline pool
+ *        getters, so like truernd_uniform_u32() they need the implementation
+ *        in the translation unit that calls them
+ * @{
+ */
+
+namespace truernd {
+
+/**
+ * @brief Fill N bytes, unrolled at compile time
+ * @tparam N Length of buffer in bytes
+ * @param buf Buffer to fill
+ * @return 0 on success, -1 on failure
+ * @note truernd_fill_fixed() with a constant length, so the pool fast path
+ *       is shared with C: when the thread-local pool holds enough words above
+ *       its prefetch mark they are copied with one fixed-size move, otherwise
+ *       each word is a separate pool draw. Sizes larger than the pool go to
+ *       truernd_fill()
+ */
+template <std::size_t N>
+inline int
+fill(void *buf) noexcept {
+    static_assert(N > 0, "fill<N> needs N > 0");
+    return truernd_fill_fixed(buf, N);
+}
+
+/**
+ * @brief Fill an array of trivially copyable values
+ * @param arr Array to fill
+ * @return 0 on success, -1 on failure
+ */
+template <class T, std::size_t N>
+inline int
+fill(T (&arr)[N]) noexcept {
+    static_assert(std::is_trivially_copyable<T>::value && !std::is_same<T, bool>::value,
+                  "fill() needs a type every bit pattern is valid for");
+    return fill<sizeof(arr)>(arr);
+}
+
+#ifdef __cpp_lib_span
+/**
+ * @brief Fill a fixed-extent byte span
+ * @param buf Span to fill
+ * @return 0 on success, -1 on failure
+ */
+template <std::size_t N>
+inline int
+fill(std::span<std::byte, N> buf) noexcept {
+    static_assert(N != std::dynamic_extent, "fill() needs a span with a static extent");
+    return fill<N>(buf.data());
+}
+#endif
+
+/**
+ * @brief Generate one random value of type T
+ * @param[out] out Value to overwrite
+ * @return 0 on success, -1 on failure
+ */
+template <class T>
+inline int
+generate(T &out) noexcept {
+    static_assert(std::is_trivially_copyable<T>::value && !std::is_same<T, bool>::value,
+                  "generate() needs a type every bit pattern is valid for");
+    return fill<sizeof(T)>(&out);
+}
+
+/**
+ * @brief Generate one random value of type T
+ * @return The random value, or a value-initialized T on failure
+ */
+template <class T>
+inline T
+generate() noexcept {
+    T out;
+    if (generate(out) != 0) return T{};
+    return out;
+}
+
+namespace detail {
+
+/* Engines report failure the way std::random_device does */
+[[noreturn]] inline void
+fail(const char *what) {
+#if defined(__cpp_exceptions) || defined(__EXCEPTIONS)
+    throw std::runtime_error(what);
+#else
+    (void)what;
+    std::abort();
+#endif
+}
+
+/* Word buffer shared by the engines; Derived supplies fill_block() */
+template <class Derived, std::size_t Words>
+class block_engine {
+public:
+    using result_type = std::uint64_t;
+
+    static constexpr std::size_t block_words = Words;
+
+    static constexpr result_type min() noexcept { return 0; }
+    static constexpr result_type max() noexcept { return ~result_type(0); }
+
+    result_type
+    operator()() {
+        /* Words buffered before a fork or truernd_invalidate_all() are dropped */
+        if (avail_ == 0 || gen_ != TRUERND__GENERATION()) refill();
+
+        /* Wipe each word as it leaves, like the C pools */
+        result_type val = words_[--avail_];
+        words_[avail_] = 0;
+        return val;
+    }
+
+    void
+    discard(unsigned long long n) {
+        while (n--) (*this)();
+    }
+
+    block_engine(const block_engine &) = delete;
+    block_engine &operator=(const block_engine &) = delete;
+
+protected:
+    block_engine() = default;
+
+    ~block_engine() {
+        volatile result_type *w = words_;
+        for (std::size_t i = 0; i < avail_; i++) w[i] = 0;
+    }
+
+private:
+    void
+    refill() {
+        avail_ = 0;
+        gen_ = TRUERND__GENERATION();
+        if (static_cast<Derived *>(this)->fill_block(words_, sizeof(words_)) != 0) {
+            fail("truernd: engine refill failed");
+        }
+        avail_ = Words;
+    }
+
+    alignas(TRUERND_CACHE_LINE) result_type words_[Words];
+    std::size_t avail_ = 0;
+    std::uint32_t gen_ = 0;
+};
+
+} // namespace detail
+
+/**
+ * @brief UniformRandomBitGenerator over raw RDRAND / RNDR output
+ * @note Refills TRUERND_POOL_WORDS words at a time through the unrolled
+ *       hardware kernel, whatever backend truernd_fill() is bound to, so a
+ *       distribution call costs a buffer read instead of a draw. Like the
+ *       standard engines it is not safe to share between threads
+ */
+class engine : public detail::block_engine<engine, TRUERND_POOL_WORDS> {
+public:
+    /** @brief Throws std::runtime_error if the CPU has no hardware RNG */
+    engine() {
+        if (!truernd_backend_available(TRUERND_BACKEND_HW)) detail::fail("truernd: no hardware RNG");
+    }
+
+    /** @brief Entropy estimate in bits per output, as std::random_device::entropy() */
+    double entropy() const noexcept { return 64.0; }
+
+private:
+    friend class detail::block_engine<engine, TRUERND_POOL_WORDS>;
+
+    int
+    fill_block(void *buf, std::size_t len) noexcept {
+        return truernd_fill_backend(TRUERND_BACKEND_HW, buf, len);
+    }
+};
+
+/**
+ * @brief UniformRandomBitGenerator over a private hardware-seeded DRBG
+ * @note Each engine owns a truernd_drbg_t and refills 4 KiB at a time, so the
+ *       per-fill rekey is amortised over 512 outputs. Defaults to AES-256-CTR
+ *       where AES instructions exist and ChaCha20 elsewhere
+ */
+class drbg_engine : public detail::block_engine<drbg_engine, 512> {
+public:
+    /**
+     * @brief Seed a new DRBG from RDSEED / RNDRRS
+     * @param cipher TRUERND_DRBG_AES256 or TRUERND_DRBG_CHACHA20
+     * @param reseed_interval Output bytes between reseeds, 0 for TRUERND_DRBG_RESEED_BYTES
+     * @note Throws std::runtime_error if the DRBG cannot be seeded
+     */
+    explicit drbg_engine(int cipher = default_cipher(), std::uint64_t reseed_interval = 0) {
+        if (truernd_drbg_init_ex(&drbg_, reseed_interval, cipher) != 0) {
+            detail::fail("truernd: DRBG seeding failed");
+        }
+    }
+
+    ~drbg_engine() {
+        volatile unsigned char *p = reinterpret_cast<volatile unsigned char *>(&drbg_);
+        for (std::size_t i = 0; i < sizeof(drbg_); i++) p[i] = 0;
+    }
+
+    /** @brief Mix fresh seed material into the key; buffered output is kept */
+    int reseed() noexcept { return truernd_drbg_reseed(&drbg_); }
+
+    static int
+    default_cipher() noexcept {
+        return truernd_backend_available(TRUERND_BACKEND_DRBG_AES) ? TRUERND_DRBG_AES256
+                                                                   : TRUERND_DRBG_CHACHA20;
+    }
+
+private:
+    friend class detail::block_engine<drbg_engine, 512>;
+
+    int
+    fill_block(void *buf, std::size_t len) noexcept {
+        return truernd_drbg_fill(&drbg_, buf, len);
+    }
+
+    truernd_drbg_t drbg_;
+};
+
+} // namespace truernd
+
+/** @}*/
+
+#endif /* TRUERANDOM_HPP */
@@ -0,0 +1,265 @@
+/**
+ * @file truernd_cat.c
+ * @brief Stream random bytes to stdout or a file descriptor
+ *
+ * A `dd if=/dev/urandom` replacement for bulk jobs and for feeding rngd
+ * while the kernel pool is still initializing. Chunks are generated with
+ * truernd_fill() (or truernd_fill_parallel() with --threads) into two
+ * page-aligned buffers used in turn. When the output is a pipe on Linux
+ * the buffers are vmspliced into it, so the pages are handed over instead
+ * of copied; otherwise they go out with plain large writes.
+ *
+ * With --feed-kernel nothing is written: the hardware RNG is submitted to
+ * the kernel's CRNG in --chunk sized RNDADDENTROPY batches, --interval ms
+ * apart, until the kernel reports itself seeded (see truernd_feed_kernel()).
+ *
+ * The two-buffer scheme is what makes vmsplice safe: each buffer is at
+ * least the pipe's capacity, so by the time one has been spliced in full
+ * the reader has consumed every page of the other and it can be refilled.
+ */
+
+#define _GNU_SOURCE  /* vmsplice, F_SETPIPE_SZ */
+#define TRUERANDOM_IMPLEMENTATION
+#include "truerandom.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define CAT_DEFAULT_CHUNK (1024u * 1024u)
+#define CAT_PAGE          4096u
+
+typedef struct {
+    int fd;
+    int use_splice;     /* Output is a pipe and vmsplice works */
+    size_t chunk;       /* Bytes generated per buffer */
+    unsigned int threads;
+    uint64_t total;     /* 0 = until the reader goes away */
+    uint64_t rate;      /* Bytes per second, 0 = unlimited */
+    int verbose;
+} cat_opts_t;
+
+static double
+cat_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+/* Put all n bytes out; returns 0, 1 once the reader has gone, or -1 on error */
+static int
+cat_emit(const cat_opts_t *o, const uint8_t *p, size_t n) {
+    while (n > 0) {
+        ssize_t w;
+#if defined(__linux__)
+        if (o->use_splice) {
+            struct iovec iov = { (void*)p, n };
+            w = vmsplice(o->fd, &iov, 1, 0);
+        } else
+#endif
+        {
+            w = write(o->fd, p, n);
+        }
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return errno == EPIPE ? 1 : -1;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+    return 0;
+}
+
+/* Sleep until sent bytes are due at the requested rate */
+static void
+cat_pace(const cat_opts_t *o, double start, uint64_t sent) {
+    if (o->rate == 0) return;
+
+    double ahead = (double)sent / (double)o->rate - (cat_now() - start);
+    if (ahead <= 0) return;
+    struct timespec ts;
+    ts.tv_sec = (time_t)ahead;
+    ts.tv_nsec = (long)((ahead - (double)ts.tv_sec) * 1e9);
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {}
+}
+
+/* Prefer splicing into pipes, with the pipe grown to one chunk */
+static void
+cat_setup_output(cat_opts_t *o) {
+    struct stat st;
+    if (fstat(o->fd, &st) != 0 || !S_ISFIFO(st.st_mode)) return;
+#if defined(__linux__) && defined(F_SETPIPE_SZ) && defined(F_GETPIPE_SZ)
+    (void)fcntl(o->fd, F_SETPIPE_SZ, (int)o->chunk);
+    int cap = fcntl(o->fd, F_GETPIPE_SZ);
+    if (cap <= 0) return;
+    if ((size_t)cap > o->chunk) o->chunk = (size_t)cap;
+    o->use_splice = 1;
+#endif
+}
+
+static int
+cat_run(cat_opts_t *o) {
+    uint8_t *bufs[2] = { NULL, NULL };
+    int rc = 0;
+
+    o->chunk = (o->chunk + CAT_PAGE - 1) & ~(size_t)(CAT_PAGE - 1);
+    cat_setup_output(o);
+    for (int i = 0; i < 2; i++) {
+        if (posix_memalign((void**)&bufs[i], CAT_PAGE, o->chunk) != 0) {
+            fprintf(stderr, "truernd-cat: out of memory\n");
+            free(bufs[0]);
+            return 1;
+        }
+    }
+
+    double start = cat_now();
+    uint64_t sent = 0;
+    for (int k = 0; o->total == 0 || sent < o->total; k ^= 1) {
+        size_t n = o->chunk;
+        if (o->total && o->total - sent < n) n = (size_t)(o->total - sent);
+
+        int fill = o->threads > 1 ? truernd_fill_parallel(bufs[k], n, o->threads)
+                                  : truernd_fill(bufs[k], n);
+        if (fill != 0) {
+            fprintf(stderr, "truernd-cat: %s backend failed to generate data\n",
+                    truernd_backend_name(truernd_get_backend()));
+            rc = 1;
+            break;
+        }
+
+        int e = cat_emit(o, bufs[k], n);
+        if (e != 0) {
+            if (e < 0) {
+                fprintf(stderr, "truernd-cat: write: %s\n", strerror(errno));
+                rc = 1;
+            }
+            break;
+        }
+        sent += n;
+        cat_pace(o, start, sent);
+    }
+
+    if (o->verbose) {
+        double secs = cat_now() - start;
+        fprintf(stderr, "truernd-cat: %llu bytes in %.3f s (%.3f GB/s) from %s%s\n",
+                (unsigned long long)sent, secs, secs > 0 ? (double)sent / secs / 1e9 : 0.0,
+                truernd_backend_name(truernd_get_backend()), o->use_splice ? " via vmsplice" : "");
+    }
+
+    /* Spliced pages stay referenced by the pipe until the reader gets to
+     * them, so wiping them here would corrupt the tail of the stream */
+    if (!o->use_splice) {
+        truernd__wipe(bufs[0], o->chunk);
+        truernd__wipe(bufs[1], o->chunk);
+    }
+    free(bufs[0]);
+    free(bufs[1]);
+    return rc;
+}
+
+/*
+ * Driver
+ */
+
+static void
+usage(const char *argv0) {
+    fprintf(stderr,
+            "usage: %s [--backend NAME] [--bytes N[K|M|G]] [--rate N[K|M|G]] [--threads N]\n"
+            "          [--chunk N[K|M|G]] [--fd N] [--verbose]\n"
+            "       %s --feed-kernel [--chunk N[K|M|G]] [--interval MS]\n"
+            "backends:", argv0, argv0);
+    for (int b = 0; b < TRUERND_BACKEND_COUNT; b++) {
+        if (truernd_backend_available((truernd_backend_t)b)) {
+            fprintf(stderr, " %s", truernd_backend_name((truernd_backend_t)b));
+        }
+    }
+    fprintf(stderr, "\n");
+}
+
+static uint64_t
+parse_size(const char *s) {
+    char *end;
+    unsigned long long v = strtoull(s, &end, 10);
+    switch (*end) {
+        case 'k': case 'K': v <<= 10; break;
+        case 'm': case 'M': v <<= 20; break;
+        case 'g': case 'G': v <<= 30; break;
+        default: break;
+    }
+    return (uint64_t)v;
+}
+
+int
+main(int argc, char **argv) {
+    cat_opts_t o = { STDOUT_FILENO, 0, CAT_DEFAULT_CHUNK, 1, 0, 0, 0 };
+    truernd_backend_t backend = TRUERND_BACKEND_FASTEST;
+    int feed = 0;
+    size_t feed_batch = 0;
+    unsigned int interval_ms = 100;
+
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--verbose") == 0) {
+            o.verbose = 1;
+            continue;
+        }
+        if (strcmp(arg, "--feed-kernel") == 0) {
+            feed = 1;
+            continue;
+        }
+        if (strcmp(arg, "--backend") == 0 && val) {
+            int b;
+            for (b = 0; b < TRUERND_BACKEND_COUNT; b++) {
+                if (strcmp(val, truernd_backend_name((truernd_backend_t)b)) == 0) break;
+            }
+            if (b == TRUERND_BACKEND_COUNT) { usage(argv[0]); return 2; }
+            backend = (truernd_backend_t)b;
+        } else if (strcmp(arg, "--bytes") == 0 && val) {
+            o.total = parse_size(val);
+        } else if (strcmp(arg, "--rate") == 0 && val) {
+            o.rate = parse_size(val);
+        } else if (strcmp(arg, "--threads") == 0 && val) {
+            o.threads = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(arg, "--chunk") == 0 && val) {
+            o.chunk = feed_batch = (size_t)parse_size(val);
+        } else if (strcmp(arg, "--interval") == 0 && val) {
+            interval_ms = (unsigned int)strtoul(val, NULL, 10);
+        } else if (strcmp(arg, "--fd") == 0 && val) {
+            o.fd = (int)strtol(val, NULL, 10);
+        } else {
+            usage(argv[0]);
+            return 2;
+        }
+        i++;
+    }
+    if (o.threads == 0 || o.chunk == 0 || o.fd < 0) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    if (feed) {
+        if (truernd_feed_kernel(feed_batch, interval_ms, 0) != 0) {
+            fprintf(stderr, "truernd-cat: could not seed the kernel CRNG (needs root and a hardware RNG)\n");
+            return 1;
+        }
+        if (o.verbose) fprintf(stderr, "truernd-cat: kernel CRNG is seeded\n");
+        return 0;
+    }
+
+    if (truernd_set_backend(backend) != 0) {
+        fprintf(stderr, "truernd-cat: backend %s is not available here\n", truernd_backend_name(backend));
+        return 1;
+    }
+
+    /* A reader going away ends the stream; it is not an error */
+    signal(SIGPIPE, SIG_IGN);
+    return cat_run(&o);
+}